@@ -39,6 +39,19 @@
   #define SERIAL_RX_IOD IOID_2
   #define SERIAL_TX_IOD IOID_3
   //
+  #define SPORT_UART    UART1
+  #define SPORT_TX_IOD  IOID_21 // direct
+  #define SPORT_RXI_IOD IOID_23 // inverted
+  #define SPORT_TXI_IOD IOID_24 // inverted
+  //
+  // The S.PORT line carries either telemetry (default) or the RC input
+  // from the radio (SBUS: inverted RX, CRSF: single wire half-duplex)
+  #if defined(RC_INPUT_SBUS) || defined(RC_INPUT_CRSF)
+    #define RC_UART     SPORT_UART
+    #define RC_SBUS_IOD SPORT_TX_IOD
+    #define RC_CRSF_IOD SPORT_TX_IOD
+  #endif
+  //
   #define LED_DIN       IOID_18
   #define LED_SPI       SPI1
   //
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// Little endian fields of command payloads and dump records
+// (unaligned access)
+static inline uint32_t get_u32_le(const uint8_t* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void put_u32_le(uint8_t* p, uint32_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
@@ -0,0 +1,78 @@
+#include <string.h>
+
+#include "command.h"
+#include "crc.h"
+
+bool command_decode(const uint8_t* data, uint32_t len, command_t* cmd)
+{
+  if (len < CMD_HEADER_SIZE + CMD_CRC_SIZE) return false;
+  if (data[0] != CMD_SYNC) return false;
+
+  uint32_t payload_len = command_payload_len(data);
+  if (payload_len + CMD_HEADER_SIZE + CMD_CRC_SIZE != len) return false;
+
+  uint8_t crc = crc8_d5(0, data + 1, CMD_HEADER_SIZE - 1 + payload_len);
+  if (crc != data[CMD_HEADER_SIZE + payload_len]) return false;
+
+  cmd->opcode = data[1];
+  cmd->len = payload_len;
+  cmd->payload = data + CMD_HEADER_SIZE;
+  return true;
+}
+
+static bool _decode_alias(const command_table_t* table,
+                          const serial_frame_t* frame, command_t* cmd)
+{
+  for (unsigned i = 0; i < table->n_aliases; i++) {
+    const char* name = table->aliases[i].name;
+    // exact match only (no prefix)
+    if (strlen(name) != frame->len) continue;
+    if (memcmp(name, frame->data, frame->len) != 0) continue;
+
+    cmd->opcode = table->aliases[i].opcode;
+    cmd->len = 0;
+    cmd->payload = frame->data;
+    return true;
+  }
+  return false;
+}
+
+bool command_dispatch(serial_t* serial, const command_table_t* table,
+                      const serial_frame_t* frame)
+{
+  command_t cmd;
+  if (!command_decode(frame->data, frame->len, &cmd) && !_decode_alias(table, frame, &cmd)) {
+    return false;
+  }
+
+  if (cmd.opcode >= CMD_OPCODES) return false;
+
+  command_handler_t handler = table->handlers[cmd.opcode];
+  if (!handler) return false;
+
+  handler(serial, &cmd);
+  return true;
+}
+
+void command_reply(serial_t* serial, uint8_t opcode, const void* payload,
+                   uint32_t len)
+{
+  static uint8_t header[CMD_HEADER_SIZE];
+  static uint8_t crc;
+
+  header[0] = CMD_SYNC;
+  header[1] = opcode | CMD_REPLY;
+  header[2] = len & 0xFF;
+  header[3] = len >> 8;
+
+  crc = crc8_d5(0, header + 1, CMD_HEADER_SIZE - 1);
+  crc = crc8_d5(crc, payload, len);
+
+  uart_iovec_t iov[3];
+  uint32_t n = 0;
+  iov[n++] = (uart_iovec_t){ header, sizeof(header) };
+  if (len) iov[n++] = (uart_iovec_t){ payload, len };
+  iov[n++] = (uart_iovec_t){ &crc, sizeof(crc) };
+
+  serial_writev_dma(serial, iov, n, true);
+}
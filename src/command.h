@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "serial.h"
+
+// Binary command frame (one per serial frame):
+//   [CMD_SYNC][opcode][len (LE u16)][payload][crc8]
+//
+// CRC8 (poly 0xD5) covers opcode, len and payload.
+// Replies use the same framing with opcode | CMD_REPLY.
+#define CMD_SYNC        0xA5
+#define CMD_HEADER_SIZE 4
+#define CMD_CRC_SIZE    1
+#define CMD_MAX_PAYLOAD (RX_BUFFER_SIZE - CMD_HEADER_SIZE - CMD_CRC_SIZE)
+
+#define CMD_OPCODES 0x80
+#define CMD_REPLY   0x80
+
+// Opcodes
+#define CMD_DUMP_FLASH     0x01
+#define CMD_LOAD_FLASH     0x02
+#define CMD_LOAD_BLOCK     0x03
+#define CMD_DUMP_FLASH_BIN 0x04
+#define CMD_FLASH_MANIFEST 0x05
+#define CMD_DUMP_SECTORS   0x06
+#define CMD_DMA_STATS      0x07
+#define CMD_UART_STATS     0x08 // DEBUG builds: logged over RTT
+#define CMD_UART_BENCH     0x09 // DEBUG builds: logged over RTT
+
+// Zero-copy view of a received command:
+// payload points into the frame slot, valid until the handler returns
+typedef struct {
+  uint8_t opcode;
+  uint16_t len;
+  const uint8_t* payload;
+} command_t;
+
+typedef void (*command_handler_t)(serial_t* serial, const command_t* cmd);
+
+// Legacy text command, mapped to an opcode without payload
+typedef struct {
+  const char* name;
+  uint8_t opcode;
+} command_alias_t;
+
+typedef struct {
+  const command_handler_t* handlers; // CMD_OPCODES entries, indexed by opcode
+  const command_alias_t* aliases;
+  uint32_t n_aliases;
+} command_table_t;
+
+// Payload length field of a frame header
+static inline uint32_t command_payload_len(const uint8_t* header)
+{
+  return header[2] | (header[3] << 8);
+}
+
+// Check and decode a complete frame (zero-copy)
+bool command_decode(const uint8_t* data, uint32_t len, command_t* cmd);
+
+// Decode and run the command in 'frame':
+// returns false if the frame is invalid or the opcode unknown
+bool command_dispatch(serial_t* serial, const command_table_t* table,
+                      const serial_frame_t* frame);
+
+// Send a reply frame for 'opcode' (blocking)
+void command_reply(serial_t* serial, uint8_t opcode, const void* payload,
+                   uint32_t len);
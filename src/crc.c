@@ -0,0 +1,60 @@
+#include "crc.h"
+
+// Table generated at compile time: one MSB-first shift per bit
+#define _CRC8_STEP(c) ((((c) << 1) ^ (((c) & 0x80) ? 0xD5 : 0)) & 0xFF)
+
+#define _CRC8_2(c) _CRC8_STEP(_CRC8_STEP(c))
+#define _CRC8_4(c) _CRC8_2(_CRC8_2(c))
+#define _CRC8_8(c) _CRC8_4(_CRC8_4(c))
+
+#define _CRC8_ROW(n)                                                           \
+  _CRC8_8((n) + 0x0), _CRC8_8((n) + 0x1), _CRC8_8((n) + 0x2),                  \
+  _CRC8_8((n) + 0x3), _CRC8_8((n) + 0x4), _CRC8_8((n) + 0x5),                  \
+  _CRC8_8((n) + 0x6), _CRC8_8((n) + 0x7), _CRC8_8((n) + 0x8),                  \
+  _CRC8_8((n) + 0x9), _CRC8_8((n) + 0xA), _CRC8_8((n) + 0xB),                  \
+  _CRC8_8((n) + 0xC), _CRC8_8((n) + 0xD), _CRC8_8((n) + 0xE),                  \
+  _CRC8_8((n) + 0xF)
+
+const uint8_t crc8_d5_table[256] = {
+    _CRC8_ROW(0x00), _CRC8_ROW(0x10), _CRC8_ROW(0x20), _CRC8_ROW(0x30),
+    _CRC8_ROW(0x40), _CRC8_ROW(0x50), _CRC8_ROW(0x60), _CRC8_ROW(0x70),
+    _CRC8_ROW(0x80), _CRC8_ROW(0x90), _CRC8_ROW(0xA0), _CRC8_ROW(0xB0),
+    _CRC8_ROW(0xC0), _CRC8_ROW(0xD0), _CRC8_ROW(0xE0), _CRC8_ROW(0xF0),
+};
+
+uint8_t crc8_d5(uint8_t crc, const void* data, uint32_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  while (len--) crc = crc8_d5_table[crc ^ *p++];
+  return crc;
+}
+
+// CRC32 (reflected, as zlib): same generation scheme, LSB-first
+#define _CRC32_STEP(c) (((c) >> 1) ^ (((c) & 1) ? 0xEDB88320u : 0))
+
+#define _CRC32_2(c) _CRC32_STEP(_CRC32_STEP(c))
+#define _CRC32_4(c) _CRC32_2(_CRC32_2(c))
+#define _CRC32_8(c) _CRC32_4(_CRC32_4((uint32_t)(c)))
+
+#define _CRC32_ROW(n)                                                          \
+  _CRC32_8((n) + 0x0), _CRC32_8((n) + 0x1), _CRC32_8((n) + 0x2),               \
+  _CRC32_8((n) + 0x3), _CRC32_8((n) + 0x4), _CRC32_8((n) + 0x5),               \
+  _CRC32_8((n) + 0x6), _CRC32_8((n) + 0x7), _CRC32_8((n) + 0x8),               \
+  _CRC32_8((n) + 0x9), _CRC32_8((n) + 0xA), _CRC32_8((n) + 0xB),               \
+  _CRC32_8((n) + 0xC), _CRC32_8((n) + 0xD), _CRC32_8((n) + 0xE),               \
+  _CRC32_8((n) + 0xF)
+
+const uint32_t crc32_table[256] = {
+    _CRC32_ROW(0x00), _CRC32_ROW(0x10), _CRC32_ROW(0x20), _CRC32_ROW(0x30),
+    _CRC32_ROW(0x40), _CRC32_ROW(0x50), _CRC32_ROW(0x60), _CRC32_ROW(0x70),
+    _CRC32_ROW(0x80), _CRC32_ROW(0x90), _CRC32_ROW(0xA0), _CRC32_ROW(0xB0),
+    _CRC32_ROW(0xC0), _CRC32_ROW(0xD0), _CRC32_ROW(0xE0), _CRC32_ROW(0xF0),
+};
+
+uint32_t crc32(uint32_t crc, const void* data, uint32_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  crc = ~crc;
+  while (len--) crc = crc32_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// CRC8 poly 0xD5 (DVB-S2), as used by CRSF
+extern const uint8_t crc8_d5_table[256];
+
+static inline uint8_t crc8_d5_update(uint8_t crc, uint8_t data)
+{
+  return crc8_d5_table[crc ^ data];
+}
+
+uint8_t crc8_d5(uint8_t crc, const void* data, uint32_t len);
+
+// CRC32 (IEEE 802.3), compatible with zlib's crc32():
+// start with 0, feed the previous result to continue
+extern const uint32_t crc32_table[256];
+
+uint32_t crc32(uint32_t crc, const void* data, uint32_t len);
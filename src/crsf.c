@@ -0,0 +1,210 @@
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "crc.h"
+#include "crsf.h"
+#include "timer.h"
+
+#define CRSF_RING_SIZE 128 // 2 x 64 bytes halves
+#define CRSF_RING_MASK (CRSF_RING_SIZE - 1)
+
+#define RING(i) _ring[(i) & CRSF_RING_MASK]
+
+// frame length byte counts type + payload + crc
+#define CRSF_MIN_FRAME_LEN 2
+#define CRSF_MAX_FRAME_LEN (CRSF_MAX_FRAME_SIZE - 2)
+
+static uart_t _uart;
+static uint8_t _ring[CRSF_RING_SIZE];
+static uint32_t _rd;
+
+// Decoded channels: IRQ writes the set not being published
+static uint16_t _channels[2][RC_CHANNELS];
+static volatile uint8_t _current;
+static volatile bool _new_channels;
+static volatile uint32_t _crc_errors;
+
+#if defined(DEBUG)
+static crsf_stats_t _stats;
+static uint32_t _parse_start;
+#endif
+
+// Pending telemetry frame
+static uint8_t _tlm_buf[CRSF_MAX_FRAME_SIZE];
+static volatile uint32_t _tlm_len;
+
+static inline bool _is_sync(uint8_t c)
+{
+  return c == CRSF_SYNC_BYTE || c == CRSF_ADDR_MODULE || c == CRSF_ADDR_RADIO;
+}
+
+static void _rc_channels(uint32_t payload)
+{
+  const uint8_t* data = &RING(payload);
+
+  // only copy if the payload wraps around the ring end
+  uint8_t unwrapped[RC_PACKED_SIZE];
+  if ((payload & CRSF_RING_MASK) + RC_PACKED_SIZE > CRSF_RING_SIZE) {
+    for (unsigned i = 0; i < RC_PACKED_SIZE; i++) {
+      unwrapped[i] = RING(payload + i);
+    }
+    data = unwrapped;
+  }
+
+  uint8_t next = _current ^ 1;
+  rc_unpack_channels(data, _channels[next]);
+  _current = next;
+  _new_channels = true;
+
+  // our slot to talk
+  if (_tlm_len && uart_tx_dma_done(_uart)) {
+    uart_tx_dma(_uart, _tlm_buf, _tlm_len);
+    _tlm_len = 0;
+  }
+
+#if defined(DEBUG)
+  uint32_t ticks = get_ticks() - _parse_start;
+  if (ticks > _stats.max_reply_ticks) _stats.max_reply_ticks = ticks;
+  _stats.rc_frames++;
+#endif
+}
+
+// type at 'pos', followed by 'len' payload bytes
+static void _handle_frame(uint32_t pos, uint32_t len)
+{
+  switch (RING(pos)) {
+  case CRSF_FRAMETYPE_RC_CHANNELS_PACKED:
+    if (len == RC_PACKED_SIZE) _rc_channels(pos + 1);
+    break;
+
+  default:
+    break;
+  }
+}
+
+// Consume complete frames between the read and write indexes
+//  - 'idle': called on receive timeout, frames are sent in one go:
+//    an incomplete one is garbage (false sync after a CRC error)
+static void _crsf_parse(bool idle)
+{
+#if defined(DEBUG)
+  _parse_start = get_ticks();
+#endif
+  uint32_t wr = uart_rx_dma_write_index(_uart);
+
+  while (true) {
+    uint32_t avail = (wr - _rd) & CRSF_RING_MASK;
+    if (avail < 2) break;
+
+    if (!_is_sync(RING(_rd))) {
+      _rd = (_rd + 1) & CRSF_RING_MASK;
+      continue;
+    }
+
+    uint32_t len = RING(_rd + 1);
+    if (len < CRSF_MIN_FRAME_LEN || len > CRSF_MAX_FRAME_LEN) {
+      _rd = (_rd + 1) & CRSF_RING_MASK;
+      continue;
+    }
+
+    if (avail < len + 2) {
+      if (!idle) break; // wait for the rest of the frame
+      _rd = (_rd + 1) & CRSF_RING_MASK;
+      continue;
+    }
+
+    uint32_t pos = _rd + 2;
+    uint8_t crc = 0;
+    for (uint32_t i = 0; i < len - 1; i++) {
+      crc = crc8_d5_update(crc, RING(pos + i));
+    }
+
+    if (crc != RING(pos + len - 1)) {
+      _crc_errors++;
+      _rd = (_rd + 1) & CRSF_RING_MASK;
+      continue;
+    }
+
+    _handle_frame(pos, len - 2);
+    _rd = (_rd + len + 2) & CRSF_RING_MASK;
+  }
+}
+
+static void _crsf_frame_received(void* ctx)
+{
+  _crsf_parse(true);
+}
+
+static void _crsf_data_received(void* ctx)
+{
+  _crsf_parse(false);
+}
+
+void crsf_init(uart_t uart, uint32_t rx, uint32_t tx, uint32_t baud_rate)
+{
+  bool half_duplex = (rx == IOID_UNUSED || rx == tx);
+  const uart_device_t dev = {
+    .mode = UART_8N1,
+    .flags = half_duplex ? UART_HALF_DUPLEX : 0,
+    .baud_rate = baud_rate,
+    .rx = rx,
+    .tx = tx,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+
+  _uart = uart;
+  _rd = 0;
+  _current = 0;
+  _new_channels = false;
+  _crc_errors = 0;
+  _tlm_len = 0;
+
+  uart_init(uart, &dev);
+
+  uart_callbacks_t cb = {
+    .frame_received = _crsf_frame_received,
+    .data_received = _crsf_data_received,
+    .error = 0,
+    .ctx = 0,
+  };
+  uart_enable_irqs(uart, &cb);
+  uart_enable_rx_dma(uart, _ring, CRSF_RING_SIZE);
+}
+
+bool crsf_get_channels(uint16_t* channels)
+{
+  if (!_new_channels) return false;
+
+  _new_channels = false;
+  memcpy(channels, _channels[_current], sizeof(_channels[0]));
+  return true;
+}
+
+bool crsf_send_telemetry(uint8_t type, const void* payload, uint32_t len)
+{
+  if (len > CRSF_MAX_PAYLOAD_SIZE) return false;
+  if (_tlm_len || !uart_tx_dma_done(_uart)) return false;
+
+  _tlm_buf[0] = CRSF_SYNC_BYTE;
+  _tlm_buf[1] = len + 2;
+  _tlm_buf[2] = type;
+  memcpy(_tlm_buf + 3, payload, len);
+  _tlm_buf[len + 3] = crc8_d5(0, _tlm_buf + 2, len + 1);
+
+  // published last: picked up by the IRQ
+  _tlm_len = len + 4;
+  return true;
+}
+
+uint32_t crsf_crc_errors()
+{
+  return _crc_errors;
+}
+
+#if defined(DEBUG)
+const crsf_stats_t* crsf_get_stats()
+{
+  return &_stats;
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rc_channels.h"
+#include "uart.h"
+
+#define CRSF_BAUDRATE      416666
+#define CRSF_BAUDRATE_FAST 921600
+
+// sync + len + type + payload + crc
+#define CRSF_MAX_FRAME_SIZE   64
+#define CRSF_MAX_PAYLOAD_SIZE (CRSF_MAX_FRAME_SIZE - 4)
+
+#define CRSF_SYNC_BYTE   0xC8
+#define CRSF_ADDR_RADIO  0xEA
+#define CRSF_ADDR_MODULE 0xEE
+
+#define CRSF_FRAMETYPE_BATTERY_SENSOR     0x08
+#define CRSF_FRAMETYPE_LINK_STATISTICS    0x14
+#define CRSF_FRAMETYPE_RC_CHANNELS_PACKED 0x16
+
+// CRSF endpoint: RC frames in, telemetry out
+//  - rx == tx (or rx unused): half-duplex single wire
+//  - frames are parsed in place in the RX DMA ring,
+//    from the receive timeout IRQ and when a ring half is filled
+void crsf_init(uart_t uart, uint32_t rx, uint32_t tx, uint32_t baud_rate);
+
+// Copy the latest channels: returns false if none were received
+// since last call
+bool crsf_get_channels(uint16_t* channels);
+
+// Queue a telemetry frame, sent right after the next RC frame
+// (false if the previous one has not gone out yet)
+bool crsf_send_telemetry(uint8_t type, const void* payload, uint32_t len);
+
+// Frames dropped on CRC mismatch
+uint32_t crsf_crc_errors();
+
+#if defined(DEBUG)
+// RC frame handling time, from IRQ entry to telemetry reply
+// started (GPT1 ticks). The receive timeout adds 32 bit times
+// (77 us at 416666 baud) before the IRQ.
+typedef struct {
+  uint32_t rc_frames;
+  uint32_t max_reply_ticks;
+} crsf_stats_t;
+
+const crsf_stats_t* crsf_get_stats();
+#endif
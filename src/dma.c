@@ -1,13 +1,206 @@
+#include <driverlib/cpu.h>
+#include <driverlib/interrupt.h>
 #include <driverlib/prcm.h>
 #include <driverlib/udma.h>
 
-static uint8_t _dma_ctrl_tbl[1024] __attribute__((aligned(1024)));
+#include "dma.h"
+
+#define MAX_DMA_CHANNELS 32
+
+// Primary structures for all channels, alternate ones (at +0x200)
+// only up to DMA_ALT_CHANNELS
+#define DMA_CTRL_TABLE_SIZE \
+  ((MAX_DMA_CHANNELS + DMA_ALT_CHANNELS) * sizeof(tDMAControlTable))
+
+// Destination item size (log2 bytes)
+#define DMA_DST_SIZE(control) (((control) >> 28) & 3)
+
+static uint8_t _dma_ctrl_tbl[DMA_CTRL_TABLE_SIZE] __attribute__((aligned(1024)));
+
+typedef struct {
+  dma_callbacks_t cb;
+  uint32_t pending[2]; // bytes armed per structure
+  dma_stats_t stats;
+} dma_channel_t;
+
+// running: enabled by their driver and not seen completed
+typedef struct {
+  bool initialized;
+  uint32_t claimed;
+  volatile uint32_t running;
+  dma_channel_t channels[MAX_DMA_CHANNELS];
+} dma_state_t;
+
+static dma_state_t _dma_state;
+
+static inline tDMAControlTable* _dma_entry(uint32_t channel_struct)
+{
+  return &((tDMAControlTable*)_dma_ctrl_tbl)[channel_struct];
+}
+
+static inline uint32_t _struct_index(uint32_t channel_struct)
+{
+  return (channel_struct & UDMA_ALT_SELECT) ? 1 : 0;
+}
+
+// A bus error disables the faulty channel: it is the one that
+// dropped out without completing
+static void _dma_error_irq()
+{
+  uDMAErrorStatusClear(UDMA0_BASE);
+
+  uint32_t stopped = ~HWREG(UDMA0_BASE + UDMA_O_SETCHANNELEN) &
+                     ~HWREG(UDMA0_BASE + UDMA_O_REQDONE);
+  uint32_t mask = _dma_state.running & _dma_state.claimed & stopped;
+  _dma_state.running &= ~mask;
+
+  while (mask) {
+    uint32_t channel = __builtin_ctz(mask);
+    mask &= mask - 1;
+
+    dma_channel_t* ch = &_dma_state.channels[channel];
+    ch->stats.errors++;
+
+    // already restarted by the callback of its peer channel
+    if (_dma_state.running & (1u << channel)) continue;
+    if (ch->cb.error) ch->cb.error(ch->cb.ctx);
+  }
+}
 
 void dma_init()
 {
+  if (_dma_state.initialized) return;
+
   PRCMPeripheralRunEnable(PRCM_PERIPH_UDMA);
   PRCMLoadSet();
 
   uDMAEnable(UDMA0_BASE);
   uDMAControlBaseSet(UDMA0_BASE, _dma_ctrl_tbl);
+
+  IntRegister(INT_DMA_ERR, _dma_error_irq);
+  IntEnable(INT_DMA_ERR);
+
+  _dma_state.initialized = true;
+}
+
+bool dma_claim(uint32_t channel, uint32_t flags, const dma_callbacks_t* cb)
+{
+  ASSERT(channel < MAX_DMA_CHANNELS);
+  ASSERT(!(flags & DMA_USE_ALT) || (channel < DMA_ALT_CHANNELS));
+
+  uint32_t mask = 1u << channel;
+  ASSERT(!(_dma_state.claimed & mask));
+  if (_dma_state.claimed & mask) return false;
+
+  dma_channel_t* ch = &_dma_state.channels[channel];
+  ch->cb = *cb;
+  ch->pending[0] = ch->pending[1] = 0;
+
+  dma_disable(mask);
+  uDMAChannelAttributeDisable(UDMA0_BASE, channel, UDMA_ATTR_ALL);
+  if (flags & DMA_PRIO_HIGH) {
+    uDMAChannelAttributeEnable(UDMA0_BASE, channel, UDMA_ATTR_HIGH_PRIORITY);
+  }
+  if (flags & DMA_USE_BURST) {
+    uDMAChannelAttributeEnable(UDMA0_BASE, channel, UDMA_ATTR_USEBURST);
+  }
+
+  _dma_state.claimed |= mask;
+  return true;
+}
+
+void dma_release(uint32_t channel)
+{
+  ASSERT(channel < MAX_DMA_CHANNELS);
+  dma_disable(1u << channel);
+  _dma_state.claimed &= ~(1u << channel);
+}
+
+void dma_enable(uint32_t mask)
+{
+  uint32_t primask = CPUcpsid();
+  _dma_state.running |= mask;
+  HWREG(UDMA0_BASE + UDMA_O_SETCHANNELEN) = mask;
+  if (!primask) CPUcpsie();
+}
+
+void dma_disable(uint32_t mask)
+{
+  uint32_t primask = CPUcpsid();
+  HWREG(UDMA0_BASE + UDMA_O_CLEARCHANNELEN) = mask;
+  _dma_state.running &= ~mask;
+  if (!primask) CPUcpsie();
+}
+
+void dma_arm(uint32_t channel_struct, void* src_end, void* dst_end,
+             uint32_t control)
+{
+  tDMAControlTable* entry = _dma_entry(channel_struct);
+  entry->pvSrcEndAddr = src_end;
+  entry->pvDstEndAddr = dst_end;
+  entry->ui32Control = control;
+
+  uint32_t items = ((control & UDMA_XFER_SIZE_M) >> UDMA_XFER_SIZE_S) + 1;
+  dma_armed(channel_struct, items << DMA_DST_SIZE(control));
+}
+
+void dma_armed(uint32_t channel_struct, uint32_t bytes)
+{
+  uint32_t channel = channel_struct & ~UDMA_ALT_SELECT;
+  _dma_state.channels[channel].pending[_struct_index(channel_struct)] = bytes;
+}
+
+bool dma_stopped(uint32_t channel_struct)
+{
+  return !(_dma_entry(channel_struct)->ui32Control & UDMA_MODE_M);
+}
+
+// Completed structures are back in stop mode (aborted ones are not
+// accounted: their count is overwritten when re-armed)
+static void _account(uint32_t channel)
+{
+  dma_channel_t* ch = &_dma_state.channels[channel];
+  uint32_t n_structs = channel < DMA_ALT_CHANNELS ? 2 : 1;
+
+  for (uint32_t i = 0; i < n_structs; i++) {
+    uint32_t channel_struct = channel | (i ? UDMA_ALT_SELECT : UDMA_PRI_SELECT);
+    uint32_t control = _dma_entry(channel_struct)->ui32Control;
+    if (ch->pending[i] && !(control & UDMA_MODE_M)) {
+      ch->stats.bytes += ch->pending[i];
+      ch->stats.transfers++;
+      ch->pending[i] = 0;
+    }
+  }
+}
+
+void dma_dispatch(uint32_t mask)
+{
+  mask &= HWREG(UDMA0_BASE + UDMA_O_REQDONE);
+
+  while (mask) {
+    uint32_t channel = __builtin_ctz(mask);
+    mask &= mask - 1;
+
+    HWREG(UDMA0_BASE + UDMA_O_REQDONE) = 1u << channel;
+    _account(channel);
+
+    // stopped on completion (the callback may restart it)
+    if (!(HWREG(UDMA0_BASE + UDMA_O_SETCHANNELEN) & (1u << channel))) {
+      _dma_state.running &= ~(1u << channel);
+    }
+
+    dma_channel_t* ch = &_dma_state.channels[channel];
+    if (ch->cb.done) ch->cb.done(ch->cb.ctx);
+  }
+}
+
+uint32_t dma_claimed()
+{
+  return _dma_state.claimed;
+}
+
+const dma_stats_t* dma_get_stats(uint32_t channel)
+{
+  ASSERT(channel < MAX_DMA_CHANNELS);
+  return &_dma_state.channels[channel].stats;
 }
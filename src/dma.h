@@ -1,3 +1,61 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
+// Channels with an alternate control structure (0..DMA_ALT_CHANNELS-1):
+// the control table stops right after the last one (SSI1 TX)
+#define DMA_ALT_CHANNELS 18
+
+// Channel flags
+#define DMA_PRIO_HIGH (1 << 0) // served first when several channels request
+#define DMA_USE_ALT   (1 << 1) // ping-pong / scatter-gather
+#define DMA_USE_BURST (1 << 2) // burst requests only
+
+// error(): the channel was stopped by a bus error, the transfer
+// in progress must be aborted
+typedef struct {
+  void (*done)(void* ctx);
+  void (*error)(void* ctx);
+  void* ctx;
+} dma_callbacks_t;
+
+typedef struct {
+  uint32_t transfers; // completed control structures
+  uint32_t bytes;
+  uint32_t errors;
+} dma_stats_t;
+
+// Powers the uDMA and sets the control table (first call only)
 void dma_init();
+
+// Returns false (and asserts) if the channel is already owned:
+// a channel must be released by its owner before it is claimed again
+bool dma_claim(uint32_t channel, uint32_t flags, const dma_callbacks_t* cb);
+void dma_release(uint32_t channel);
+
+// Start / stop the channels in 'mask': channels expected to be
+// running are tracked to report bus errors to the right ones
+void dma_enable(uint32_t mask);
+void dma_disable(uint32_t mask);
+
+// Program one control structure ('channel | UDMA_ALT_SELECT' for
+// the alternate one) and account its size once completed
+void dma_arm(uint32_t channel_struct, void* src_end, void* dst_end,
+             uint32_t control);
+
+// For structures programmed elsewhere (e.g. driverlib)
+void dma_armed(uint32_t channel_struct, uint32_t bytes);
+
+// Control structure in stop mode (completed, or never armed)
+bool dma_stopped(uint32_t channel_struct);
+
+// Peripheral channels signal completion on the peripheral IRQ:
+// called from there, clears the done flags in 'mask', updates the
+// counters and calls the done callbacks (lowest channel first)
+void dma_dispatch(uint32_t mask);
+
+// Claimed channels as a bit mask
+uint32_t dma_claimed();
+
+const dma_stats_t* dma_get_stats(uint32_t channel);
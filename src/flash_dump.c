@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "byte_order.h"
+#include "crc.h"
+#include "file_system.h"
+#include "flash_dump.h"
+#include "lz.h"
+#include "nor_flash.h"
+
+#define FILL_BYTE 0xFF
+#define FILL_WORD 0xFFFFFFFF
+
+static uint8_t _block[DUMP_BLOCK_SIZE] __attribute__((aligned(4)));
+static uint8_t _record[DUMP_HEADER_SIZE + DUMP_BLOCK_SIZE];
+
+static bool _is_erased(const uint8_t* data, uint32_t len)
+{
+  const uint32_t* p = (const uint32_t*)data;
+  for (uint32_t i = 0; i < len / 4; i++) {
+    if (p[i] != FILL_WORD) return false;
+  }
+  return true;
+}
+
+// CRC32 continued over 'len' erased bytes
+static uint32_t _crc_fill(uint32_t crc, uint32_t len)
+{
+  memset(_block, FILL_BYTE, DUMP_BLOCK_SIZE);
+  for (; len; len -= DUMP_BLOCK_SIZE) {
+    crc = crc32(crc, _block, DUMP_BLOCK_SIZE);
+  }
+  return crc;
+}
+
+static void _send_record(serial_t* serial, uint32_t addr, uint32_t len,
+                         uint8_t kind, uint32_t crc, uint32_t data_len)
+{
+  put_u32_le(_record, addr);
+  put_u32_le(_record + 4, len);
+  _record[8] = kind;
+  put_u32_le(_record + 9, crc);
+  command_reply(serial, CMD_DUMP_FLASH_BIN, _record, DUMP_HEADER_SIZE + data_len);
+}
+
+// Records for [start, end): erased runs are merged,
+// returns 'image_crc' continued over the range
+static uint32_t _dump_range(serial_t* serial, uint32_t start, uint32_t end,
+                            uint32_t image_crc)
+{
+  uint8_t* data = _record + DUMP_HEADER_SIZE;
+
+  uint32_t erased_addr = 0;
+  uint32_t erased_len = 0;
+
+  for (uint32_t addr = start; addr < end; addr += DUMP_BLOCK_SIZE) {
+    // whole erased sectors are not read again once known
+    if (!(addr & FLASH_SECTOR_MASK) &&
+        nor_flash_is_erased(addr, FLASH_SECTOR_SIZE)) {
+      if (!erased_len) erased_addr = addr;
+      erased_len += FLASH_SECTOR_SIZE;
+      image_crc = _crc_fill(image_crc, FLASH_SECTOR_SIZE);
+      addr += FLASH_SECTOR_SIZE - DUMP_BLOCK_SIZE;
+      continue;
+    }
+
+    nor_flash_read(addr, _block, DUMP_BLOCK_SIZE);
+    image_crc = crc32(image_crc, _block, DUMP_BLOCK_SIZE);
+
+    if (_is_erased(_block, DUMP_BLOCK_SIZE)) {
+      if (!erased_len) erased_addr = addr;
+      erased_len += DUMP_BLOCK_SIZE;
+      continue;
+    }
+
+    if (erased_len) {
+      _send_record(serial, erased_addr, erased_len, DUMP_ERASED, 0, 0);
+      erased_len = 0;
+    }
+
+    uint32_t crc = crc32(0, _block, DUMP_BLOCK_SIZE);
+    uint32_t len = lz_compress(_block, DUMP_BLOCK_SIZE, data, DUMP_BLOCK_SIZE);
+    if (len) {
+      _send_record(serial, addr, DUMP_BLOCK_SIZE, DUMP_LZ, crc, len);
+    } else {
+      memcpy(data, _block, DUMP_BLOCK_SIZE);
+      _send_record(serial, addr, DUMP_BLOCK_SIZE, DUMP_RAW, crc,
+                   DUMP_BLOCK_SIZE);
+    }
+  }
+
+  if (erased_len) {
+    _send_record(serial, erased_addr, erased_len, DUMP_ERASED, 0, 0);
+  }
+
+  return image_crc;
+}
+
+void flash_dump_bin(serial_t* serial, const command_t* cmd)
+{
+  uint32_t image_crc = _dump_range(serial, FS_OFFSET, FS_OFFSET + FS_SIZE, 0);
+  _send_record(serial, FS_OFFSET, FS_SIZE, DUMP_END, image_crc, 0);
+}
+
+static inline bool _sector_requested(const command_t* cmd, uint32_t sector)
+{
+  // no bitmap: all sectors
+  if (!cmd->len) return true;
+  if (sector / 8 >= cmd->len) return false;
+  return cmd->payload[sector / 8] & (1 << (sector & 7));
+}
+
+void flash_dump_sectors(serial_t* serial, const command_t* cmd)
+{
+  uint32_t sectors = FS_SIZE / FLASH_SECTOR_SIZE;
+
+  // one range per run of requested sectors
+  for (uint32_t s = 0; s < sectors;) {
+    if (!_sector_requested(cmd, s)) {
+      s++;
+      continue;
+    }
+
+    uint32_t first = s;
+    while (s < sectors && _sector_requested(cmd, s)) s++;
+
+    _dump_range(serial, FS_OFFSET + first * FLASH_SECTOR_SIZE,
+                FS_OFFSET + s * FLASH_SECTOR_SIZE, 0);
+  }
+
+  _send_record(serial, FS_OFFSET, FS_SIZE, DUMP_END, 0, 0);
+}
+
+void flash_manifest(serial_t* serial, const command_t* cmd)
+{
+  static uint8_t manifest[MANIFEST_HEADER_SIZE + 4 * MANIFEST_SECTORS];
+  static uint32_t erased_crc;
+
+  if (!erased_crc) erased_crc = _crc_fill(0, FLASH_SECTOR_SIZE);
+
+  put_u32_le(manifest, FS_OFFSET);
+  put_u32_le(manifest + 4, FLASH_SECTOR_SIZE);
+  manifest[8] = MANIFEST_SECTORS & 0xFF;
+  manifest[9] = MANIFEST_SECTORS >> 8;
+
+  uint8_t* p = manifest + MANIFEST_HEADER_SIZE;
+  for (uint32_t s = 0; s < MANIFEST_SECTORS; s++, p += 4) {
+    uint32_t addr = FS_OFFSET + s * FLASH_SECTOR_SIZE;
+    if (nor_flash_known_erased(addr)) {
+      put_u32_le(p, erased_crc);
+      continue;
+    }
+
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < FLASH_SECTOR_SIZE;
+         offset += DUMP_BLOCK_SIZE) {
+      nor_flash_read(addr + offset, _block, DUMP_BLOCK_SIZE);
+      crc = crc32(crc, _block, DUMP_BLOCK_SIZE);
+    }
+    put_u32_le(p, crc);
+  }
+
+  command_reply(serial, CMD_FLASH_MANIFEST, manifest, sizeof(manifest));
+}
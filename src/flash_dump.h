@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "command.h"
+#include "file_system.h"
+#include "nor_flash.h"
+
+// Binary flash dump: one CMD_DUMP_FLASH_BIN reply per record
+//
+//   [addr u32][len u32][kind u8][crc32 u32][data]
+//
+//  - DUMP_ERASED: 'len' bytes of 0xFF, no data (runs are merged)
+//  - DUMP_RAW:    'len' bytes as is
+//  - DUMP_LZ:     'len' bytes compressed with lz_compress()
+//  - DUMP_END:    last record, crc32 of the whole range
+//
+// crc32 is computed over the uncompressed bytes.
+// All values are little-endian.
+
+#define DUMP_BLOCK_SIZE  1024
+#define DUMP_HEADER_SIZE 13
+
+#define DUMP_ERASED 0
+#define DUMP_RAW    1
+#define DUMP_LZ     2
+#define DUMP_END    0xFF
+
+// Sector manifest (CMD_FLASH_MANIFEST):
+//
+//   [addr u32][sector size u32][count u16][crc32 u32 x count]
+//
+// CRC32 per sector of the FS_OFFSET..FS_SIZE range,
+// known erased sectors are not read.
+#define MANIFEST_HEADER_SIZE 10
+#define MANIFEST_SECTORS     (FS_SIZE / FLASH_SECTOR_SIZE)
+
+// CMD_DUMP_FLASH_BIN handler
+void flash_dump_bin(serial_t* serial, const command_t* cmd);
+
+// CMD_DUMP_SECTORS handler: [sector bitmap] (bit 0 = first sector,
+// empty = all sectors), same records as above and the END record
+// (crc32 = 0)
+void flash_dump_sectors(serial_t* serial, const command_t* cmd);
+
+// CMD_FLASH_MANIFEST handler
+void flash_manifest(serial_t* serial, const command_t* cmd);
@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "byte_order.h"
+#include "crc.h"
+#include "file_system.h"
+#include "flash_load.h"
+#include "timer.h"
+
+#include "debug.h"
+
+#define LOAD_PAYLOAD_SIZE (2 + LOAD_BLOCK_SIZE + 4)
+#define LOAD_FRAME_SIZE   (CMD_HEADER_SIZE + LOAD_PAYLOAD_SIZE + CMD_CRC_SIZE)
+
+// Worst case, a frame ends up split over that many RX slots
+#define LOAD_FRAME_SLOTS ((LOAD_FRAME_SIZE + RX_BUFFER_SIZE - 1) / RX_BUFFER_SIZE + 1)
+
+// Frames the RX slots can hold while we are busy
+// (the slot being received is not usable)
+#define LOAD_WINDOW ((RX_FRAME_SLOTS - 1) / LOAD_FRAME_SLOTS)
+
+// Longer than the host ack timeout (which covers a 32KB block erase)
+#define LOAD_TIMEOUT_MS 3000
+
+typedef struct {
+  serial_t* serial;
+  bool active;
+
+  uint32_t addr;
+  uint32_t size;
+  uint32_t erased_end;
+  uint32_t last_rx;
+
+  uint16_t next_seq;
+  bool nak_sent;
+
+  // block frame reassembly
+  uint8_t frame[LOAD_FRAME_SIZE];
+  uint32_t frame_len;
+} flash_load_t;
+
+static flash_load_t _load;
+
+static void _ack(uint8_t status)
+{
+  uint8_t reply[3] = {
+    status,
+    _load.next_seq & 0xFF,
+    _load.next_seq >> 8,
+  };
+  command_reply(_load.serial, CMD_LOAD_BLOCK, reply, sizeof(reply));
+}
+
+// Only report the first error: the host goes back to 'next_seq'
+static void _nak(uint8_t status)
+{
+  if (_load.nak_sent) return;
+  _load.nak_sent = true;
+  _ack(status);
+}
+
+static void _finish(uint8_t status)
+{
+  uint8_t reply[5] = { status };
+
+  if (status == LOAD_OK) {
+    // read back what has been written
+    uint8_t buffer[LOAD_BLOCK_SIZE];
+    uint32_t crc = 0;
+    for (uint32_t offset = 0; offset < _load.size; offset += sizeof(buffer)) {
+      uint32_t len = _load.size - offset;
+      if (len > sizeof(buffer)) len = sizeof(buffer);
+      uint32_t addr = _load.addr + offset;
+      if (nor_flash_known_erased(addr)) {
+        memset(buffer, 0xFF, len);
+      } else {
+        nor_flash_read(addr, buffer, len);
+      }
+      crc = crc32(crc, buffer, len);
+    }
+    put_u32_le(reply + 1, crc);
+  }
+
+  _load.active = false;
+  serial_set_rx_split(_load.serial, false);
+  command_reply(_load.serial, CMD_LOAD_FLASH, reply, sizeof(reply));
+  debugln("load_flash: done (%d)", status);
+}
+
+// Erase ahead of 'addr': 32KB blocks when possible
+static void _erase_to(uint32_t addr)
+{
+  uint32_t end = _load.addr + _load.size;
+  while (_load.erased_end <= addr) {
+    uint32_t erase_addr = _load.erased_end;
+    uint32_t len = FLASH_SECTOR_SIZE;
+    if (!(erase_addr & FLASH_BLOCK_MASK) &&
+        (end - erase_addr) >= FLASH_BLOCK_SIZE) {
+      len = FLASH_BLOCK_SIZE;
+    }
+
+    // a blank check is much cheaper than an erase
+    if (!nor_flash_is_erased(erase_addr, len)) {
+      if (len == FLASH_BLOCK_SIZE) {
+        nor_flash_erase_block(erase_addr);
+      } else {
+        nor_flash_erase(erase_addr);
+      }
+    }
+    _load.erased_end += len;
+  }
+}
+
+static void _block_received(const command_t* cmd)
+{
+  if (cmd->opcode != CMD_LOAD_BLOCK || cmd->len < 2 + 4) return;
+
+  const uint8_t* data = cmd->payload + 2;
+  uint32_t len = cmd->len - 2 - 4;
+  uint16_t seq = cmd->payload[0] | (cmd->payload[1] << 8);
+
+  if (seq != _load.next_seq) {
+    // duplicate after a lost ack: tell where we are
+    if ((uint16_t)(_load.next_seq - seq) <= LOAD_WINDOW) {
+      _ack(LOAD_OK);
+    } else {
+      _nak(LOAD_ERR_SEQ);
+    }
+    return;
+  }
+
+  uint32_t offset = seq * LOAD_BLOCK_SIZE;
+  uint32_t expected = _load.size - offset;
+  if (expected > LOAD_BLOCK_SIZE) expected = LOAD_BLOCK_SIZE;
+
+  if (len != expected || crc32(0, data, len) != get_u32_le(data + len)) {
+    _nak(LOAD_ERR_CRC);
+    return;
+  }
+
+  // the page program overlaps with receiving the next block
+  uint32_t addr = _load.addr + offset;
+  _erase_to(addr);
+  nor_flash_write(addr, data, len);
+
+  // waiting for an erase does not count as silence from the host
+  _load.last_rx = millis();
+
+  _load.next_seq++;
+  _load.nak_sent = false;
+  _ack(LOAD_OK);
+
+  if (offset + len == _load.size) _finish(LOAD_OK);
+}
+
+void flash_load_start(serial_t* serial, const command_t* cmd)
+{
+  uint8_t reply[4] = { LOAD_ERR_PARAM, LOAD_WINDOW,
+                       LOAD_BLOCK_SIZE & 0xFF, LOAD_BLOCK_SIZE >> 8 };
+
+  if (cmd->len < 8) {
+    command_reply(serial, CMD_LOAD_FLASH, reply, sizeof(reply));
+    return;
+  }
+
+  uint32_t addr = get_u32_le(cmd->payload);
+  uint32_t size = get_u32_le(cmd->payload + 4);
+
+  if ((addr & FLASH_SECTOR_MASK) || addr < FS_OFFSET || size == 0 ||
+      size > FS_OFFSET + FS_SIZE - addr) {
+    command_reply(serial, CMD_LOAD_FLASH, reply, sizeof(reply));
+    return;
+  }
+
+  _load.serial = serial;
+  _load.addr = addr;
+  _load.size = size;
+  _load.erased_end = addr;
+  _load.next_seq = 0;
+  _load.nak_sent = false;
+  _load.frame_len = 0;
+  _load.last_rx = millis();
+  _load.active = true;
+
+  // block frames are longer than a serial frame
+  serial_set_rx_split(serial, true);
+
+  debugln("load_flash: 0x%x (%d bytes)", addr, size);
+
+  reply[0] = LOAD_OK;
+  command_reply(serial, CMD_LOAD_FLASH, reply, sizeof(reply));
+}
+
+bool flash_load_active()
+{
+  return _load.active;
+}
+
+void flash_load_input(const uint8_t* data, uint32_t len)
+{
+  _load.last_rx = millis();
+
+  while (len && _load.active) {
+    uint8_t* frame = _load.frame;
+
+    // resync on the start byte
+    if (_load.frame_len == 0) {
+      const uint8_t* sync = memchr(data, CMD_SYNC, len);
+      if (!sync) return;
+      len -= sync - data;
+      data = sync;
+    }
+
+    // header first, then the rest of the frame
+    uint32_t want = CMD_HEADER_SIZE;
+    if (_load.frame_len >= CMD_HEADER_SIZE) {
+      want += command_payload_len(frame) + CMD_CRC_SIZE;
+    }
+
+    uint32_t n = want - _load.frame_len;
+    if (n > len) n = len;
+    memcpy(frame + _load.frame_len, data, n);
+    _load.frame_len += n;
+    data += n;
+    len -= n;
+
+    if (_load.frame_len < want) continue;
+
+    if (want == CMD_HEADER_SIZE) {
+      // header complete: check the length
+      if (command_payload_len(frame) > LOAD_PAYLOAD_SIZE) {
+        _load.frame_len = 0;
+      }
+      continue;
+    }
+
+    command_t cmd;
+    if (command_decode(frame, _load.frame_len, &cmd)) {
+      _block_received(&cmd);
+    } else {
+      _nak(LOAD_ERR_CRC);
+    }
+    _load.frame_len = 0;
+  }
+}
+
+void flash_load_update()
+{
+  if (!_load.active) return;
+  if (millis() - _load.last_rx < LOAD_TIMEOUT_MS) return;
+
+  nor_flash_sync();
+  _finish(LOAD_ERR_TIMEOUT);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "command.h"
+#include "nor_flash.h"
+
+// Streaming flash upload:
+//
+//  1. CMD_LOAD_FLASH [addr u32][size u32]
+//     -> [status][window][block size u16]
+//
+//  2. CMD_LOAD_BLOCK [seq u16][data][crc32 u32]
+//     -> [status][next seq u16] for each block
+//
+//     Blocks are LOAD_BLOCK_SIZE (last one may be shorter) and
+//     up to 'window' of them may be in flight. On error, blocks are
+//     dropped until 'next seq' is sent again (go-back-N).
+//
+//  3. after the last block:
+//     -> CMD_LOAD_FLASH [status][crc32 of the flash content u32]
+//
+// Sectors are erased on the way, 'addr' must be sector aligned.
+// All values are little-endian.
+
+#define LOAD_BLOCK_SIZE FLASH_PAGE_SIZE
+
+#define LOAD_OK           0
+#define LOAD_ERR_PARAM    1
+#define LOAD_ERR_CRC      2
+#define LOAD_ERR_SEQ      3
+#define LOAD_ERR_TIMEOUT  4
+
+// CMD_LOAD_FLASH handler
+void flash_load_start(serial_t* serial, const command_t* cmd);
+
+// Upload in progress: received frames must go to flash_load_input()
+bool flash_load_active();
+
+// Feed received bytes (block frames may span serial frames)
+void flash_load_input(const uint8_t* data, uint32_t len);
+
+// Abort the upload on timeout
+// (call from the main loop when no frame is pending)
+void flash_load_update();
@@ -1,57 +1,217 @@
+#include <string.h>
+
 #include "file_system.h"
 #include "ihex.h"
 #include "nor_flash.h"
+#include "timer.h"
 
-#include "kk_ihex_write.h"
+#include "debug.h"
 
 #define READ_BLOCK 256
 #define HEX_BLOCK  (READ_BLOCK/16)
-#define FILL_BYTE  0xFF
+#define FILL_WORD  0xFFFFFFFF
+
+// see https://en.wikipedia.org/wiki/Intel_HEX
+#define HEX_TYPE_DATA       0x00
+#define HEX_TYPE_EOF        0x01
+#define HEX_TYPE_EXT_LINEAR 0x04
+
+// ':' + count + address + type + data + checksum + '\n'
+#define HEX_RECORD_SIZE (1 + 2 + 4 + 2 + 2 * HEX_BLOCK + 2 + 1)
+
+// Encoded output drains from alternating buffers (whole records)
+#define TX_BLOCK (6 * HEX_RECORD_SIZE)
+
+// 3-stage pipeline:
+//  - SPI DMA prefetches block N+1 into the other read buffer
+//  - block N is encoded into the current TX buffer
+//  - full TX buffers are handed to the flush callback
+static uint32_t _read_buf[2][READ_BLOCK / 4];
+static char _tx_buf[2][TX_BLOCK];
+static uint32_t _tx_idx;
+static uint32_t _tx_len;
 
 static ihex_flush_cb_t _flush_cb = 0;
 
-void ihex_flush_buffer(struct ihex_state *ihex, char *buffer, char *eptr)
+// Upper 16 bits of the last address written
+static uint32_t _segment;
+
+// Byte -> 2 ASCII chars, stored as a 16-bit word (first char in the LSB)
+#define _HEX_DIGIT(n) ((n) < 10 ? '0' + (n) : 'A' + (n) - 10)
+#define _HEX_PAIR(b)  (_HEX_DIGIT((b) >> 4) | (_HEX_DIGIT((b) & 0xF) << 8))
+
+#define _HEX_ROW(n)                                                            \
+  _HEX_PAIR((n) + 0x0), _HEX_PAIR((n) + 0x1), _HEX_PAIR((n) + 0x2),            \
+  _HEX_PAIR((n) + 0x3), _HEX_PAIR((n) + 0x4), _HEX_PAIR((n) + 0x5),            \
+  _HEX_PAIR((n) + 0x6), _HEX_PAIR((n) + 0x7), _HEX_PAIR((n) + 0x8),            \
+  _HEX_PAIR((n) + 0x9), _HEX_PAIR((n) + 0xA), _HEX_PAIR((n) + 0xB),            \
+  _HEX_PAIR((n) + 0xC), _HEX_PAIR((n) + 0xD), _HEX_PAIR((n) + 0xE),            \
+  _HEX_PAIR((n) + 0xF)
+
+static const uint16_t _hex_table[256] = {
+    _HEX_ROW(0x00), _HEX_ROW(0x10), _HEX_ROW(0x20), _HEX_ROW(0x30),
+    _HEX_ROW(0x40), _HEX_ROW(0x50), _HEX_ROW(0x60), _HEX_ROW(0x70),
+    _HEX_ROW(0x80), _HEX_ROW(0x90), _HEX_ROW(0xA0), _HEX_ROW(0xB0),
+    _HEX_ROW(0xC0), _HEX_ROW(0xD0), _HEX_ROW(0xE0), _HEX_ROW(0xF0),
+};
+
+#if defined(DEBUG)
+// Time spent (in ticks) waiting for each stage
+typedef struct {
+  uint32_t spi_wait;
+  uint32_t tx_wait;
+  uint32_t bytes;
+  uint32_t records;
+} ihex_trace_t;
+
+static ihex_trace_t _trace;
+
+  #define TRACE_START(t) uint32_t t = get_ticks()
+  #define TRACE_END(field, t) _trace.field += get_ticks() - t
+#else
+  #define TRACE_START(t)
+  #define TRACE_END(field, t)
+#endif
+
+static void _tx_flush()
 {
-  if(_flush_cb) _flush_cb(buffer, eptr - buffer);
+  if (!_tx_len) return;
+
+  TRACE_START(t);
+  _flush_cb(_tx_buf[_tx_idx], _tx_len);
+  TRACE_END(tx_wait, t);
+
+#if defined(DEBUG)
+  _trace.bytes += _tx_len;
+#endif
+
+  // the other buffer is free once the callback returns
+  _tx_idx ^= 1;
+  _tx_len = 0;
 }
 
-void ihex_dump_flash(ihex_flush_cb_t cb)
+// single (unaligned) halfword store
+static inline char* _put_hex(char* p, uint8_t b)
+{
+  memcpy(p, &_hex_table[b], 2);
+  return p + 2;
+}
+
+// Encode a record straight into the TX buffer,
+// the checksum is summed in the same pass
+static void _write_record(uint8_t type, uint16_t addr, const uint8_t* data,
+                          uint32_t len)
 {
-  uint8_t buffer[READ_BLOCK];
+  if (TX_BLOCK - _tx_len < HEX_RECORD_SIZE) _tx_flush();
 
-  struct ihex_state ihex;
-  ihex_init(&ihex);
+  char* start = _tx_buf[_tx_idx] + _tx_len;
+  char* p = start;
+  uint8_t sum = len + (addr >> 8) + (addr & 0xFF) + type;
 
+  *p++ = ':';
+  p = _put_hex(p, len);
+  p = _put_hex(p, addr >> 8);
+  p = _put_hex(p, addr & 0xFF);
+  p = _put_hex(p, type);
+
+  for (uint32_t i = 0; i < len; i++) {
+    sum += data[i];
+    p = _put_hex(p, data[i]);
+  }
+
+  p = _put_hex(p, -sum);
+  *p++ = '\n';
+
+  _tx_len += p - start;
+
+#if defined(DEBUG)
+  _trace.records++;
+#endif
+}
+
+static void _write_data(uint32_t addr, const uint8_t* data)
+{
+  uint32_t segment = addr >> 16;
+  if (segment != _segment) {
+    uint8_t ext[2] = { segment >> 8, segment & 0xFF };
+    _write_record(HEX_TYPE_EXT_LINEAR, 0, ext, sizeof(ext));
+    _segment = segment;
+  }
+  _write_record(HEX_TYPE_DATA, addr & 0xFFFF, data, HEX_BLOCK);
+}
+
+static void _encode_block(uint32_t addr, const uint32_t* buffer)
+{
+  const uint32_t* end = buffer + READ_BLOCK / 4;
+  const uint32_t* p = buffer;
+
+  while (p < end) {
+    // skip filling, a word at a time
+    uint32_t mask = p[0] & p[1] & p[2] & p[3];
+    if (mask != FILL_WORD) {
+      uint32_t offset = (p - buffer) * 4;
+      _write_data(addr + offset, (const uint8_t*)p);
+    }
+    p += HEX_BLOCK / 4;
+  }
+}
+
+// Next block to read: erased sectors are skipped without reading
+// them (once they are known to be erased)
+static uint32_t _next_block(uint32_t addr)
+{
+  while (addr < FS_SIZE && !(addr & FLASH_SECTOR_MASK) &&
+         nor_flash_is_erased(addr, FLASH_SECTOR_SIZE)) {
+    addr += FLASH_SECTOR_SIZE;
+  }
+  return addr;
+}
+
+void ihex_dump_flash(ihex_flush_cb_t cb)
+{
   _flush_cb = cb;
+  _tx_len = 0;
+  _segment = 0;
+
+#if defined(DEBUG)
+  memset(&_trace, 0, sizeof(_trace));
+  uint32_t start = get_ticks();
+#endif
+
+  uint32_t addr = _next_block(FS_OFFSET);
+  uint32_t idx = 0;
+  if (addr < FS_SIZE) {
+    nor_flash_read_start(addr, (uint8_t*)_read_buf[idx], READ_BLOCK);
+  }
 
-  uint32_t addr = FS_OFFSET;
   while (addr < FS_SIZE) {
-    // read a block
-    nor_flash_read(addr, buffer, sizeof(buffer));
-
-    uint32_t block_addr = 0;
-    while (block_addr < sizeof(buffer)) {
-      // skip filling
-      while (block_addr < sizeof(buffer)) {
-        uint8_t mask = FILL_BYTE;
-        for (unsigned i = 0; i < HEX_BLOCK; i++) {
-          mask &= buffer[block_addr + i];
-        }
-        if (mask != FILL_BYTE) break;
-        block_addr += HEX_BLOCK;
-      }
-      if (block_addr == sizeof(buffer)) break;
-
-      ihex_write_at_address(&ihex, addr + block_addr);
-      ihex_write_bytes(&ihex, buffer + block_addr, HEX_BLOCK);
-      block_addr += HEX_BLOCK;
+    TRACE_START(t);
+    nor_flash_read_wait();
+    TRACE_END(spi_wait, t);
+
+    // prefetch next block
+    uint32_t next = _next_block(addr + READ_BLOCK);
+    if (next < FS_SIZE) {
+      nor_flash_read_start(next, (uint8_t*)_read_buf[idx ^ 1], READ_BLOCK);
     }
 
-    // next block
-    addr += sizeof(buffer);
+    _encode_block(addr, _read_buf[idx]);
+
+    idx ^= 1;
+    addr = next;
   }
 
-  ihex_end_write(&ihex);
+  _write_record(HEX_TYPE_EOF, 0, 0, 0);
+  _tx_flush();
   _flush_cb = 0;
-}
 
+#if defined(DEBUG)
+  uint32_t total = get_ticks() - start;
+  uint32_t cpu = total - _trace.spi_wait - _trace.tx_wait;
+  debugln("ihex dump: %d bytes in %d us", _trace.bytes, ticks2us(total));
+  debugln("  spi wait %d us, tx wait %d us, cpu %d us",
+          ticks2us(_trace.spi_wait), ticks2us(_trace.tx_wait), ticks2us(cpu));
+  debugln("  %d records, %d cycles/record",
+          _trace.records, _trace.records ? cpu / _trace.records : 0);
+#endif
+}
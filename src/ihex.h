@@ -1,5 +1,8 @@
 #pragma once
 
+// 'buffer' may still be in use when the callback returns
+// (e.g. non-blocking DMA): it is only written again once
+// the following call has returned.
 typedef void (*ihex_flush_cb_t)(char* buffer, unsigned len);
 
 void ihex_dump_flash(ihex_flush_cb_t cb);
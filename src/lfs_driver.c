@@ -13,7 +13,7 @@
 const spi_device_t nor_flash = {
   .frame_format = SPI_POL0_PHA0,
   .data_width = 8,
-  .bit_rate = 12000000, // 12 MHz
+  .bit_rate = 24000000, // 24 MHz: SSI max (system clock / 2)
   .rx = FLASH_MISO,
   .tx = FLASH_MOSI,
   .clk = FLASH_SCLK,
@@ -49,10 +49,7 @@ static int _flash_sync(const struct lfs_config *c)
 static void erase_file_system()
 {
   debug("erasing file system");
-  for (unsigned i = 0; i < BLOCK_COUNT; i++) {
-    nor_flash_erase(ADDR(i, 0));
-    debug(".");
-  }
+  nor_flash_erase_range(FS_OFFSET, FS_SIZE);
   debugln(" [done]");
 }
 
@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "lz.h"
+
+// Single candidate per hash (last position seen)
+#define LZ_HASH_BITS 8
+#define LZ_NO_POS    0xFFFF
+
+static uint16_t _hash_table[1 << LZ_HASH_BITS];
+
+static inline uint32_t _hash(const uint8_t* p)
+{
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+uint32_t lz_compress(const uint8_t* in, uint32_t len, uint8_t* out,
+                     uint32_t out_size)
+{
+  memset(_hash_table, 0xFF, sizeof(_hash_table));
+
+  uint32_t ip = 0, op = 0;
+  uint32_t flag_pos = 0;
+  uint32_t flag_bit = 8;
+
+  while (ip < len) {
+    if (flag_bit == 8) {
+      if (op >= out_size) return 0;
+      flag_pos = op++;
+      out[flag_pos] = 0;
+      flag_bit = 0;
+    }
+
+    uint32_t match_len = 0;
+    uint32_t offset = 0;
+
+    if (ip + LZ_MIN_MATCH <= len) {
+      uint32_t h = _hash(in + ip);
+      uint32_t cand = _hash_table[h];
+      _hash_table[h] = ip;
+
+      if (cand != LZ_NO_POS && ip - cand <= LZ_MAX_OFFSET) {
+        uint32_t max = len - ip;
+        if (max > LZ_MAX_MATCH) max = LZ_MAX_MATCH;
+        while (match_len < max && in[cand + match_len] == in[ip + match_len]) {
+          match_len++;
+        }
+        offset = ip - cand;
+      }
+    }
+
+    if (match_len >= LZ_MIN_MATCH) {
+      if (op + 2 > out_size) return 0;
+      uint32_t token = ((offset - 1) << LZ_LENGTH_BITS) | (match_len - LZ_MIN_MATCH);
+      out[op++] = token & 0xFF;
+      out[op++] = token >> 8;
+      out[flag_pos] |= 1 << flag_bit;
+
+      // index the positions covered by the match
+      for (uint32_t i = 1; i < match_len && ip + i + LZ_MIN_MATCH <= len; i++) {
+        _hash_table[_hash(in + ip + i)] = ip + i;
+      }
+      ip += match_len;
+    } else {
+      if (op >= out_size) return 0;
+      out[op++] = in[ip++];
+    }
+    flag_bit++;
+  }
+
+  return op;
+}
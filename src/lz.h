@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+// LZSS block compressor (no history across blocks)
+//
+//  - a flag byte precedes every 8 tokens, LSB first:
+//    0 = literal byte, 1 = match
+//  - match: 16 bits LE, (offset - 1) << LZ_LENGTH_BITS | (length - LZ_MIN_MATCH)
+//    copied byte by byte (may overlap)
+#define LZ_OFFSET_BITS 10
+#define LZ_LENGTH_BITS 6
+
+#define LZ_MIN_MATCH  3
+#define LZ_MAX_MATCH  (LZ_MIN_MATCH + (1 << LZ_LENGTH_BITS) - 1)
+#define LZ_MAX_OFFSET (1 << LZ_OFFSET_BITS)
+
+// Compress 'len' bytes into 'out':
+// returns the compressed size, or 0 if it does not fit in 'out_size'
+uint32_t lz_compress(const uint8_t* in, uint32_t len, uint8_t* out,
+                     uint32_t out_size);
@@ -6,10 +6,18 @@
 #include <driverlib/uart.h>
 
 #include "board.h"
+#include "byte_order.h"
+#include "command.h"
+#include "crsf.h"
+#include "dma.h"
 #include "file_system.h"
+#include "flash_dump.h"
+#include "flash_load.h"
 #include "ihex.h"
 #include "ppm.h"
+#include "sbus.h"
 #include "serial.h"
+#include "sport.h"
 #include "timer.h"
 #include "uart.h"
 
@@ -23,6 +31,19 @@
 lfs_t lfs;
 lfs_file_t file;
 
+// Host link
+static serial_t serial;
+
+static const uart_device_t serial_uart = {
+  .mode = UART_8N1,
+  .baud_rate = SERIAL_BAUDRATE,
+  .rx = SERIAL_RX_IOD,
+  .tx = SERIAL_TX_IOD,
+  .cts = IOID_UNUSED,
+  .rts = IOID_UNUSED,
+};
+
+
 static bool detect_button()
 {
   uint32_t pin = BUTTON;
@@ -51,6 +72,74 @@ static void leds_init()
 #endif
 }
 
+#if defined(RC_UART)
+// RC input status on the RGB LED: green while frames come in,
+// red on failsafe, back to blue once they stop
+#define RC_INPUT_TIMEOUT_MS 100
+
+#define RC_COLOR_IDLE     LED_COLOR(0x00, 0x00, 0x60)
+#define RC_COLOR_OK       LED_COLOR(0x00, 0x60, 0x00)
+#define RC_COLOR_FAILSAFE LED_COLOR(0x60, 0x00, 0x00)
+
+static uint32_t rc_last_frame;
+static uint32_t rc_color = RC_COLOR_IDLE;
+
+static void rc_input_init()
+{
+#if defined(RC_INPUT_CRSF)
+  crsf_init(RC_UART, RC_CRSF_IOD, RC_CRSF_IOD, CRSF_BAUDRATE);
+#else
+  sbus_init(RC_UART, RC_SBUS_IOD);
+#endif
+}
+
+// New frame received: 'failsafe' set from its flags
+static bool rc_input_poll(bool* failsafe)
+{
+#if defined(RC_INPUT_CRSF)
+  uint16_t channels[RC_CHANNELS];
+  *failsafe = false;
+  return crsf_get_channels(channels);
+#else
+  sbus_frame_t frame;
+  if (!sbus_get_frame(&frame)) return false;
+  *failsafe = (frame.flags & SBUS_FLAG_FAILSAFE) != 0;
+  return true;
+#endif
+}
+
+static void rc_input_update()
+{
+  uint32_t color = rc_color;
+
+  bool failsafe;
+  if (rc_input_poll(&failsafe)) {
+    rc_last_frame = millis();
+    color = failsafe ? RC_COLOR_FAILSAFE : RC_COLOR_OK;
+  } else if (millis() - rc_last_frame > RC_INPUT_TIMEOUT_MS) {
+    color = RC_COLOR_IDLE;
+  }
+
+  // LED only written on changes
+  if (color == rc_color) return;
+  rc_color = color;
+#if defined(LED_SPI) && defined(LED_DIN)
+  led_rgb_set_color(color);
+#endif
+}
+#endif
+
+#if defined(SPORT_UART) && !defined(RC_UART)
+// S.PORT telemetry: sensor values logged over RTT
+static uint32_t sport_values;
+
+static void sport_data(uint8_t phys_id, uint16_t app_id, uint32_t value)
+{
+  sport_values++;
+  debugln("[S.PORT]: sensor 0x%02x, 0x%04x = %d", phys_id, app_id, value);
+}
+#endif
+
 static const char lorem_ipsum[] =
     // Section 1.10.32 of "de Finibus Bonorum et Malorum", written by Cicero in 45 BC
     "Sed ut perspiciatis unde omnis iste natus error sit voluptatem \n"
@@ -89,7 +178,7 @@ static void test_print_file()
       int read = lfs_file_read(&lfs, &file, buffer, sizeof(buffer));
       if (read > 0) {
         read_count += read;
-        serial_write_dma((uint8_t*)buffer, read, true);
+        serial_write_dma(&serial, (uint8_t*)buffer, read, true);
       }
     }
   }
@@ -97,26 +186,130 @@ static void test_print_file()
   lfs_file_close(&lfs, &file);
 }
 
+static void ihex_flush_cb(char* buffer, unsigned len)
+{
+  // drains in the background while the next buffer is encoded
+  serial_write_dma(&serial, buffer, len, false);
+}
+
 // Commands
 #define SERIAL_TEST_CMD 0xAA
-#define DUMP_FLASH "dump_flash"
-#define LOAD_FLASH "load_flash"
 
-static bool command_chr_equal(char cmd)
+static void cmd_dump_flash(serial_t* serial, const command_t* cmd)
 {
-  return rx_buf[0] == cmd;
+  ihex_dump_flash(ihex_flush_cb);
 }
 
-static bool command_equal(const char* cmd)
+// Per claimed channel: [channel u8][transfers u32][bytes u32][errors u32]
+#define DMA_STATS_RECORD_SIZE 13
+
+static void cmd_dma_stats(serial_t* serial, const command_t* cmd)
 {
-  return strncmp(cmd, (const char*)rx_buf, rx_len) == 0;
+  static uint8_t reply[32 * DMA_STATS_RECORD_SIZE];
+  uint32_t len = 0;
+
+  uint32_t claimed = dma_claimed();
+  while (claimed) {
+    uint32_t channel = __builtin_ctz(claimed);
+    claimed &= claimed - 1;
+
+    const dma_stats_t* stats = dma_get_stats(channel);
+    uint8_t* p = &reply[len];
+    p[0] = channel;
+    put_u32_le(p + 1, stats->transfers);
+    put_u32_le(p + 5, stats->bytes);
+    put_u32_le(p + 9, stats->errors);
+    len += DMA_STATS_RECORD_SIZE;
+  }
+
+  command_reply(serial, CMD_DMA_STATS, reply, len);
 }
 
-static void ihex_flush_cb(char* buffer, unsigned len)
+#if defined(DEBUG)
+// Per instance traffic and IRQ cycles per byte,
+// frame slot usage of the host link, logged over RTT
+static void cmd_uart_stats(serial_t* serial, const command_t* cmd)
 {
-  serial_write_dma(buffer, len, true);
+  for (uart_t uart = UART0; uart <= UART1; uart++) {
+    const uart_stats_t* stats = uart_get_stats(uart);
+    uint32_t bytes = stats->rx_bytes + stats->tx_bytes;
+    debugln("[UART%d]: %d IRQs, %d bytes received, %d sent, %d cycles/byte",
+            uart, stats->irqs, stats->rx_bytes, stats->tx_bytes,
+            bytes ? stats->irq_ticks / bytes : 0);
+  }
+
+  debugln("[serial]: %d/%d slots used at most, max wait %d us, "
+          "%d overflows, %d errors",
+          serial->rx_max_used, RX_FRAME_SLOTS - 1,
+          ticks2us(serial->rx_max_wait), serial_rx_overflows(serial),
+          serial_rx_errors(serial));
+
+#if defined(SPORT_UART) && !defined(RC_UART)
+  debugln("[S.PORT]: %d sensor values", sport_values);
+#endif
+
+#if defined(RC_UART) && defined(RC_INPUT_CRSF)
+  const crsf_stats_t* crsf = crsf_get_stats();
+  debugln("[CRSF]: %d RC frames, handled in %d us at most, %d CRC errors",
+          crsf->rc_frames, ticks2us(crsf->max_reply_ticks), crsf_crc_errors());
+#endif
 }
 
+// Chunks that fit in the TX ring: no producer busy-wait
+#define UART_BENCH_CHUNK (TX_BUFFER_SIZE - 8)
+
+// TX ring cost in CPU cycles per byte, previous path vs current one
+// (sends the text twice to the host)
+static void cmd_uart_bench(serial_t* serial, const command_t* cmd)
+{
+  uint32_t cycles[2] = { 0, 0 };
+  const uint32_t len = sizeof(lorem_ipsum) - 1;
+
+  for (uint32_t legacy = 0; legacy < 2; legacy++) {
+    for (uint32_t pos = 0; pos < len; pos += UART_BENCH_CHUNK) {
+      uint32_t n = len - pos;
+      if (n > UART_BENCH_CHUNK) n = UART_BENCH_CHUNK;
+      cycles[legacy] += uart_bench_tx_irq(serial->uart, lorem_ipsum + pos, n, legacy);
+    }
+  }
+
+  debugln("[UART%d]: TX ring %d cycles/byte (one byte per call: %d)",
+          serial->uart, cycles[0] / len, cycles[1] / len);
+}
+#endif
+
+static const command_handler_t command_handlers[CMD_OPCODES] = {
+  [CMD_DUMP_FLASH] = cmd_dump_flash,
+  [CMD_LOAD_FLASH] = flash_load_start,
+  [CMD_DUMP_FLASH_BIN] = flash_dump_bin,
+  [CMD_FLASH_MANIFEST] = flash_manifest,
+  [CMD_DUMP_SECTORS] = flash_dump_sectors,
+  [CMD_DMA_STATS] = cmd_dma_stats,
+#if defined(DEBUG)
+  [CMD_UART_STATS] = cmd_uart_stats,
+  [CMD_UART_BENCH] = cmd_uart_bench,
+#endif
+};
+
+static const command_alias_t command_aliases[] = {
+  { "dump_flash", CMD_DUMP_FLASH },
+  { "load_flash", CMD_LOAD_FLASH },
+  { "dump_flash_bin", CMD_DUMP_FLASH_BIN },
+  { "flash_manifest", CMD_FLASH_MANIFEST },
+  { "dump_sectors", CMD_DUMP_SECTORS },
+  { "dma_stats", CMD_DMA_STATS },
+#if defined(DEBUG)
+  { "uart_stats", CMD_UART_STATS },
+  { "uart_bench", CMD_UART_BENCH },
+#endif
+};
+
+static const command_table_t commands = {
+  .handlers = command_handlers,
+  .aliases = command_aliases,
+  .n_aliases = sizeof(command_aliases) / sizeof(command_aliases[0]),
+};
+
 int main(void)
 {
   board_init();
@@ -132,7 +325,13 @@ int main(void)
   ppm_timer_init(SERIAL_RX_IOD);
   bool ppm_detected = detect_ppm(100);
 
-  serial_init();
+  serial_init(&serial, UART0, &serial_uart);
+#if defined(RC_UART)
+  rc_input_init();
+#elif defined(SPORT_UART)
+  // single wire on the direct pin, the IOC does the inversion
+  sport_init(SPORT_UART, IOID_UNUSED, SPORT_TX_IOD, sport_data);
+#endif
   leds_init();
 
   debugln("## Boot completed ##");
@@ -154,32 +353,35 @@ int main(void)
   }
 
   while (true) {
-    if (frame_received) {
-      if (rx_len > 0) {
-        // Echo RX buffer content
-        // serial_write_dma(rx_buf, rx_len);
-
-        if (command_chr_equal(SERIAL_TEST_CMD)) {
-          // reply with received len
-          uint8_t data = (uint8_t)rx_len;
-          serial_write_dma(&data, 1, true);
-          goto reset_frame;
-        }
-
-        if (command_equal(DUMP_FLASH)) {
-          ihex_dump_flash(ihex_flush_cb);
-          goto reset_frame;
-        }
-
-        if (command_equal(LOAD_FLASH)) {
-          goto reset_frame;
-        }
-      }
+#if defined(RC_UART)
+    rc_input_update();
+#elif defined(SPORT_UART)
+    sport_update();
+#endif
+    const serial_frame_t* frame = serial_get_frame(&serial);
+    if (!frame) {
+      flash_load_update();
+      continue;
+    }
 
-    reset_frame:
-      // Reset RX buffer
-      uart_reset_rx_len(UART0);
-      frame_received = false;
+    if (flash_load_active()) {
+      flash_load_input(frame->data, frame->len);
+      goto release_frame;
     }
+
+    // Echo RX buffer content
+    // serial_write_dma(&serial, frame->data, frame->len);
+
+    if (frame->data[0] == SERIAL_TEST_CMD) {
+      // reply with received len
+      uint8_t data = (uint8_t)frame->len;
+      serial_write_dma(&serial, &data, 1, true);
+      goto release_frame;
+    }
+
+    command_dispatch(&serial, &commands, frame);
+
+  release_frame:
+    serial_release_frame(&serial);
   }
 }
@@ -1,6 +1,9 @@
+#include <driverlib/cpu.h>
+
 #include "nor_flash.h"
 #include "debug.h"
 #include "spi.h"
+#include "timer.h"
 
 #define FLASH_CMD_READ_ID       0x90
 #define FLASH_CMD_READ_JEDEC_ID 0x9f
@@ -8,67 +11,188 @@
 
 #define FLASH_CMD_WRITE         0x02
 #define FLASH_CMD_READ          0x03
+#define FLASH_CMD_FAST_READ     0x0b
 
 #define FLASH_CMD_STATUS        0x05
 #define FLASH_CMD_WRITE_ENABLE  0x06
 
 #define FLASH_CMD_ERASE_4KB     0x20
 #define FLASH_CMD_ERASE_32KB    0x52
+#define FLASH_CMD_ERASE_64KB    0xd8
 #define FLASH_CMD_CHIP_ERASE    0xc7
 
-#define FLASH_SECTOR_SIZE 4096
-#define FLASH_SECTOR_MASK (FLASH_SECTOR_SIZE - 1)
+#define FLASH_STATUS_BUSY 0x01
 
-#define FLASH_BLOCK_SIZE 32768
-#define FLASH_BLOCK_MASK (FLASH_BLOCK_SIZE - 1)
+#define FLASH_DMA_THRESHOLD 8
 
-#define FLASH_PAGE_SIZE 256
-#define FLASH_PAGE_MASK (FLASH_PAGE_SIZE - 1)
+// Erased-sector bitmap: up to 16MB (24-bit addresses)
+#define FLASH_MAX_SECTORS (16 * 1024 * 1024 / FLASH_SECTOR_SIZE)
 
-#define FLASH_DMA_THRESHOLD 8
+// Blank check read size: small enough for an early exit to be cheap
+#define FLASH_CHECK_SIZE 64
+
+// Status polling interval once the typical time is over:
+// typical time / 8, within these bounds
+#define FLASH_POLL_MIN_US 50
+#define FLASH_POLL_MAX_US 2000
+
+#define FILL_WORD 0xFFFFFFFF
 
 typedef struct {
   uint8_t vendor_id;
   uint8_t device_id;
 } nor_flash_id_t;
 
+// SFDP erase types (BFPT DWORDs 8-9)
+#define FLASH_ERASE_TYPES 4
+
+typedef struct {
+  uint8_t log2size; // 0: unused
+  uint8_t cmd;
+  uint32_t typ_us; // typical erase time (0: unknown)
+} nor_flash_erase_type_t;
+
+// Suspend / resume (BFPT DWORDs 12-13) of a program or an erase
+typedef struct {
+  uint8_t suspend_cmd; // 0: not supported, reads wait for the op
+  uint8_t resume_cmd;
+  uint32_t interval_us; // min time from resume to suspend (tRS)
+} nor_flash_suspend_t;
+
 typedef struct {
   nor_flash_id_t id;
   uint32_t log2size;
+  uint8_t read_cmd;
+  uint8_t read_dummy; // bytes
+  nor_flash_erase_type_t erase_types[FLASH_ERASE_TYPES]; // largest first
+
+  // SFDP typical times (0: unknown), max = typical * multiplier
+  uint32_t program_us; // page
+  uint32_t chip_erase_us;
+  uint8_t program_max_mult;
+  uint8_t erase_max_mult;
+
+  nor_flash_suspend_t suspend[2]; // program, erase
 } nor_flash_descriptor_t;
 
+// Command, address and dummy bytes
+#define FLASH_READ_HEADER_MAX 5
+
+// Background read: command + data in one SPI transaction
 typedef struct {
-  spi_t spi;
+  uint8_t cmd[FLASH_READ_HEADER_MAX];
+  spi_segment_t segments[2];
+  spi_xfer_t xfer;
+} nor_flash_read_t;
+
+// Page program: Write Enable, then command + data, queued back to back
+typedef struct {
+  uint8_t wren_cmd;
+  uint8_t cmd[4];
+  spi_segment_t wren_segment;
+  spi_segment_t segments[2];
+  spi_xfer_t wren_xfer;
+  spi_xfer_t xfer;
+} nor_flash_prog_t;
+
+// One page programming, the next one queued behind it
+#define FLASH_PROG_STAGES 2
+
+// Program / erase in progress:
+//  - polled with queued SPI transactions (from the timer tick,
+//    or by a blocked caller)
+//  - suspended by reads (if supported, and not before tRS has
+//    elapsed since the last resume), resumed from the tick (or
+//    before the next program / erase) once no read is pending
+//  - next_prog: page program started from the poll IRQ that
+//    sees the current op done
+typedef enum {
+  FLASH_OP_IDLE,
+  FLASH_OP_BUSY,
+  FLASH_OP_SUSPENDED,
+} nor_flash_op_state_t;
+
+typedef struct {
+  volatile uint8_t state;
+  volatile bool reading;
+  bool erase;
+
+  // erased once done
+  uint32_t first_sector;
+  uint32_t n_sectors;
+
+  // no status poll before the typical time
+  uint32_t start_us;
+  uint32_t typ_us;
+  uint32_t max_us;
+
+  // start, or end of the last resume command
+  volatile uint32_t resume_us;
+
+  nor_flash_prog_t* volatile next_prog;
+
+  uint8_t status_cmd[2];
+  uint8_t status[2];
+  uint8_t resume_cmd;
+  spi_segment_t status_segment;
+  spi_segment_t resume_segment;
+  spi_xfer_t status_xfer;
+  spi_xfer_t resume_xfer;
+} nor_flash_op_t;
+
+typedef struct {
+  spi_bus_device_t dev;
   nor_flash_descriptor_t desc;
+  nor_flash_read_t read;
+  nor_flash_prog_t prog[FLASH_PROG_STAGES];
+  nor_flash_op_t op;
 } nor_flash_state_t;
 
 static nor_flash_state_t _flash_state;
 
+// Bit set: sector known to be erased (cleared by writes)
+static uint32_t _erased_sectors[FLASH_MAX_SECTORS / 32];
+
+static inline void _set_erased(uint32_t sector)
+{
+  _erased_sectors[sector / 32] |= 1u << (sector & 31);
+}
+
+static inline void _clear_erased(uint32_t sector)
+{
+  _erased_sectors[sector / 32] &= ~(1u << (sector & 31));
+}
+
+static inline bool _is_known_erased(uint32_t sector)
+{
+  return _erased_sectors[sector / 32] & (1u << (sector & 31));
+}
+
 static inline void flash_select() {
-  spi_select(_flash_state.spi);
+  spi_device_select(&_flash_state.dev);
 }
 
 static inline void flash_unselect() {
-  spi_unselect(_flash_state.spi);
+  spi_device_unselect(&_flash_state.dev);
 }
 
 static inline void flash_transfer(const uint8_t* tx, uint8_t* rx, uint32_t len) {
-  spi_transfer_8(_flash_state.spi, tx, rx, len);
+  spi_transfer_8(_flash_state.dev.spi, tx, rx, len);
 }
 
 static inline void flash_write(const uint8_t* data, uint32_t len) {
   if (len > FLASH_DMA_THRESHOLD) {
-    spi_write_dma_8(_flash_state.spi, data, len, true);
+    spi_write_dma_8(_flash_state.dev.spi, data, len, true);
   } else {
-    spi_write_8(_flash_state.spi, data, len);
+    spi_write_8(_flash_state.dev.spi, data, len);
   }
 }
 
 static inline void flash_read(uint8_t* data, uint32_t len) {
   if (len > FLASH_DMA_THRESHOLD) {
-    spi_read_dma_8(_flash_state.spi, data, len, true);
+    spi_read_dma_8(_flash_state.dev.spi, data, len, true);
   } else {
-    spi_read_8(_flash_state.spi, data, len);
+    spi_read_8(_flash_state.dev.spi, data, len);
   }
 }
 
@@ -91,19 +215,266 @@ static inline void do_cmd(uint8_t cmd, const uint8_t* tx, uint8_t* rx, uint16_t
   flash_unselect();
 }
 
+// Command and status in a single FIFO burst
+static uint8_t read_status()
+{
+  const uint8_t tx[2] = {FLASH_CMD_STATUS, 0};
+  uint8_t rx[2];
+
+  flash_select();
+  flash_transfer(tx, rx, sizeof(tx));
+  flash_unselect();
+  return rx[1];
+}
+
 static void wait_for_not_busy()
 {
+  while (read_status() & 0x01) {}
+}
+
+#if defined(DEBUG)
+#define STATUS_POLL_BENCH 256
+
+// Status poll latency in CPU cycles (ticks run at the CPU clock)
+static void _bench_status_poll()
+{
+  uint32_t start = get_ticks();
+  for (int i = 0; i < STATUS_POLL_BENCH; i++) read_status();
+  uint32_t burst = get_ticks() - start;
+
+  // previous path: split command, one frame at a time
+  const uint8_t cmd = FLASH_CMD_STATUS;
   uint8_t status;
-  do {
-    do_cmd(FLASH_CMD_STATUS, 0, &status, 1);
-  } while (status & 0x01);
+  start = get_ticks();
+  for (int i = 0; i < STATUS_POLL_BENCH; i++) {
+    flash_select();
+    spi_transfer_8_per_frame(_flash_state.dev.spi, &cmd, 0, 1);
+    spi_transfer_8_per_frame(_flash_state.dev.spi, 0, &status, 1);
+    flash_unselect();
+  }
+  uint32_t before = get_ticks() - start;
+
+  debugln("[NOR flash]: status poll %d cycles (previous path: %d cycles)",
+          burst / STATUS_POLL_BENCH, before / STATUS_POLL_BENCH);
 }
+#endif
 
 static void write_enable()
 {
   do_cmd(FLASH_CMD_WRITE_ENABLE, 0, 0, 0);
 }
 
+static void _op_done()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+
+  uint32_t primask = CPUcpsid();
+  if (op->state != FLASH_OP_IDLE) {
+    for (uint32_t i = 0; i < op->n_sectors; i++) {
+      _set_erased(op->first_sector + i);
+    }
+    op->state = FLASH_OP_IDLE;
+  }
+  if (!primask) CPUcpsie();
+}
+
+static void _op_start(uint32_t first_sector, uint32_t n_sectors,
+                      uint32_t typ_us, uint32_t max_mult);
+
+// Status polls are queued behind the program
+static void _prog_submit(nor_flash_prog_t* prog)
+{
+  spi_submit(_flash_state.dev.spi, &prog->wren_xfer);
+  spi_submit(_flash_state.dev.spi, &prog->xfer);
+
+  const nor_flash_descriptor_t* desc = &_flash_state.desc;
+  _op_start(0, 0, desc->program_us, desc->program_max_mult);
+}
+
+// A suspended op never reports busy: only trust polls
+// made while running (queued before any suspend).
+// The next page goes out right away, without waking anyone up.
+static void _op_status_done(void* ctx)
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  if (op->state == FLASH_OP_BUSY && !(op->status[1] & FLASH_STATUS_BUSY)) {
+    _op_done();
+
+    nor_flash_prog_t* prog = op->next_prog;
+    if (prog) {
+      op->next_prog = 0;
+      _prog_submit(prog);
+    }
+  }
+}
+
+static void _op_resumed(void* ctx)
+{
+  _flash_state.op.resume_us = micros();
+}
+
+static void _op_init()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  op->state = FLASH_OP_IDLE;
+  op->next_prog = 0;
+
+  op->status_cmd[0] = FLASH_CMD_STATUS;
+  op->status_segment = (spi_segment_t){ op->status_cmd, op->status, 2 };
+  op->status_xfer.segments = &op->status_segment;
+  op->status_xfer.n_segments = 1;
+  op->status_xfer.data_size = 1;
+  op->status_xfer.flags = SPI_XFER_CS;
+  op->status_xfer.dev = &_flash_state.dev;
+  op->status_xfer.done = _op_status_done;
+
+  op->resume_segment = (spi_segment_t){ &op->resume_cmd, 0, 1 };
+  op->resume_xfer.segments = &op->resume_segment;
+  op->resume_xfer.n_segments = 1;
+  op->resume_xfer.data_size = 1;
+  op->resume_xfer.flags = SPI_XFER_CS;
+  op->resume_xfer.dev = &_flash_state.dev;
+  op->resume_xfer.done = _op_resumed;
+}
+
+static void _op_start(uint32_t first_sector, uint32_t n_sectors,
+                      uint32_t typ_us, uint32_t max_mult)
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  op->first_sector = first_sector;
+  op->n_sectors = n_sectors;
+  op->erase = n_sectors != 0;
+
+  uint64_t max_us = (uint64_t)typ_us * max_mult;
+  op->typ_us = typ_us;
+  op->max_us = max_us > UINT32_MAX ? UINT32_MAX : max_us;
+  op->start_us = micros();
+  op->resume_us = op->start_us;
+  op->state = FLASH_OP_BUSY;
+}
+
+static uint32_t _op_elapsed()
+{
+  return micros() - _flash_state.op.start_us;
+}
+
+// Queued: status polls submitted afterwards see the op running again
+static void _op_resume()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+
+  uint32_t primask = CPUcpsid();
+  if (op->state == FLASH_OP_SUSPENDED) {
+    op->state = FLASH_OP_BUSY;
+    op->resume_cmd = _flash_state.desc.suspend[op->erase].resume_cmd;
+    spi_submit(_flash_state.dev.spi, &op->resume_xfer);
+  }
+  if (!primask) CPUcpsie();
+}
+
+static void _op_wait();
+
+// Reads don't wait for a program / erase: suspend it (tSUS, ~20-30 us).
+// A suspend closer than tRS to the last resume waits: back to back
+// reads would otherwise starve the op. Without suspend support,
+// reads wait for the op to complete.
+static void _op_suspend()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  if (op->state != FLASH_OP_BUSY) return;
+
+  const nor_flash_suspend_t* suspend = &_flash_state.desc.suspend[op->erase];
+  if (!suspend->suspend_cmd) {
+    _op_wait();
+    return;
+  }
+
+  // tRS counts from the end of a queued resume
+  spi_xfer_wait(&op->resume_xfer);
+  uint32_t running = micros() - op->resume_us;
+  if (running < suspend->interval_us) {
+    sleep_us(suspend->interval_us - running);
+  }
+
+  uint32_t primask = CPUcpsid();
+  bool busy = op->state == FLASH_OP_BUSY;
+  if (busy) op->state = FLASH_OP_SUSPENDED;
+  if (!primask) CPUcpsie();
+
+  if (busy) {
+    do_cmd(suspend->suspend_cmd, 0, 0, 0);
+    wait_for_not_busy();
+  }
+}
+
+// Queue a status poll, unless one is in flight already
+static void _op_poll()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+
+  uint32_t primask = CPUcpsid();
+  if (op->state == FLASH_OP_BUSY && !op->status_xfer.busy) {
+    spi_submit(_flash_state.dev.spi, &op->status_xfer);
+  }
+  if (!primask) CPUcpsie();
+}
+
+// Blocking: resumes a suspended op, sleeps until its typical
+// completion time, then polls the status at a coarse interval.
+// 'next_only': until a queued page program has started,
+// otherwise until everything is done.
+static void _op_sync(bool next_only)
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  _op_resume();
+
+#if defined(DEBUG)
+  bool late = false;
+#endif
+
+  while (op->next_prog || (!next_only && op->state != FLASH_OP_IDLE)) {
+    uint32_t elapsed = _op_elapsed();
+    if (elapsed < op->typ_us) {
+      sleep_us(op->typ_us - elapsed);
+      continue;
+    }
+
+    // same queue as the tick's polls: never in the middle of
+    // another transaction
+    _op_poll();
+    spi_xfer_wait(&op->status_xfer);
+    if (!op->next_prog && (next_only || op->state == FLASH_OP_IDLE)) break;
+
+#if defined(DEBUG)
+    if (!late && op->max_us && _op_elapsed() > op->max_us) {
+      debugln("[NOR flash]: op exceeds max time (%d us)", op->max_us);
+      late = true;
+    }
+#endif
+
+    uint32_t interval = op->typ_us / 8;
+    if (interval < FLASH_POLL_MIN_US) interval = FLASH_POLL_MIN_US;
+    if (interval > FLASH_POLL_MAX_US) interval = FLASH_POLL_MAX_US;
+    sleep_us(interval);
+  }
+}
+
+static void _op_wait()
+{
+  _op_sync(false);
+}
+
+static void _flash_tick()
+{
+  nor_flash_op_t* op = &_flash_state.op;
+
+  if (op->state == FLASH_OP_SUSPENDED) {
+    if (!op->reading && !_flash_state.read.xfer.busy) _op_resume();
+  } else if (op->state == FLASH_OP_BUSY && _op_elapsed() >= op->typ_us) {
+    _op_poll();
+  }
+}
+
 static void read_id(nor_flash_id_t* id)
 {
   uint8_t buf[4] = {FLASH_CMD_READ_ID, 0, 0, 0};
@@ -130,6 +501,81 @@ static inline uint32_t bytes_to_u32le(const uint8_t *b) {
   return b[0] | (b[1] << 8) | (b[2] << 16) | (b[3] << 24);
 }
 
+// BFPT DWORDs read (up to suspend / resume)
+#define FLASH_BFPT_DWORDS 13
+#define FLASH_BFPT_TIMINGS 11
+#define FLASH_BFPT_ERASE_TYPES 9
+
+// 10th DWORD: erase type N typical time
+// (count + 1) * unit, 5 bit count at 4 + 7 * N, then 2 bit unit
+static uint32_t _erase_time_us(uint32_t times, uint32_t i)
+{
+  static const uint32_t units_us[] = { 1000, 16000, 128000, 1000000 };
+  uint32_t shift = 4 + 7 * i;
+  if (!times) return 0;
+  return (((times >> shift) & 0x1f) + 1) * units_us[(times >> (shift + 5)) & 3];
+}
+
+// Sorted largest first, smaller than a sector are ignored
+// (erased sectors are tracked per sector)
+static void _parse_erase_types(const uint8_t* dwords, uint32_t times)
+{
+  nor_flash_erase_type_t* types = _flash_state.desc.erase_types;
+  uint32_t n = 0;
+
+  for (uint32_t i = 0; i < FLASH_ERASE_TYPES; i++) {
+    nor_flash_erase_type_t type = {
+      dwords[2 * i], dwords[2 * i + 1], _erase_time_us(times, i)
+    };
+    if (type.log2size < 12 || type.log2size > 24) continue;
+
+    uint32_t j = n++;
+    for (; j > 0 && types[j - 1].log2size < type.log2size; j--) {
+      types[j] = types[j - 1];
+    }
+    types[j] = type;
+  }
+
+  for (; n < FLASH_ERASE_TYPES; n++) types[n].log2size = 0;
+}
+
+// Max time multipliers: 2 * (count + 1)
+static void _parse_timings(const uint8_t* dwords)
+{
+  nor_flash_descriptor_t* desc = &_flash_state.desc;
+  uint32_t erase = bytes_to_u32le(dwords);
+  uint32_t program = bytes_to_u32le(dwords + 4);
+
+  desc->erase_max_mult = 2 * ((erase & 0xf) + 1);
+  desc->program_max_mult = 2 * ((program & 0xf) + 1);
+
+  // page program: 5 bit count, unit 8 or 64 us
+  desc->program_us = (((program >> 8) & 0x1f) + 1) * ((program & (1 << 13)) ? 64 : 8);
+
+  // chip erase: 5 bit count, unit 16 ms, 256 ms, 4 s or 64 s
+  static const uint32_t units_ms[] = { 16, 256, 4000, 64000 };
+  desc->chip_erase_us = (((program >> 24) & 0x1f) + 1) * units_ms[(program >> 29) & 3] * 1000;
+}
+
+// 12th DWORD: bit 31 clear if supported, resume to suspend intervals
+// (count + 1) * 64 us, 4 bit count at 9 (program) and 20 (erase)
+// 13th DWORD: erase suspend / resume, program suspend / resume opcodes
+static void _parse_suspend(const uint8_t* dwords)
+{
+  nor_flash_suspend_t* suspend = _flash_state.desc.suspend;
+  uint32_t caps = bytes_to_u32le(dwords);
+  uint32_t cmds = bytes_to_u32le(dwords + 4);
+  if (caps & (1u << 31)) return;
+
+  suspend[0].suspend_cmd = (cmds >> 8) & 0xff;
+  suspend[0].resume_cmd = cmds & 0xff;
+  suspend[0].interval_us = (((caps >> 9) & 0xf) + 1) * 64;
+
+  suspend[1].suspend_cmd = cmds >> 24;
+  suspend[1].resume_cmd = (cmds >> 16) & 0xff;
+  suspend[1].interval_us = (((caps >> 20) & 0xf) + 1) * 64;
+}
+
 static int read_sfdp()
 {
   // check magic signature
@@ -147,12 +593,17 @@ static int read_sfdp()
     return -1;
   }
 
-  // read param table
+  // read param table (length in DWORDs)
   uint32_t param_table_ptr = bytes_to_u32le(rxbuf + 12) & 0xffffffu;
-  read_sfdp_block(param_table_ptr, rxbuf, 8);
+  uint32_t param_table_len = rxbuf[11];
+  if (param_table_len > FLASH_BFPT_DWORDS) param_table_len = FLASH_BFPT_DWORDS;
+  if (param_table_len < 2) param_table_len = 2;
+
+  uint8_t bfpt[FLASH_BFPT_DWORDS * 4];
+  read_sfdp_block(param_table_ptr, bfpt, param_table_len * 4);
 
   // 1st DWORD
-  uint32_t param_table_dword = bytes_to_u32le(rxbuf);
+  uint32_t param_table_dword = bytes_to_u32le(bfpt);
 
   if ((param_table_dword & 3) != 1) {
     // 4 kilobyte erase is unavailable
@@ -171,7 +622,7 @@ static int read_sfdp()
   // - MSB set: array >= 2 Gbit, encoded as log2 of number of bits
   // - MSB clear: array < 2 Gbit, encoded as direct bit count
   
-  param_table_dword = bytes_to_u32le(rxbuf + 4);
+  param_table_dword = bytes_to_u32le(bfpt + 4);
   if (param_table_dword & (1u << 31)) {
     param_table_dword &= ~(1u << 31);
   } else {
@@ -185,19 +636,107 @@ static int read_sfdp()
   uint32_t log2size = param_table_dword - 3;
   _flash_state.desc.log2size = log2size;
 
+  // SFDP only describes the multi-IO fast reads (1-1-2, 1-2-2, ...),
+  // which the SSI can't do: single-IO Fast Read is mandatory on SFDP
+  // devices, with 8 dummy clocks
+  _flash_state.desc.read_cmd = FLASH_CMD_FAST_READ;
+  _flash_state.desc.read_dummy = 1;
+
+  // 8th & 9th DWORDs: erase types (size as log2, opcode)
+  // 10th & 11th DWORDs (JESD216A+): typical times & max multipliers
+  // 12th & 13th DWORDs (JESD216B+): suspend / resume
+  if (param_table_len >= FLASH_BFPT_DWORDS) {
+    _parse_suspend(bfpt + 44);
+  }
+  if (param_table_len >= FLASH_BFPT_TIMINGS) {
+    _parse_timings(bfpt + 36);
+    _parse_erase_types(bfpt + 28, bytes_to_u32le(bfpt + 36));
+  } else if (param_table_len >= FLASH_BFPT_ERASE_TYPES) {
+    _parse_erase_types(bfpt + 28, 0);
+  }
+
   return 0;
 }
 
+// Returns the header length
+static uint32_t _read_header(uint8_t* cmd, uint32_t addr)
+{
+  const nor_flash_descriptor_t* desc = &_flash_state.desc;
+  cmd[0] = desc->read_cmd;
+  cmd[1] = (addr >> 16) & 0xFF;
+  cmd[2] = (addr >> 8) & 0xFF;
+  cmd[3] = addr & 0xFF;
+  for (uint32_t i = 0; i < desc->read_dummy; i++) cmd[4 + i] = 0;
+  return 4 + desc->read_dummy;
+}
+
+#if defined(DEBUG) && defined(NOR_FLASH_BENCH)
+// 2 x 256 KB read at boot: opt-in only
+#define READ_BENCH_SIZE (256 * 1024)
+
+// Background read into nothing (data discarded), in KB/s
+static uint32_t _bench_read_rate()
+{
+  uint32_t start = get_ticks();
+  nor_flash_read_start(0, 0, READ_BENCH_SIZE);
+  nor_flash_read_wait();
+  uint32_t us = ticks2us(get_ticks() - start);
+  return (READ_BENCH_SIZE / 1024) * 1000000 / us;
+}
+
+static void _bench_read()
+{
+  nor_flash_descriptor_t* desc = &_flash_state.desc;
+  uint8_t read_cmd = desc->read_cmd;
+  uint8_t read_dummy = desc->read_dummy;
+
+  desc->read_cmd = FLASH_CMD_READ;
+  desc->read_dummy = 0;
+  uint32_t legacy = _bench_read_rate();
+
+  desc->read_cmd = read_cmd;
+  desc->read_dummy = read_dummy;
+  uint32_t current = _bench_read_rate();
+
+  debugln("[NOR flash]: read %d KB/s (Read 0x03: %d KB/s)", current, legacy);
+}
+#endif
+
 int nor_flash_init(spi_t spi, const spi_device_t* dev)
 {
-  spi_init(spi, dev);
-  _flash_state.spi = spi;
+  spi_device_init(&_flash_state.dev, spi, dev);
+  _op_init();
 
   read_id(&_flash_state.desc.id);
   // debugln("[NOR flash]: vendor ID = 0x%X", id.vendor_id);
   // debugln("[NOR flash]: device ID = 0x%X", id.device_id);
 
-  return read_sfdp();
+#if defined(DEBUG)
+  _bench_status_poll();
+#endif
+
+  // plain Read & usual erases until SFDP says otherwise
+  _flash_state.desc.read_cmd = FLASH_CMD_READ;
+  _flash_state.desc.read_dummy = 0;
+
+  const uint8_t erase_types[] = {
+    16, FLASH_CMD_ERASE_64KB, 15, FLASH_CMD_ERASE_32KB, 12, FLASH_CMD_ERASE_4KB, 0, 0,
+  };
+  _parse_erase_types(erase_types, 0);
+  _flash_state.desc.program_us = 0;
+  _flash_state.desc.chip_erase_us = 0;
+  // no suspend until SFDP says it is supported
+  _flash_state.desc.suspend[0] = (nor_flash_suspend_t){ 0 };
+  _flash_state.desc.suspend[1] = (nor_flash_suspend_t){ 0 };
+
+  int err = read_sfdp();
+
+#if defined(DEBUG) && defined(NOR_FLASH_BENCH)
+  if (!err) _bench_read();
+#endif
+
+  timer_set_tick_callback(_flash_tick);
+  return err;
 }
 
 uint32_t nor_flash_size()
@@ -207,76 +746,299 @@ uint32_t nor_flash_size()
 
 uint32_t nor_flash_read(uint32_t addr, uint8_t* data, uint32_t len)
 {
-  wait_for_not_busy();
+  if (len > FLASH_DMA_THRESHOLD) {
+    nor_flash_read_start(addr, data, len);
+    nor_flash_read_wait();
+    return len;
+  }
+
+  _flash_state.op.reading = true;
+  _op_suspend();
+
+  uint8_t cmd[FLASH_READ_HEADER_MAX];
+  uint32_t cmd_len = _read_header(cmd, addr);
 
   flash_select();
-  put_cmd_addr(FLASH_CMD_READ, addr);
+  flash_write(cmd, cmd_len);
   flash_read(data, len);
   flash_unselect();
 
+  _flash_state.op.reading = false;
   return len;
 }
 
+void nor_flash_read_start(uint32_t addr, uint8_t* data, uint32_t len)
+{
+  nor_flash_read_t* read = &_flash_state.read;
+  spi_xfer_wait(&read->xfer);
+
+  // the pending transaction keeps the op suspended
+  _flash_state.op.reading = true;
+  _op_suspend();
+
+  uint32_t cmd_len = _read_header(read->cmd, addr);
+
+  read->segments[0] = (spi_segment_t){ read->cmd, 0, cmd_len };
+  read->segments[1] = (spi_segment_t){ 0, data, len };
+
+  read->xfer.segments = read->segments;
+  read->xfer.n_segments = 2;
+  read->xfer.data_size = 1;
+  read->xfer.flags = SPI_XFER_CS;
+  read->xfer.dev = &_flash_state.dev;
+  read->xfer.done = 0;
+  spi_submit(_flash_state.dev.spi, &read->xfer);
+  _flash_state.op.reading = false;
+}
+
+void nor_flash_read_wait()
+{
+  spi_xfer_wait(&_flash_state.read.xfer);
+}
+
+bool nor_flash_known_erased(uint32_t addr)
+{
+  return _is_known_erased(addr / FLASH_SECTOR_SIZE);
+}
+
+// Compare words first, then the remaining bytes
+static bool _is_fill(const uint32_t* data, uint32_t len)
+{
+  for (uint32_t i = 0; i < len / 4; i++) {
+    if (data[i] != FILL_WORD) return false;
+  }
+  const uint8_t* tail = (const uint8_t*)(data + len / 4);
+  for (uint32_t i = 0; i < (len & 3); i++) {
+    if (tail[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+bool nor_flash_is_erased(uint32_t addr, uint32_t len)
+{
+  uint32_t buffer[FLASH_CHECK_SIZE / 4];
+
+  while (len) {
+    uint32_t sector = addr / FLASH_SECTOR_SIZE;
+    uint32_t n = FLASH_SECTOR_SIZE - (addr & FLASH_SECTOR_MASK);
+    if (n > len) n = len;
+
+    if (!_is_known_erased(sector)) {
+      for (uint32_t offset = 0; offset < n; offset += sizeof(buffer)) {
+        uint32_t chunk = n - offset;
+        if (chunk > sizeof(buffer)) chunk = sizeof(buffer);
+        nor_flash_read(addr + offset, (uint8_t*)buffer, chunk);
+        if (!_is_fill(buffer, chunk)) return false;
+      }
+      // only a full sector tells something about the sector
+      if (n == FLASH_SECTOR_SIZE) _set_erased(sector);
+    }
+
+    addr += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+static void _stage_page(nor_flash_prog_t* prog, uint32_t addr,
+                        const uint8_t* data, uint32_t len)
+{
+  // the stage may still be in use two pages back
+  spi_xfer_wait(&prog->xfer);
+
+  prog->wren_cmd = FLASH_CMD_WRITE_ENABLE;
+  prog->wren_segment = (spi_segment_t){ &prog->wren_cmd, 0, 1 };
+  prog->wren_xfer.segments = &prog->wren_segment;
+  prog->wren_xfer.n_segments = 1;
+
+  prog->cmd[0] = FLASH_CMD_WRITE;
+  prog->cmd[1] = (addr >> 16) & 0xFF;
+  prog->cmd[2] = (addr >> 8) & 0xFF;
+  prog->cmd[3] = addr & 0xFF;
+  prog->segments[0] = (spi_segment_t){ prog->cmd, 0, sizeof(prog->cmd) };
+  prog->segments[1] = (spi_segment_t){ data, 0, len };
+  prog->xfer.segments = prog->segments;
+  prog->xfer.n_segments = 2;
+
+  spi_xfer_t* xfers[2] = { &prog->wren_xfer, &prog->xfer };
+  for (int i = 0; i < 2; i++) {
+    xfers[i]->data_size = 1;
+    xfers[i]->flags = SPI_XFER_CS;
+    xfers[i]->dev = &_flash_state.dev;
+    xfers[i]->done = 0;
+  }
+}
+
+// Started at once if nothing runs, otherwise by the status poll
+// that completes the current op (one page waiting at most)
+static void _prog_queue(nor_flash_prog_t* prog)
+{
+  nor_flash_op_t* op = &_flash_state.op;
+  _op_sync(true);
+
+  uint32_t primask = CPUcpsid();
+  if (op->state == FLASH_OP_IDLE) {
+    _prog_submit(prog);
+  } else {
+    op->next_prog = prog;
+  }
+  if (!primask) CPUcpsie();
+}
+
 uint32_t nor_flash_write(uint32_t address, const uint8_t* data, uint32_t len)
 {
-  wait_for_not_busy();
-  write_enable();
+  // a running erase marks its sectors erased on completion:
+  // it must be over before they are cleared
+  _op_wait();
 
-  flash_select();
-  put_cmd_addr(FLASH_CMD_WRITE, address);
-  flash_write((uint8_t*)data, len);
-  flash_unselect();
-  
-  wait_for_not_busy();
+  if (len) {
+    uint32_t last = (address + len - 1) / FLASH_SECTOR_SIZE;
+    uint32_t primask = CPUcpsid();
+    for (uint32_t s = address / FLASH_SECTOR_SIZE; s <= last; s++) {
+      _clear_erased(s);
+    }
+    if (!primask) CPUcpsie();
+  }
+
+  uint32_t written = 0;
+  uint32_t stage = 0;
+  nor_flash_prog_t* prog = 0;
+
+  while (written < len) {
+    // a page program wraps around within the page
+    uint32_t addr = address + written;
+    uint32_t n = FLASH_PAGE_SIZE - (addr & FLASH_PAGE_MASK);
+    if (n > len - written) n = len - written;
+
+    // staged while the previous page programs
+    prog = &_flash_state.prog[stage];
+    stage = (stage + 1) % FLASH_PROG_STAGES;
+    _stage_page(prog, addr, data + written, n);
+    _prog_queue(prog);
+    written += n;
+  }
+
+  // programming goes on in the background (the next command
+  // or nor_flash_sync waits for it), but 'data' is released
+  if (prog) {
+    _op_sync(true);
+    spi_xfer_wait(&prog->xfer);
+  }
   return len;
 }
 
 void nor_flash_sync()
 {
-  uint8_t status;
-  do {
-    do_cmd(FLASH_CMD_STATUS, 0, &status, 1);
-  } while (status & 0x01);
+  _op_wait();
 }
 
-int nor_flash_erase(uint32_t address)
+bool nor_flash_busy()
 {
-  if((address & FLASH_SECTOR_MASK) != 0)
-    return -1;
+  return _flash_state.op.state != FLASH_OP_IDLE;
+}
 
-  wait_for_not_busy();
+static uint32_t _erase_type_time_us(uint32_t size)
+{
+  const nor_flash_erase_type_t* types = _flash_state.desc.erase_types;
+  for (uint32_t i = 0; i < FLASH_ERASE_TYPES && types[i].log2size; i++) {
+    if ((1u << types[i].log2size) == size) return types[i].typ_us;
+  }
+  return 0;
+}
+
+static void _erase_start(uint8_t cmd, uint32_t address, uint32_t size)
+{
+  _op_wait();
   write_enable();
 
   flash_select();
-  put_cmd_addr(FLASH_CMD_ERASE_4KB, address);
+  put_cmd_addr(cmd, address);
   flash_unselect();
 
-  wait_for_not_busy();
+  const nor_flash_descriptor_t* desc = &_flash_state.desc;
+  _op_start(address / FLASH_SECTOR_SIZE, size / FLASH_SECTOR_SIZE,
+            _erase_type_time_us(size), desc->erase_max_mult);
+}
+
+int nor_flash_erase_start(uint32_t address)
+{
+  if((address & FLASH_SECTOR_MASK) != 0)
+    return -1;
+
+  _erase_start(FLASH_CMD_ERASE_4KB, address, FLASH_SECTOR_SIZE);
   return 0;
 }
 
-int nor_flash_erase_block(uint32_t address)
+int nor_flash_erase_block_start(uint32_t address)
 {
   // verify block alignment
   if((address & FLASH_BLOCK_MASK) != 0)
     return -1;
 
-  wait_for_not_busy();
-  write_enable();
-  
-  flash_select();
-  put_cmd_addr(FLASH_CMD_ERASE_32KB, address);
-  flash_unselect();
+  _erase_start(FLASH_CMD_ERASE_32KB, address, FLASH_BLOCK_SIZE);
+  return 0;
+}
+
+// Largest erase type aligned on 'address' and fitting in 'len'
+static const nor_flash_erase_type_t* _erase_type(uint32_t address, uint32_t len)
+{
+  const nor_flash_erase_type_t* types = _flash_state.desc.erase_types;
+  for (uint32_t i = 0; i < FLASH_ERASE_TYPES && types[i].log2size; i++) {
+    uint32_t size = 1u << types[i].log2size;
+    if (!(address & (size - 1)) && size <= len) return &types[i];
+  }
+  return 0;
+}
 
-  wait_for_not_busy();
+int nor_flash_erase_range(uint32_t address, uint32_t len)
+{
+  if (((address | len) & FLASH_SECTOR_MASK) != 0)
+    return -1;
+
+  while (len) {
+    const nor_flash_erase_type_t* type = _erase_type(address, len);
+    if (!type) return -1;
+    uint32_t size = 1u << type->log2size;
+
+    // blank check after the previous erase (a read would suspend it)
+    _op_wait();
+    if (!nor_flash_is_erased(address, size)) {
+      _erase_start(type->cmd, address, size);
+    }
+
+    address += size;
+    len -= size;
+  }
+
+  _op_wait();
   return 0;
 }
 
+int nor_flash_erase(uint32_t address)
+{
+  int err = nor_flash_erase_start(address);
+  if (!err) _op_wait();
+  return err;
+}
+
+int nor_flash_erase_block(uint32_t address)
+{
+  int err = nor_flash_erase_block_start(address);
+  if (!err) _op_wait();
+  return err;
+}
+
 void nor_flash_erase_all()
 {
-  wait_for_not_busy();
+  _op_wait();
   write_enable();
 
   do_cmd(FLASH_CMD_CHIP_ERASE, 0, 0, 0);
-  wait_for_not_busy();
+
+  uint32_t sectors = nor_flash_size() / FLASH_SECTOR_SIZE;
+  if (sectors > FLASH_MAX_SECTORS) sectors = FLASH_MAX_SECTORS;
+  const nor_flash_descriptor_t* desc = &_flash_state.desc;
+  _op_start(0, sectors, desc->chip_erase_us, desc->erase_max_mult);
+  _op_wait();
 }
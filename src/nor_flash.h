@@ -2,14 +2,45 @@
 
 #include "spi.h"
 
+#define FLASH_SECTOR_SIZE 4096
+#define FLASH_SECTOR_MASK (FLASH_SECTOR_SIZE - 1)
+
+#define FLASH_BLOCK_SIZE 32768
+#define FLASH_BLOCK_MASK (FLASH_BLOCK_SIZE - 1)
+
+#define FLASH_PAGE_SIZE 256
+#define FLASH_PAGE_MASK (FLASH_PAGE_SIZE - 1)
+
 // return != 0 if error, 0 otherwise
 int nor_flash_init(spi_t spi, const spi_device_t* dev);
 
 uint32_t nor_flash_read(uint32_t addr, uint8_t* data, uint32_t len);
+
+// Background read: queued as a single SPI transaction (any length),
+// the CPU is free until nor_flash_read_wait()
+void nor_flash_read_start(uint32_t addr, uint8_t* data, uint32_t len);
+void nor_flash_read_wait();
+
+// Split on page boundaries, each page queued as soon as the previous
+// one is programmed: returns once 'data' has been sent (the last page
+// program still running)
 uint32_t nor_flash_write(uint32_t addr, const uint8_t* data, uint32_t len);
 
+// Blank check with early exit: sectors found erased (or erased
+// since boot) are remembered until written, and not read again
+bool nor_flash_is_erased(uint32_t addr, uint32_t len);
+
+// Sector containing 'addr' is known to be erased (no bus access)
+bool nor_flash_known_erased(uint32_t addr);
+
+// Wait for the last program / erase to complete: sleeps (WFI) until
+// its typical time, then polls the status at a coarse interval
 void nor_flash_sync();
 
+// Program / erase in progress (no bus access): completion is polled
+// from the timer tick, reads suspend it and the tick resumes it
+bool nor_flash_busy();
+
 uint32_t nor_flash_size();
 
 // 4KB erase
@@ -18,4 +49,13 @@ int nor_flash_erase(uint32_t address);
 // 32KB erase
 int nor_flash_erase_block(uint32_t address);
 
+// Non-blocking erases: return once the command is sent
+// (a previous program / erase is waited for first)
+int nor_flash_erase_start(uint32_t address);
+int nor_flash_erase_block_start(uint32_t address);
+
+// Sector aligned range: fewest erases (largest SFDP erase types first),
+// blocks found erased are skipped. Returns once erased.
+int nor_flash_erase_range(uint32_t address, uint32_t len);
+
 void nor_flash_erase_all();
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// 16 channels packed on 11 bits, LSB first (SBUS, CRSF)
+#define RC_CHANNELS       16
+#define RC_PACKED_SIZE    22
+#define RC_CHANNEL_MASK   0x7FF
+
+static inline uint32_t _rc_load16(const uint8_t* p)
+{
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t _rc_load32(const uint8_t* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Channel 'i' is a single (unaligned) load, a shift and a mask:
+// 16-bit loads where the channel fits, so that nothing is read
+// past the 22 packed bytes.
+#define _RC_BYTE(i)  ((11 * (i)) / 8)
+#define _RC_SHIFT(i) ((11 * (i)) % 8)
+#define _RC_LOAD(data, i)                                                      \
+  ((_RC_SHIFT(i) + 11 <= 16) ? _rc_load16((data) + _RC_BYTE(i))                \
+                             : _rc_load32((data) + _RC_BYTE(i)))
+#define RC_CHANNEL(data, i)                                                    \
+  ((uint16_t)((_RC_LOAD(data, i) >> _RC_SHIFT(i)) & RC_CHANNEL_MASK))
+
+static inline void rc_unpack_channels(const uint8_t* data, uint16_t* channels)
+{
+  channels[0] = RC_CHANNEL(data, 0);
+  channels[1] = RC_CHANNEL(data, 1);
+  channels[2] = RC_CHANNEL(data, 2);
+  channels[3] = RC_CHANNEL(data, 3);
+  channels[4] = RC_CHANNEL(data, 4);
+  channels[5] = RC_CHANNEL(data, 5);
+  channels[6] = RC_CHANNEL(data, 6);
+  channels[7] = RC_CHANNEL(data, 7);
+  channels[8] = RC_CHANNEL(data, 8);
+  channels[9] = RC_CHANNEL(data, 9);
+  channels[10] = RC_CHANNEL(data, 10);
+  channels[11] = RC_CHANNEL(data, 11);
+  channels[12] = RC_CHANNEL(data, 12);
+  channels[13] = RC_CHANNEL(data, 13);
+  channels[14] = RC_CHANNEL(data, 14);
+  channels[15] = RC_CHANNEL(data, 15);
+}
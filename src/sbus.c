@@ -0,0 +1,101 @@
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "sbus.h"
+
+#define SBUS_HEADER 0x0F
+#define SBUS_FOOTER 0x00
+
+// SBUS2 footers carry a telemetry slot in the high nibble
+#define SBUS2_FOOTER_MASK 0x0F
+#define SBUS2_FOOTER      0x04
+
+#define SBUS_RING_SIZE 64 // 2 x 32 bytes halves
+
+static uart_t _uart;
+static uint8_t _ring[SBUS_RING_SIZE];
+
+// Decoded frames: IRQ writes the one not being published
+static sbus_frame_t _frames[2];
+static volatile uint8_t _current;
+static volatile bool _new_frame;
+static volatile uint32_t _frame_errors;
+
+bool sbus_decode(const uint8_t* data, sbus_frame_t* frame)
+{
+  uint8_t footer = data[SBUS_FRAME_SIZE - 1];
+  if (data[0] != SBUS_HEADER) return false;
+  if (footer != SBUS_FOOTER &&
+      (footer & SBUS2_FOOTER_MASK) != SBUS2_FOOTER) {
+    return false;
+  }
+
+  rc_unpack_channels(data + 1, frame->channels);
+  frame->flags = data[1 + RC_PACKED_SIZE];
+  return true;
+}
+
+// Receive timeout: the frame ends at the write index
+static void _sbus_frame_received(void* ctx)
+{
+  uint32_t wr = uart_rx_dma_write_index(_uart);
+  uint32_t start = (wr - SBUS_FRAME_SIZE) & (SBUS_RING_SIZE - 1);
+
+  // unwrap (25 bytes: cheaper than unpacking across the ring end)
+  uint8_t data[SBUS_FRAME_SIZE];
+  uint32_t first = SBUS_RING_SIZE - start;
+  if (first > SBUS_FRAME_SIZE) first = SBUS_FRAME_SIZE;
+  memcpy(data, _ring + start, first);
+  memcpy(data + first, _ring, SBUS_FRAME_SIZE - first);
+
+  uint8_t next = _current ^ 1;
+  if (!sbus_decode(data, &_frames[next])) {
+    _frame_errors++;
+    return;
+  }
+
+  _current = next;
+  _new_frame = true;
+}
+
+void sbus_init(uart_t uart, uint32_t rx)
+{
+  const uart_device_t dev = {
+    .mode = UART_8E2,
+    .flags = UART_INVERT_RX,
+    .baud_rate = SBUS_BAUDRATE,
+    .rx = rx,
+    .tx = IOID_UNUSED,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+
+  _uart = uart;
+  _current = 0;
+  _new_frame = false;
+  _frame_errors = 0;
+
+  uart_init(uart, &dev);
+
+  uart_callbacks_t cb = {
+    .frame_received = _sbus_frame_received,
+    .error = 0,
+    .ctx = 0,
+  };
+  uart_enable_irqs(uart, &cb);
+  uart_enable_rx_dma(uart, _ring, SBUS_RING_SIZE);
+}
+
+bool sbus_get_frame(sbus_frame_t* frame)
+{
+  if (!_new_frame) return false;
+
+  _new_frame = false;
+  memcpy(frame, &_frames[_current], sizeof(sbus_frame_t));
+  return true;
+}
+
+uint32_t sbus_frame_errors()
+{
+  return _frame_errors;
+}
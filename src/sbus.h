@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rc_channels.h"
+#include "uart.h"
+
+#define SBUS_BAUDRATE   100000
+#define SBUS_FRAME_SIZE 25
+
+// Flags byte
+#define SBUS_FLAG_CH17       (1 << 0)
+#define SBUS_FLAG_CH18       (1 << 1)
+#define SBUS_FLAG_FRAME_LOST (1 << 2)
+#define SBUS_FLAG_FAILSAFE   (1 << 3)
+
+typedef struct {
+  uint16_t channels[RC_CHANNELS];
+  uint8_t flags;
+} sbus_frame_t;
+
+// Decode a raw 25 bytes frame (false if header / footer are invalid)
+bool sbus_decode(const uint8_t* data, sbus_frame_t* frame);
+
+// SBUS input (100000 baud 8E2) received by DMA
+//  - the line is inverted by the IOC: use a direct pin
+void sbus_init(uart_t uart, uint32_t rx);
+
+// Copy the latest frame: returns false if none was received since last call
+bool sbus_get_frame(sbus_frame_t* frame);
+
+// Frames with a bad header / footer
+uint32_t sbus_frame_errors();
@@ -1,69 +1,139 @@
-#include "board.h"
 #include "serial.h"
+#include "timer.h"
 #include "uart.h"
 
 #include <string.h>
 
-// Frame received flag
-volatile bool frame_received = false;
-volatile uint32_t rx_len = 0;
+#define RX_FRAME_MASK (RX_FRAME_SLOTS - 1)
 
-// IRQ RX buffer
-uint8_t rx_buf[RX_BUFFER_SIZE];
+static void _serial_rx_timeout(void* ctx)
+{
+  serial_t* serial = (serial_t*)ctx;
+  uart_t uart = serial->uart;
+
+  uint32_t len = uart_get_rx_len(uart);
+  if (len == 0) return;
+
+  uint32_t head = serial->rx_head;
+  serial_frame_t* frame = &serial->rx_frames[head];
+  frame->len = len;
+  frame->timestamp = get_ticks();
+
+  uint32_t next = (head + 1) & RX_FRAME_MASK;
+  if (next == serial->rx_tail) {
+    // no free slot: drop the frame
+    serial->rx_overflows++;
+    uart_reset_rx_len(uart);
+    return;
+  }
 
-// IRQ TX buffer
-static uint8_t tx_buf[TX_BUFFER_SIZE];
+#if defined(DEBUG)
+  uint32_t used = (next - serial->rx_tail) & RX_FRAME_MASK;
+  if (used > serial->rx_max_used) serial->rx_max_used = used;
+#endif
 
-static void _serial_rx_timeout()
+  // hand off the slot and receive into the next one
+  serial->rx_head = next;
+  uart_set_rx_buffer(uart, serial->rx_frames[next].data, RX_BUFFER_SIZE);
+}
+
+static void _serial_rx_error(void* ctx, uart_error_t error)
 {
-  rx_len = uart_get_rx_len(UART0);
-  frame_received = true;
+  serial_t* serial = (serial_t*)ctx;
+  serial->rx_errors++;
 }
 
-void serial_init()
+void serial_init(serial_t* serial, uart_t uart, const uart_device_t* dev)
 {
-  uart_device_t uart0 = {
-    .mode = UART_8N1,
-    .baud_rate = SERIAL_BAUDRATE,
-    .rx = SERIAL_RX_IOD,
-    .tx = SERIAL_TX_IOD,
-    .cts = IOID_UNUSED,
-    .rts = IOID_UNUSED,
-  };
-  uart_init(UART0, &uart0);
+  serial->uart = uart;
+  serial->rx_head = serial->rx_tail = serial->rx_overflows = 0;
+  serial->rx_errors = 0;
+#if defined(DEBUG)
+  serial->rx_max_used = serial->rx_max_wait = 0;
+#endif
+
+  uart_init(uart, dev);
 
   // UART IRQ callbacks
-  uart_callbacks_t uart0_cb = {
+  uart_callbacks_t cb = {
     .frame_received = _serial_rx_timeout,
-    .error = 0, // TODO
+    .error = _serial_rx_error,
+    .ctx = serial,
   };
-  uart_enable_irqs(UART0, &uart0_cb);
-  uart_enable_rx_irq(UART0, rx_buf, RX_BUFFER_SIZE);
-  uart_enable_tx_irq(UART0, tx_buf, TX_BUFFER_SIZE);
+  uart_enable_irqs(uart, &cb);
+  uart_enable_rx_irq(uart, serial->rx_frames[0].data, RX_BUFFER_SIZE);
+  uart_enable_tx_irq(uart, serial->tx_buf, TX_BUFFER_SIZE);
 }
 
-void serial_print(const char* str)
+const serial_frame_t* serial_get_frame(serial_t* serial)
 {
-  uart_print_irq(UART0, str);
+  uint32_t tail = serial->rx_tail;
+  if (tail == serial->rx_head) return 0;
+
+  const serial_frame_t* frame = &serial->rx_frames[tail];
+#if defined(DEBUG)
+  uint32_t wait = get_ticks() - frame->timestamp;
+  if (wait > serial->rx_max_wait) serial->rx_max_wait = wait;
+#endif
+  return frame;
 }
 
-void serial_write(const uint8_t* data, uint32_t len)
+void serial_set_rx_split(serial_t* serial, bool split)
 {
-  uart_tx_irq(UART0, data, len);
+  uart_set_rx_split(serial->uart, split);
 }
 
-static inline void serial_wait_dma() { uart_tx_dma_wait(UART0); }
+void serial_release_frame(serial_t* serial)
+{
+  uint32_t tail = serial->rx_tail;
+  if (tail == serial->rx_head) return;
+  serial->rx_tail = (tail + 1) & RX_FRAME_MASK;
+}
 
-void serial_write_dma(const void* data, uint32_t len, bool blocking)
+uint32_t serial_rx_overflows(serial_t* serial)
 {
-  serial_wait_dma();
-  uart_tx_dma(UART0, data, len);
-  if (blocking) serial_wait_dma();
+  return serial->rx_overflows;
 }
 
-void serial_print_dma(const char* str)
+uint32_t serial_rx_errors(serial_t* serial)
 {
-  uint32_t len = strlen(str);
-  serial_write_dma(str, len, true);
+  return serial->rx_errors;
+}
+
+uint32_t serial_print(serial_t* serial, const char* str)
+{
+  return uart_print_irq(serial->uart, str);
 }
 
+uint32_t serial_write(serial_t* serial, const uint8_t* data, uint32_t len)
+{
+  return uart_tx_irq(serial->uart, data, len);
+}
+
+static inline void serial_wait_dma(serial_t* serial)
+{
+  uart_tx_dma_wait(serial->uart);
+}
+
+void serial_write_dma(serial_t* serial, const void* data, uint32_t len,
+                      bool blocking)
+{
+  serial_wait_dma(serial);
+  uart_tx_dma(serial->uart, data, len);
+  if (blocking) serial_wait_dma(serial);
+}
+
+bool serial_writev_dma(serial_t* serial, const uart_iovec_t* iov, uint32_t n,
+                       bool blocking)
+{
+  serial_wait_dma(serial);
+  if (!uart_tx_dma_sg(serial->uart, iov, n)) return false;
+  if (blocking) serial_wait_dma(serial);
+  return true;
+}
+
+void serial_print_dma(serial_t* serial, const char* str)
+{
+  uint32_t len = strlen(str);
+  serial_write_dma(serial, str, len, true);
+}
@@ -3,21 +3,64 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "uart.h"
+
 #define SERIAL_BAUDRATE 921600
 
 #define RX_BUFFER_SIZE 128
+#define RX_FRAME_SLOTS 16  // must be a power of 2
 #define TX_BUFFER_SIZE 128 // must be a power of 2
 
-extern uint8_t rx_buf[RX_BUFFER_SIZE];
+typedef struct {
+  uint8_t data[RX_BUFFER_SIZE];
+  uint32_t len;
+  uint32_t timestamp; // GPT1 ticks at receive timeout
+} serial_frame_t;
+
+// Serial port handle (one per UART)
+//  - rx_head: slot being received
+//  - rx_tail: oldest frame not yet released
+typedef struct {
+  uart_t uart;
+  serial_frame_t rx_frames[RX_FRAME_SLOTS];
+  volatile uint32_t rx_head;
+  volatile uint32_t rx_tail;
+  volatile uint32_t rx_overflows;
+  volatile uint32_t rx_errors;
+  uint8_t tx_buf[TX_BUFFER_SIZE];
+#if defined(DEBUG)
+  uint32_t rx_max_used;  // slots holding frames (high-water mark)
+  uint32_t rx_max_wait;  // ticks from receive timeout to serial_get_frame()
+#endif
+} serial_t;
+
+void serial_init(serial_t* serial, uart_t uart, const uart_device_t* dev);
+
+// Oldest received frame (NULL if none)
+const serial_frame_t* serial_get_frame(serial_t* serial);
+
+// Bursts longer than RX_BUFFER_SIZE span several frames when enabled,
+// otherwise the rest is dropped (and counted as errors)
+void serial_set_rx_split(serial_t* serial, bool split);
+
+// Give the oldest frame back to the receiver
+void serial_release_frame(serial_t* serial);
+
+// Number of frames dropped because all slots were in use
+uint32_t serial_rx_overflows(serial_t* serial);
 
-// Frame received flag
-extern volatile bool frame_received;
-extern volatile uint32_t rx_len;
+// Number of UART receive errors (framing, parity, break, overrun, DMA)
+// and bytes dropped because the RX buffer was full
+uint32_t serial_rx_errors(serial_t* serial);
 
-void serial_init();
+// IRQ writes: return the number of bytes accepted
+uint32_t serial_print(serial_t* serial, const char* str);
+uint32_t serial_write(serial_t* serial, const uint8_t* data, uint32_t len);
 
-void serial_print(const char* str);
-void serial_write(const uint8_t* data, uint32_t len);
+void serial_write_dma(serial_t* serial, const void* data, uint32_t len,
+                      bool blocking);
+void serial_print_dma(serial_t* serial, const char* str);
 
-void serial_write_dma(const void* data, uint32_t len, bool blocking);
-void serial_print_dma(const char* str);
+// Scatter-gather DMA write (segments must stay valid until done)
+bool serial_writev_dma(serial_t* serial, const uart_iovec_t* iov, uint32_t n,
+                       bool blocking);
@@ -1,3 +1,4 @@
+#include <driverlib/cpu.h>
 #include <driverlib/ioc.h>
 #include <driverlib/gpio.h>
 #include <driverlib/prcm.h>
@@ -45,8 +46,44 @@ static const uint32_t _spi_frame_format[] = {
 
 #define MAX_FRAME_FORMATS (sizeof(_spi_frame_format) / sizeof(uint32_t))
 
-static uint32_t _spi_cs[MAX_SPI];
-static volatile bool _spi_dma_active[MAX_SPI];
+#define SPI_DMA_CHUNK 1024 // UDMA_XFER_SIZE_MAX
+
+// One direction of the current segment
+typedef struct {
+  uint8_t* pos;    // next chunk (NULL: dummy frames)
+  uint32_t to_arm; // items not armed yet
+  uint32_t armed;  // chunks armed (chunk n uses structure n % 2)
+  uint32_t done;   // chunks completed
+} spi_dma_stream_t;
+
+// Bus state
+//  - active: register image currently loaded
+//  - owner: device holding the bus for polled transfers
+//  - current: transaction in progress
+//  - head/tail: transactions waiting for the bus (FIFO)
+typedef struct {
+  bool initialized;
+  const spi_bus_device_t* active;
+  const spi_bus_device_t* volatile owner;
+
+  spi_xfer_t* volatile current;
+  spi_xfer_t* volatile head;
+  spi_xfer_t* tail;
+  uint32_t segment;
+
+  spi_dma_stream_t rx;
+  spi_dma_stream_t tx;
+  uint32_t data_size;
+
+  // used by the blocking / single transfer DMA methods
+  spi_xfer_t dma_xfer;
+  spi_segment_t dma_segment;
+
+  // device configured by spi_init()
+  spi_bus_device_t dev;
+} spi_state_t;
+
+static spi_state_t _spi_state[MAX_SPI];
 
 static void _init_pwr_domain(spi_t spi) {
   uint32_t pwr_domain = _spi_pwr_domain[spi];
@@ -55,6 +92,7 @@ static void _init_pwr_domain(spi_t spi) {
 }
 
 static void _spi_irq(spi_t spi);
+static void _spi_claim_dma(spi_t spi);
 static void _spi0_irq() { _spi_irq(SPI0); }
 static void _spi1_irq() { _spi_irq(SPI1); }
 
@@ -63,92 +101,214 @@ static void (*const _spi_irq_handler[MAX_SPI])() = {
     _spi1_irq,
 };
 
-void spi_init(spi_t spi, const spi_device_t* dev)
+void spi_device_init(spi_bus_device_t* bdev, spi_t spi,
+                     const spi_device_t* dev)
 {
   ASSERT(spi < MAX_SPI);
   ASSERT(dev && (dev->frame_format < MAX_FRAME_FORMATS));
 
-  _init_pwr_domain(spi);
-  dma_init();
-
+  spi_state_t* st = &_spi_state[spi];
   uint32_t base = _spi_lut[spi].base;
+
+  if (!st->initialized) {
+    _init_pwr_domain(spi);
+    dma_init();
+    _spi_claim_dma(spi);
+    SSIDisable(base);
+    SSIIntRegister(base, _spi_irq_handler[spi]);
+    st->initialized = true;
+  }
+
+  // data pins are shared: unused ones are left as they are
   IOCPinTypeSsiMaster(base, dev->rx, dev->tx, IOID_UNUSED, dev->clk);
 
   uint32_t cs = dev->cs;
-  _spi_cs[spi] = cs;
-
   if (cs != IOID_UNUSED) {
     GPIO_setDio(cs);
     IOCPinTypeGpioOutput(cs);
   }
 
-  SSIDisable(base);
+  // same computation as SSIConfigSetExpClk()
+  uint32_t max_div = SysCtrlClockGet() / dev->bit_rate;
+  uint32_t prediv = 0;
+  uint32_t scr;
+  do {
+    prediv += 2;
+    scr = (max_div / prediv) - 1;
+  } while (scr > 255);
 
-  uint32_t sys_clk = SysCtrlClockGet();
   uint32_t frame_format = _spi_frame_format[dev->frame_format];
-  SSIConfigSetExpClk(base, sys_clk, frame_format, SSI_MODE_MASTER,
-                     dev->bit_rate, dev->data_width);
+  bdev->spi = spi;
+  bdev->cs = cs;
+  bdev->cpsr = prediv;
+  bdev->cr0 = (scr << 8) | ((frame_format & 3) << 6) | (dev->data_width - 1);
+}
+
+// Devices without a CS pin (IOID_UNUSED) are never selected
+static inline void _cs_assert(const spi_bus_device_t* bdev)
+{
+  if (bdev->cs != IOID_UNUSED) GPIO_clearDio(bdev->cs);
+}
+
+static inline void _cs_release(const spi_bus_device_t* bdev)
+{
+  if (bdev->cs != IOID_UNUSED) GPIO_setDio(bdev->cs);
+}
+
+// Bus must be idle: the SSI is disabled while CR0/CPSR change
+static void _spi_activate(spi_t spi, const spi_bus_device_t* bdev)
+{
+  spi_state_t* st = &_spi_state[spi];
+  if (st->active == bdev) return;
+
+  uint32_t base = _spi_lut[spi].base;
+  HWREG(base + SSI_O_CR1) = 0;
+  HWREG(base + SSI_O_CR0) = bdev->cr0;
+  HWREG(base + SSI_O_CPSR) = bdev->cpsr;
+  HWREG(base + SSI_O_CR1) = SSI_CR1_SSE; // master
+  st->active = bdev;
+}
+
+void spi_init(spi_t spi, const spi_device_t* dev)
+{
+  spi_state_t* st = &_spi_state[spi];
+  spi_bus_device_t* bdev = &st->dev;
+  spi_device_init(bdev, spi, dev);
+
+  // may be called again with new settings: same image, new content
+  if (st->active == bdev) st->active = 0;
+  _spi_activate(spi, bdev);
+}
+
+void spi_device_select(const spi_bus_device_t* bdev)
+{
+  spi_t spi = bdev->spi;
+  spi_state_t* st = &_spi_state[spi];
+
+  // queued transactions go first
+  for (;;) {
+    uint32_t primask = CPUcpsid();
+    bool idle = !st->current && !st->head;
+    if (idle) {
+      st->owner = bdev;
+      _spi_activate(spi, bdev);
+    }
+    if (!primask) CPUcpsie();
+    if (idle) break;
+  }
+
+  _cs_assert(bdev);
+}
+
+static void _start_next(spi_t spi);
+
+void spi_device_unselect(const spi_bus_device_t* bdev)
+{
+  spi_t spi = bdev->spi;
+  spi_state_t* st = &_spi_state[spi];
+
+  _cs_release(bdev);
 
-  SSIIntRegister(base, _spi_irq_handler[spi]);
-  SSIEnable(base);
+  uint32_t primask = CPUcpsid();
+  st->owner = 0;
+  if (!st->current) _start_next(spi);
+  if (!primask) CPUcpsie();
 }
 
 void spi_select(spi_t spi)
 {
   ASSERT(spi < MAX_SPI);
-  GPIO_clearDio(_spi_cs[spi]);
+  spi_device_select(&_spi_state[spi].dev);
 }
 
 void spi_unselect(spi_t spi)
 {
   ASSERT(spi < MAX_SPI);
-  GPIO_setDio(_spi_cs[spi]);
+  spi_device_unselect(&_spi_state[spi].dev);
 }
 
-#define SPI_TRANSFER_LOOP(base, tx, tx_inc, rx, rx_inc, len)                   \
-  {                                                                            \
-    while (HWREG(base + SSI_O_SR) & SSI_SR_BSY) {                              \
-    }                                                                          \
-    uint32_t tx_count = len;                                                   \
+#define SSI_FIFO_DEPTH 8
+
+// Burst transfer: fill the FIFO (up to SSI_FIFO_DEPTH frames in flight,
+// so that RX cannot overflow), then write one frame for each frame read.
+// TX never runs dry while frames are left: no gap on the bus.
+//  - TX: expression giving the next frame
+//  - RX: statement consuming the received frame 'd'
+#define SPI_BURST_LOOP(base, len, TX, RX)                                      \
+  do {                                                                         \
+    uint32_t left = len < SSI_FIFO_DEPTH ? 0 : len - SSI_FIFO_DEPTH;           \
+    for (uint32_t i = len - left; i; i--) HWREG(base + SSI_O_DR) = (TX);       \
     while (len--) {                                                            \
-      bool put = true;                                                         \
-      while (tx_count && put) {                                                \
-        put = HWREG(base + SSI_O_SR) & SSI_TX_NOT_FULL;                        \
-        if (put) {                                                             \
-          HWREG(base + SSI_O_DR) = *tx;                                        \
-          tx += tx_inc;                                                        \
-          tx_count--;                                                          \
-        }                                                                      \
-      }                                                                        \
       while (!(HWREG(base + SSI_O_SR) & SSI_RX_NOT_EMPTY)) {                   \
       }                                                                        \
-      *rx = HWREG(base + SSI_O_DR);                                            \
-      rx += rx_inc;                                                            \
-    }                                                                          \
-    while (HWREG(base + SSI_O_SR) & SSI_SR_BSY) {                              \
+      uint32_t d = HWREG(base + SSI_O_DR);                                     \
+      if (left) {                                                              \
+        left--;                                                                \
+        HWREG(base + SSI_O_DR) = (TX);                                         \
+      }                                                                        \
+      RX;                                                                      \
     }                                                                          \
+  } while (0)
+
+// tx-only, rx-only and full-duplex variants for each frame size
+#define SPI_BURST_FUNCS(bits)                                                  \
+  static void _burst_tx_##bits(uint32_t base, const uint##bits##_t* tx,        \
+                               uint32_t len)                                   \
+  {                                                                            \
+    SPI_BURST_LOOP(base, len, *tx++, (void)d);                                 \
+  }                                                                            \
+  static void _burst_rx_##bits(uint32_t base, uint##bits##_t* rx,              \
+                               uint32_t len)                                   \
+  {                                                                            \
+    SPI_BURST_LOOP(base, len, 0, *rx++ = d);                                   \
+  }                                                                            \
+  static void _burst_txrx_##bits(uint32_t base, const uint##bits##_t* tx,      \
+                                 uint##bits##_t* rx, uint32_t len)             \
+  {                                                                            \
+    SPI_BURST_LOOP(base, len, *tx++, *rx++ = d);                               \
   }
 
+SPI_BURST_FUNCS(8)
+SPI_BURST_FUNCS(16)
+
+// Dummy frames only (frame size is set in CR0)
+static void _burst_null(uint32_t base, uint32_t len)
+{
+  SPI_BURST_LOOP(base, len, 0, (void)d);
+}
+
+// Dummy frames: RX sink, and a TX source nothing writes to
 static uint16_t _scratch;
+static const uint16_t _dummy_tx = 0;
 
+// The bus is idle after each call (as after DMA completion),
+// so there is no need to wait for BSY before starting
 void spi_transfer_8(spi_t spi, const uint8_t *tx, uint8_t *rx, uint32_t len)
 {
   ASSERT(spi < MAX_SPI);
   uint32_t base = _spi_lut[spi].base;
-  uint32_t tx_inc = 1, rx_inc = 1;
-  if (!tx) { tx = (uint8_t*)&_scratch; tx_inc = 0; }
-  if (!rx) { rx = (uint8_t*)&_scratch; rx_inc = 0; }
-  SPI_TRANSFER_LOOP(base, tx, tx_inc, rx, rx_inc, len);
+  if (!rx) {
+    if (tx) _burst_tx_8(base, tx, len);
+    else _burst_null(base, len);
+  } else if (!tx) {
+    _burst_rx_8(base, rx, len);
+  } else {
+    _burst_txrx_8(base, tx, rx, len);
+  }
 }
 
 void spi_transfer_16(spi_t spi, const uint16_t *tx, uint16_t *rx, uint32_t len)
 {
   ASSERT(spi < MAX_SPI);
   uint32_t base = _spi_lut[spi].base;
-  uint32_t tx_inc = 1, rx_inc = 1;
-  if (!tx) { tx = &_scratch; tx_inc = 0; }
-  if (!rx) { rx = &_scratch; rx_inc = 0; }
-  SPI_TRANSFER_LOOP(base, tx, tx_inc, rx, rx_inc, len);
+  if (!rx) {
+    if (tx) _burst_tx_16(base, tx, len);
+    else _burst_null(base, len);
+  } else if (!tx) {
+    _burst_rx_16(base, rx, len);
+  } else {
+    _burst_txrx_16(base, tx, rx, len);
+  }
 }
 
 void spi_read_8(spi_t spi, uint8_t* data, uint32_t len)
@@ -171,97 +331,236 @@ void spi_write_16(spi_t spi, const uint16_t* data, uint32_t len)
   spi_transfer_16(spi, data, 0, len);
 }
 
+#if defined(DEBUG)
+// Previous polled path: status register checked for every frame
+void spi_transfer_8_per_frame(spi_t spi, const uint8_t* tx, uint8_t* rx,
+                              uint32_t len)
+{
+  ASSERT(spi < MAX_SPI);
+  uint32_t base = _spi_lut[spi].base;
+  uint8_t dummy = 0;
+  uint32_t tx_inc = 1, rx_inc = 1;
+  if (!tx) { tx = &dummy; tx_inc = 0; }
+  if (!rx) { rx = &dummy; rx_inc = 0; }
+
+  while (HWREG(base + SSI_O_SR) & SSI_SR_BSY) {
+  }
+  uint32_t tx_count = len;
+  while (len--) {
+    bool put = true;
+    while (tx_count && put) {
+      put = HWREG(base + SSI_O_SR) & SSI_TX_NOT_FULL;
+      if (put) {
+        HWREG(base + SSI_O_DR) = *tx;
+        tx += tx_inc;
+        tx_count--;
+      }
+    }
+    while (!(HWREG(base + SSI_O_SR) & SSI_RX_NOT_EMPTY)) {
+    }
+    *rx = HWREG(base + SSI_O_DR);
+    rx += rx_inc;
+  }
+  while (HWREG(base + SSI_O_SR) & SSI_SR_BSY) {
+  }
+}
+#endif
+
 //
 // DMA methods
 // 
 
-#define BASIC_8 (UDMA_MODE_BASIC | UDMA_SIZE_8)
-#define BASIC_16 (UDMA_MODE_BASIC | UDMA_SIZE_16)
-
 static const uint32_t _dma_null_options[2] = {
-  BASIC_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4,
-  BASIC_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4,
+  UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4,
+  UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_NONE | UDMA_ARB_4,
 };
 
 static const uint32_t _dma_rx_options[2] = {
-  BASIC_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4,
-  BASIC_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_4,
+  UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4,
+  UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 | UDMA_ARB_4,
 };
 
 static const uint32_t _dma_tx_options[2] = {
-  BASIC_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4,
-  BASIC_16 | UDMA_SRC_INC_16 | UDMA_DST_INC_NONE | UDMA_ARB_4,
+  UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4,
+  UDMA_SIZE_16 | UDMA_SRC_INC_16 | UDMA_DST_INC_NONE | UDMA_ARB_4,
 };
 
-#undef BASIC_8
-#undef BASIC_16
-
-static inline tDMAControlTable* dma_channel_entry(uint32_t channel)
+static inline void clear_dma_done(uint32_t channel_mask)
 {
-  tDMAControlTable *dma_tbl = (tDMAControlTable *)HWREG(UDMA0_BASE + UDMA_O_CTRL);
-  return &dma_tbl[channel];
+  HWREG(UDMA0_BASE + UDMA_O_REQDONE) = channel_mask;
 }
 
-static inline void enable_dma_channel(uint32_t channel_mask)
-{  
-  HWREG(UDMA0_BASE + UDMA_O_SETCHANNELEN) = channel_mask;
+// Arm the next chunk into its control structure:
+// the last one in basic mode, so that the channel stops cleanly
+static void _dma_arm(spi_t spi, bool tx)
+{
+  spi_state_t* st = &_spi_state[spi];
+  const spi_lut_t* lut = &_spi_lut[spi];
+  spi_dma_stream_t* stream = tx ? &st->tx : &st->rx;
+  uint32_t channel = tx ? lut->tx_dma.channel : lut->rx_dma.channel;
+  uint32_t size = st->data_size;
+
+  uint32_t len = stream->to_arm;
+  if (len > SPI_DMA_CHUNK) len = SPI_DMA_CHUNK;
+
+  void* fifo = (void *)(lut->base + SSI_O_DR);
+  void* end;
+  uint32_t ctrl;
+
+  if (stream->pos) {
+    ctrl = tx ? _dma_tx_options[size - 1] : _dma_rx_options[size - 1];
+    end = stream->pos + (len - 1) * size;
+    stream->pos += len * size;
+  } else {
+    ctrl = _dma_null_options[size - 1];
+    end = tx ? (void*)&_dummy_tx : &_scratch;
+  }
+
+  stream->to_arm -= len;
+  ctrl |= stream->to_arm ? UDMA_MODE_PINGPONG : UDMA_MODE_BASIC;
+
+  uint32_t alt = stream->armed++ & 1;
+  dma_arm(channel | (alt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT),
+          tx ? end : fifo, tx ? fifo : end,
+          ctrl | ((len - 1) << UDMA_XFER_SIZE_S));
 }
 
-static inline void disable_dma_channel(uint32_t channel_mask)
-{  
-  HWREG(UDMA0_BASE + UDMA_O_CLEARCHANNELEN) = channel_mask;
+// Both structures busy at most. TX never gets ahead of RX:
+// what it sends always has somewhere to go.
+static void _dma_fill(spi_t spi, bool tx)
+{
+  spi_state_t* st = &_spi_state[spi];
+  spi_dma_stream_t* stream = tx ? &st->tx : &st->rx;
+
+  while (stream->to_arm && stream->armed - stream->done < 2 &&
+         (!tx || stream->armed < st->rx.armed)) {
+    _dma_arm(spi, tx);
+  }
 }
 
-static inline bool is_dma_done(uint32_t channel_mask)
+// Completions are read from the structures (back in stop mode),
+// not counted from IRQs: several may be served by one IRQ
+static void _dma_count(spi_t spi, bool tx)
 {
-  return HWREG(UDMA0_BASE + UDMA_O_REQDONE) & channel_mask;
+  spi_state_t* st = &_spi_state[spi];
+  const spi_lut_t* lut = &_spi_lut[spi];
+  spi_dma_stream_t* stream = tx ? &st->tx : &st->rx;
+  uint32_t channel = tx ? lut->tx_dma.channel : lut->rx_dma.channel;
+
+  while (stream->done < stream->armed) {
+    uint32_t alt = stream->done & 1;
+    if (!dma_stopped(channel | (alt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT))) break;
+    stream->done++;
+  }
 }
 
-static inline void clear_dma_done(uint32_t channel_mask)
+// Re-arm freed structures and restart the channel if it stopped
+// on one that was not armed in time. Returns true once, when the
+// whole stream is done.
+static bool _dma_update(spi_t spi, bool tx)
 {
-  HWREG(UDMA0_BASE + UDMA_O_REQDONE) = channel_mask;
+  spi_state_t* st = &_spi_state[spi];
+  const spi_lut_t* lut = &_spi_lut[spi];
+  spi_dma_stream_t* stream = tx ? &st->tx : &st->rx;
+  uint32_t mask = tx ? lut->tx_dma.mask : lut->rx_dma.mask;
+
+  if (stream->done == stream->armed && !stream->to_arm) return false;
+
+  _dma_count(spi, tx);
+  while (true) {
+    _dma_fill(spi, tx);
+    if (stream->done == stream->armed) break;
+    if (HWREG(UDMA0_BASE + UDMA_O_SETCHANNELEN) & mask) break;
+
+    // stopped: the count is stable now
+    uint32_t done = stream->done;
+    _dma_count(spi, tx);
+    if (stream->done != done) continue;
+
+    HWREG(UDMA0_BASE + ((done & 1) ? UDMA_O_SETCHNLPRIALT
+                                   : UDMA_O_CLEARCHNLPRIALT)) = mask;
+    dma_enable(mask);
+    break;
+  }
+
+  return stream->done == stream->armed && !stream->to_arm;
 }
 
-static inline void _start_rx_dma_xfer(uint32_t base, uint32_t dma_channel,
-                                      void *buffer, uint32_t len,
-                                      uint32_t data_size)
+// Up to SPI_DMA_CHUNK items: single basic transfer,
+// above: ping-pong between both structures
+static void _start_segment(spi_t spi, const spi_segment_t* seg,
+                           uint32_t data_size)
 {
-  uint32_t ctrl;
+  spi_state_t* st = &_spi_state[spi];
+  const spi_lut_t* lut = &_spi_lut[spi];
+  uint32_t masks = lut->rx_dma.mask | lut->tx_dma.mask;
 
-  tDMAControlTable *dma_entry = dma_channel_entry(dma_channel);
-  dma_entry->pvSrcEndAddr = (void *)(base + SSI_O_DR);
+  st->rx = (spi_dma_stream_t){ (uint8_t*)seg->rx, seg->len, 0, 0 };
+  st->tx = (spi_dma_stream_t){ (uint8_t*)seg->tx, seg->len, 0, 0 };
+  st->data_size = data_size;
 
-  if (buffer) {
-    ctrl = _dma_rx_options[data_size - 1];
-    dma_entry->pvDstEndAddr = buffer + (len - 1) * data_size;
-  } else {
-    ctrl = _dma_null_options[data_size - 1];
-    dma_entry->pvDstEndAddr = &_scratch;
-  }
+  _dma_fill(spi, false);
+  _dma_fill(spi, true);
 
-  ctrl |= (len - 1) << UDMA_XFER_SIZE_S;
-  dma_entry->ui32Control = ctrl;
+  HWREG(UDMA0_BASE + UDMA_O_CLEARCHNLPRIALT) = masks;
+  clear_dma_done(masks);
+  dma_enable(masks);
+  SSIDMAEnable(lut->base, SSI_DMA_TX | SSI_DMA_RX);
 }
 
-static inline void _start_tx_dma_xfer(uint32_t base, uint32_t dma_channel,
-                                      const void *buffer, uint32_t len,
-                                      uint32_t data_size)
+// NULL device: the bus owner, or the one set by spi_init()
+static const spi_bus_device_t* _xfer_device(spi_t spi, const spi_xfer_t* xfer)
 {
-  uint32_t ctrl;
+  spi_state_t* st = &_spi_state[spi];
+  if (xfer->dev) return xfer->dev;
+  return st->owner ? st->owner : &st->dev;
+}
 
-  tDMAControlTable *dma_entry = dma_channel_entry(dma_channel);
-  dma_entry->pvDstEndAddr = (void *)(base + SSI_O_DR);
+static void _start_xfer(spi_t spi, spi_xfer_t* xfer)
+{
+  spi_state_t* st = &_spi_state[spi];
+  const spi_bus_device_t* bdev = _xfer_device(spi, xfer);
+
+  st->current = xfer;
+  st->segment = 0;
+  _spi_activate(spi, bdev);
+  if (xfer->flags & SPI_XFER_CS) _cs_assert(bdev);
+  _start_segment(spi, &xfer->segments[0], xfer->data_size);
+}
 
-  if (buffer) {
-    ctrl = _dma_tx_options[data_size - 1];
-    dma_entry->pvSrcEndAddr = (void*)buffer + (len - 1) * data_size;
-  } else {
-    ctrl = _dma_null_options[data_size - 1];
-    dma_entry->pvSrcEndAddr = &_scratch;
+// Bus arbitration: first come, first served,
+// nothing starts while a device owns the bus
+static void _start_next(spi_t spi)
+{
+  spi_state_t* st = &_spi_state[spi];
+  spi_xfer_t* xfer = st->head;
+  if (!xfer || st->owner) return;
+
+  st->head = xfer->next;
+  if (!st->head) st->tail = 0;
+  _start_xfer(spi, xfer);
+}
+
+// RX is always the last to complete: the bus is idle
+static void _segment_done(spi_t spi)
+{
+  spi_state_t* st = &_spi_state[spi];
+  spi_xfer_t* xfer = st->current;
+
+  if (++st->segment < xfer->n_segments) {
+    _start_segment(spi, &xfer->segments[st->segment], xfer->data_size);
+    return;
   }
 
-  ctrl |= (len - 1) << UDMA_XFER_SIZE_S;
-  dma_entry->ui32Control = ctrl;
+  if (xfer->flags & SPI_XFER_CS) _cs_release(st->active);
+
+  // start the next one before the callback: no gap on the bus,
+  // and the callback may submit again
+  st->current = 0;
+  _start_next(spi);
+
+  xfer->busy = false;
+  if (xfer->done) xfer->done(xfer->ctx);
 }
 
 static void _spi_irq(spi_t spi)
@@ -272,18 +571,124 @@ static void _spi_irq(spi_t spi)
   uint32_t status = SSIIntStatus(base, true);
   SSIIntClear(base, status);
 
-  if (is_dma_done(lut->tx_dma.mask)) {
-    disable_dma_channel(lut->tx_dma.mask);
-    SSIDMADisable(base, SSI_DMA_TX);
-    clear_dma_done(lut->tx_dma.mask);
+  // TX runs ahead: re-arm it first
+  dma_dispatch(lut->tx_dma.mask);
+  dma_dispatch(lut->rx_dma.mask);
+}
+
+static void _spi_tx_done(void* ctx)
+{
+  spi_t spi = (spi_t)(uintptr_t)ctx;
+  const spi_lut_t* lut = &_spi_lut[spi];
+
+  if (_dma_update(spi, true)) {
+    dma_disable(lut->tx_dma.mask);
+    SSIDMADisable(lut->base, SSI_DMA_TX);
   }
+}
+
+static void _spi_rx_done(void* ctx)
+{
+  spi_t spi = (spi_t)(uintptr_t)ctx;
+  const spi_lut_t* lut = &_spi_lut[spi];
 
-  if (is_dma_done(lut->rx_dma.mask)) {
-    disable_dma_channel(lut->rx_dma.mask);
-    SSIDMADisable(base, SSI_DMA_RX);
-    clear_dma_done(lut->rx_dma.mask);
-    _spi_dma_active[spi] = false;
+  bool done = _dma_update(spi, false);
+
+  // RX chunks armed: room for more TX ones
+  _spi_tx_done(ctx);
+
+  if (done) {
+    dma_disable(lut->rx_dma.mask);
+    SSIDMADisable(lut->base, SSI_DMA_RX);
+    _segment_done(spi);
+  }
+}
+
+// Bus error on either channel: abort the transaction
+// (reported as done, with 'error' set)
+static void _spi_dma_error(void* ctx)
+{
+  spi_t spi = (spi_t)(uintptr_t)ctx;
+  spi_state_t* st = &_spi_state[spi];
+  const spi_lut_t* lut = &_spi_lut[spi];
+  uint32_t base = lut->base;
+
+  dma_disable(lut->rx_dma.mask | lut->tx_dma.mask);
+  SSIDMADisable(base, SSI_DMA_TX | SSI_DMA_RX);
+
+  spi_xfer_t* xfer = st->current;
+  if (!xfer) return;
+
+  // frames already in the FIFO go out: drop what comes back
+  while (HWREG(base + SSI_O_SR) & SSI_SR_BSY) {
+  }
+  while (HWREG(base + SSI_O_SR) & SSI_RX_NOT_EMPTY) {
+    (void)HWREG(base + SSI_O_DR);
   }
+
+  if (xfer->flags & SPI_XFER_CS) _cs_release(st->active);
+
+  st->current = 0;
+  _start_next(spi);
+
+  xfer->error = true;
+  xfer->busy = false;
+  if (xfer->done) xfer->done(xfer->ctx);
+}
+
+// RX must not overflow the FIFO: high priority
+static void _spi_claim_dma(spi_t spi)
+{
+  const spi_lut_t* lut = &_spi_lut[spi];
+  void* ctx = (void*)(uintptr_t)spi;
+
+  const dma_callbacks_t rx_cb = {
+    .done = _spi_rx_done,
+    .error = _spi_dma_error,
+    .ctx = ctx,
+  };
+  const dma_callbacks_t tx_cb = {
+    .done = _spi_tx_done,
+    .error = _spi_dma_error,
+    .ctx = ctx,
+  };
+
+  dma_claim(lut->rx_dma.channel, DMA_PRIO_HIGH | DMA_USE_ALT, &rx_cb);
+  dma_claim(lut->tx_dma.channel, DMA_USE_ALT, &tx_cb);
+}
+
+void spi_submit(spi_t spi, spi_xfer_t* xfer)
+{
+  ASSERT(spi < MAX_SPI);
+  ASSERT(xfer->n_segments > 0);
+
+  spi_state_t* st = &_spi_state[spi];
+  xfer->next = 0;
+  xfer->error = false;
+  xfer->busy = true;
+
+  uint32_t primask = CPUcpsid();
+  if (st->owner && !xfer->dev) {
+    // DMA within a selected window: the bus is already ours
+    // (explicit devices are queued: may come from an IRQ
+    // in the middle of the owner's polled transfers)
+    ASSERT(!st->current);
+    _start_xfer(spi, xfer);
+  } else {
+    if (st->tail) {
+      st->tail->next = xfer;
+    } else {
+      st->head = xfer;
+    }
+    st->tail = xfer;
+    if (!st->current) _start_next(spi);
+  }
+  if (!primask) CPUcpsie();
+}
+
+void spi_xfer_wait(const spi_xfer_t* xfer)
+{
+  while (xfer->busy) {}
 }
 
 // len in number of transfers
@@ -291,33 +696,52 @@ static void _spi_irq(spi_t spi)
 static void spi_transfer_dma(spi_t spi, const void *tx, void *rx, uint32_t len,
                              uint32_t data_size, bool blocking)
 {
-  ASSERT(uart < MAX_SPI);
+  ASSERT(spi < MAX_SPI);
+
+  spi_state_t* st = &_spi_state[spi];
+  spi_xfer_t* xfer = &st->dma_xfer;
+  spi_segment_t* seg = &st->dma_segment;
 
   // wait until previous transfer is done
-  while (_spi_dma_active[spi]) {}
- 
-  const spi_lut_t* lut = &_spi_lut[spi];
-  uint32_t base = lut->base;
-  uint32_t rx_channel = lut->rx_dma.channel;
-  uint32_t tx_channel = lut->tx_dma.channel;
+  spi_xfer_wait(xfer);
 
-  _spi_dma_active[spi] = true;
-  _start_rx_dma_xfer(base, rx_channel, rx, len, data_size);
-  _start_tx_dma_xfer(base, tx_channel, tx, len, data_size);
+  seg->tx = tx;
+  seg->rx = rx;
+  seg->len = len;
 
-  enable_dma_channel(lut->rx_dma.mask | lut->tx_dma.mask);
-  SSIDMAEnable(base, SSI_DMA_TX | SSI_DMA_RX);
+  // CS is handled by the caller
+  xfer->segments = seg;
+  xfer->n_segments = 1;
+  xfer->data_size = data_size;
+  xfer->flags = 0;
+  xfer->dev = 0;
+  xfer->done = 0;
+  spi_submit(spi, xfer);
 
   if (blocking) {
     // wait until transfer is done
-    while (_spi_dma_active[spi]) {}
+    spi_xfer_wait(xfer);
   }
 }
 
 void spi_wait_dma_done(spi_t spi)
 {
-  ASSERT(uart < MAX_SPI);
-  while (_spi_dma_active[spi]) {}
+  ASSERT(spi < MAX_SPI);
+  spi_state_t* st = &_spi_state[spi];
+  // transactions queued behind the owner can't start yet
+  while (st->current || (!st->owner && st->head)) {}
+}
+
+void spi_transfer_dma_8(spi_t spi, const uint8_t* tx, uint8_t* rx,
+                        uint32_t len, bool blocking)
+{
+  spi_transfer_dma(spi, tx, rx, len, sizeof(uint8_t), blocking);
+}
+
+void spi_transfer_dma_16(spi_t spi, const uint16_t* tx, uint16_t* rx,
+                         uint32_t len, bool blocking)
+{
+  spi_transfer_dma(spi, tx, rx, len, sizeof(uint16_t), blocking);
 }
 
 void spi_read_dma_8(spi_t spi, uint8_t* data, uint32_t len, bool blocking)
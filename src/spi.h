@@ -25,8 +25,64 @@ typedef struct {
   uint32_t cs;
 } spi_device_t;
 
+// Device on a shared bus: the SSI register image is computed once
+// and only loaded when the active device changes
+typedef struct {
+  spi_t spi;
+  uint32_t cs;
+  uint32_t cr0;
+  uint32_t cpsr;
+} spi_bus_device_t;
+
+// Powers the bus on first use, configures pins and CS
+void spi_device_init(spi_bus_device_t* bdev, spi_t spi,
+                     const spi_device_t* dev);
+
+// Owns the bus for polled transfers (waits for queued transactions);
+// DMA submitted with a NULL device runs at once (part of the owner's
+// window), others wait for spi_device_unselect()
+void spi_device_select(const spi_bus_device_t* bdev);
+void spi_device_unselect(const spi_bus_device_t* bdev);
+
+// Single device per bus
 void spi_init(spi_t spi, const spi_device_t* dev);
 
+// DMA transaction: segments are sent back to back,
+// with CS asserted for the whole transaction if SPI_XFER_CS is set
+typedef struct {
+  const void* tx; // NULL: dummy bytes
+  void* rx;       // NULL: discarded
+  uint32_t len;   // number of transfers (chunked above 1024)
+} spi_segment_t;
+
+#define SPI_XFER_CS (1 << 0)
+
+typedef struct spi_xfer {
+  const spi_segment_t* segments;
+  uint32_t n_segments;
+  uint32_t data_size; // 1 or 2 bytes
+  uint32_t flags;
+
+  // NULL: bus owner, or the device set by spi_init()
+  const spi_bus_device_t* dev;
+
+  // called from IRQ context when the transaction is complete
+  void (*done)(void* ctx);
+  void* ctx;
+
+  // owned by the driver while queued
+  struct spi_xfer* next;
+  volatile bool busy;
+  bool error; // aborted on a DMA bus error
+} spi_xfer_t;
+
+// Queue a transaction (descriptor and segments must stay valid
+// until done): the SSI IRQ chains segments and transactions,
+// switching device configuration when needed
+void spi_submit(spi_t spi, spi_xfer_t* xfer);
+void spi_xfer_wait(const spi_xfer_t* xfer);
+
+// spi_device_select() on the device set by spi_init()
 void spi_select(spi_t spi);
 void spi_unselect(spi_t spi);
 
@@ -40,11 +96,23 @@ void spi_read_16(spi_t spi, uint16_t* data, uint32_t len);
 void spi_write_8(spi_t spi, const uint8_t* data, uint32_t len);
 void spi_write_16(spi_t spi, const uint16_t* data, uint32_t len);
 
-// DMA mtheods
+#if defined(DEBUG)
+// Previous polled path, one frame at a time (benchmarks only)
+void spi_transfer_8_per_frame(spi_t spi, const uint8_t* tx, uint8_t* rx,
+                              uint32_t len);
+#endif
+
+// DMA methods (any length, full-duplex if both tx and rx)
+void spi_transfer_dma_8(spi_t spi, const uint8_t* tx, uint8_t* rx,
+                        uint32_t len, bool blocking);
+void spi_transfer_dma_16(spi_t spi, const uint16_t* tx, uint16_t* rx,
+                         uint32_t len, bool blocking);
+
 void spi_read_dma_8(spi_t spi, uint8_t* data, uint32_t len, bool blocking);
 void spi_read_dma_16(spi_t spi, uint16_t* data, uint32_t len, bool blocking);
 
 void spi_write_dma_8(spi_t spi, const uint8_t* data, uint32_t len, bool blocking);
 void spi_write_dma_16(spi_t spi, const uint16_t* data, uint32_t len, bool blocking);
 
+// Wait until the transaction queue is empty
 void spi_wait_dma_done(spi_t spi);
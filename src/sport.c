@@ -0,0 +1,103 @@
+#include <driverlib/ioc.h>
+
+#include "sport.h"
+#include "serial.h"
+#include "timer.h"
+
+#define SPORT_START_STOP 0x7E
+#define SPORT_BYTE_STUFF 0x7D
+#define SPORT_STUFF_MASK 0x20
+
+#define SPORT_DATA_FRAME 0x10
+#define SPORT_FRAME_SIZE 8
+
+// Physical IDs with their check bits
+static const uint8_t _phys_id[SPORT_MAX_SENSORS] = {
+    0x00, 0xA1, 0x22, 0x83, 0xE4, 0x45, 0xC6, 0x67, 0x48, 0xE9,
+    0x6A, 0xCB, 0xAC, 0x0D, 0x8E, 0x2F, 0xD0, 0x71, 0xF2, 0x53,
+    0x34, 0x95, 0x16, 0xB7, 0x98, 0x39, 0xBA, 0x1B,
+};
+
+static serial_t _serial;
+static sport_data_cb_t _data_cb;
+
+static uint8_t _poll_buf[2];
+static uint32_t _next_poll;
+static uint8_t _polled;
+
+void sport_init(uart_t uart, uint32_t rx, uint32_t tx, sport_data_cb_t cb)
+{
+  const uart_device_t dev = {
+    .mode = UART_8N1,
+    .flags = UART_HALF_DUPLEX | UART_INVERT_RX | UART_INVERT_TX,
+    .baud_rate = SPORT_BAUDRATE,
+    .rx = rx,
+    .tx = tx,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+
+  serial_init(&_serial, uart, &dev);
+  _data_cb = cb;
+  _polled = SPORT_MAX_SENSORS - 1;
+  _next_poll = millis();
+}
+
+static bool _check_crc(const uint8_t* data)
+{
+  uint16_t crc = 0;
+  for (unsigned i = 0; i < SPORT_FRAME_SIZE - 1; i++) {
+    crc += data[i];
+    crc += crc >> 8;
+    crc &= 0xFF;
+  }
+  return (0xFF - crc) == data[SPORT_FRAME_SIZE - 1];
+}
+
+// Reply from the last polled sensor (echo already dropped by the UART)
+static void _decode_reply(const serial_frame_t* frame)
+{
+  uint8_t data[SPORT_FRAME_SIZE];
+  unsigned len = 0;
+  bool stuffed = false;
+
+  for (unsigned i = 0; i < frame->len && len < SPORT_FRAME_SIZE; i++) {
+    uint8_t c = frame->data[i];
+    if (c == SPORT_START_STOP) {
+      len = 0;
+    } else if (c == SPORT_BYTE_STUFF) {
+      stuffed = true;
+    } else {
+      data[len++] = stuffed ? c ^ SPORT_STUFF_MASK : c;
+      stuffed = false;
+    }
+  }
+
+  if (len < SPORT_FRAME_SIZE || data[0] != SPORT_DATA_FRAME) return;
+  if (!_check_crc(data)) return;
+
+  uint16_t app_id = data[1] | (data[2] << 8);
+  uint32_t value = data[3] | (data[4] << 8) | (data[5] << 16) | (data[6] << 24);
+  if (_data_cb) _data_cb(_polled, app_id, value);
+}
+
+void sport_update()
+{
+  const serial_frame_t* frame = serial_get_frame(&_serial);
+  if (frame) {
+    _decode_reply(frame);
+    serial_release_frame(&_serial);
+  }
+
+  if (millis_before(_next_poll)) return;
+  _next_poll += SPORT_POLL_PERIOD_MS;
+
+  // late (e.g. after a blocking command): no burst of catch-up polls
+  if (millis_after(_next_poll)) _next_poll = millis() + SPORT_POLL_PERIOD_MS;
+
+  // the bus is released on EOT, no need to wait for it here
+  _polled = (_polled + 1) % SPORT_MAX_SENSORS;
+  _poll_buf[0] = SPORT_START_STOP;
+  _poll_buf[1] = _phys_id[_polled];
+  serial_write(&_serial, _poll_buf, sizeof(_poll_buf));
+}
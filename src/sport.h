@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "uart.h"
+
+#define SPORT_BAUDRATE 57600
+
+// Sensors are polled one physical ID at a time
+#define SPORT_POLL_PERIOD_MS 12
+#define SPORT_MAX_SENSORS    28
+
+typedef void (*sport_data_cb_t)(uint8_t phys_id, uint16_t app_id,
+                                uint32_t value);
+
+// Half-duplex S.PORT master (57600 8N1)
+//  - the line is inverted by the IOC: use the direct pins
+//  - rx may be IOID_UNUSED for a single wire bus
+void sport_init(uart_t uart, uint32_t rx, uint32_t tx, sport_data_cb_t cb);
+
+// Poll the next sensor when due and decode replies
+// (non-blocking, to be called from the main loop)
+void sport_update();
@@ -1,23 +1,26 @@
 #include <driverlib/timer.h>
 #include <driverlib/prcm.h>
+#include <driverlib/cpu.h>
+#include <stdbool.h>
 
 #include "timer.h"
 
 static volatile uint32_t _ms_ticks = 0;
-static void (*_timeout_callback)() = 0;
+static void (*_tick_callback)() = 0;
 
 static void timer0_int_handler() {
   TimerIntClear(GPT0_BASE, TIMER_TIMA_TIMEOUT);
   ++_ms_ticks;
+  if (_tick_callback) _tick_callback();
 }
 
-static void timeout_int_handler();
+static void sleep_int_handler();
 
 static inline uint16_t _read_micros() { return HWREGH(GPT0_BASE + GPT_O_TAR); }
 
 // Uses:
 // - GPT0-A: millis() & micros()
-// - GPT0-B: one-shots in microseconds (up to ~65ms)
+// - GPT0-B: sleep_us() one-shots (up to ~65ms each)
 // - GPT1: free running @ 48MHz
 // 
 void timer_init()
@@ -43,8 +46,8 @@ void timer_init()
   TimerIntEnable(GPT0_BASE, TIMER_TIMA_TIMEOUT);
   TimerEnable(GPT0_BASE, TIMER_A);
 
-  // GPT0-B: prepare IRQ
-  TimerIntRegister(GPT0_BASE, TIMER_B, timeout_int_handler);
+  // GPT0-B: prepare IRQ (sleep_us)
+  TimerIntRegister(GPT0_BASE, TIMER_B, sleep_int_handler);
 
   // GPT1: 32bit up-counter
   TimerConfigure(GPT1_BASE, TIMER_CFG_PERIODIC_UP);
@@ -52,6 +55,11 @@ void timer_init()
   TimerEnable(GPT1_BASE, TIMER_BOTH);
 }
 
+void timer_set_tick_callback(void (*callback)())
+{
+  _tick_callback = callback;
+}
+
 uint32_t millis() { return _ms_ticks; }
 
 uint32_t micros() {
@@ -77,20 +85,36 @@ void delay_us(uint32_t us)
   while (ticks_before(t)) {}
 }
 
-static void timeout_int_handler() {
-  TimerIntClear(GPT0_BASE, TIMER_TIMB_TIMEOUT);
-  TimerDisable(GPT0_BASE, TIMER_B);
+// GPT0-B: 16 bit @ 1MHz
+#define SLEEP_MAX_US 65536
 
-  if (_timeout_callback) _timeout_callback();
-}
+static volatile bool _sleep_done;
 
-void timer_start_timeout(uint32_t timeout_us, void (*callback)())
-{
-  TimerLoadSet(GPT0_BASE, TIMER_B, timeout_us - 1);
-  TimerEnable(GPT0_BASE, TIMER_B);
+static void sleep_int_handler() {
+  TimerIntClear(GPT0_BASE, TIMER_TIMB_TIMEOUT);
+  TimerDisable(GPT0_BASE, TIMER_B);
+  _sleep_done = true;
 }
 
-void timer_stop_timeout()
+void sleep_us(uint32_t us)
 {
-  TimerDisable(GPT0_BASE, TIMER_B);
+  while (us) {
+    uint32_t n = us > SLEEP_MAX_US ? SLEEP_MAX_US : us;
+    us -= n;
+
+    // WFI with interrupts masked still wakes up on a pending one:
+    // no wake-up lost between the check and WFI
+    uint32_t primask = CPUcpsid();
+    _sleep_done = false;
+    TimerLoadSet(GPT0_BASE, TIMER_B, n - 1);
+    TimerIntClear(GPT0_BASE, TIMER_TIMB_TIMEOUT);
+    TimerIntEnable(GPT0_BASE, TIMER_TIMB_TIMEOUT);
+    TimerEnable(GPT0_BASE, TIMER_B);
+    while (!_sleep_done) {
+      CPUwfi();
+      CPUcpsie();
+      CPUcpsid();
+    }
+    if (!primask) CPUcpsie();
+  }
 }
@@ -17,8 +17,13 @@ uint32_t get_ticks();
 // Microsecond delay
 void delay_us(uint32_t us);
 
-// Convert microseconds into ticks
+// Microsecond delay in WFI, woken up by GPT0-B (reserved for it)
+// (other interrupts are served meanwhile)
+void sleep_us(uint32_t us);
+
+// Convert microseconds into ticks (and back)
 #define us2ticks(us) (us * 48)
+#define ticks2us(ticks) ((ticks) / 48)
 
 // Comparison macros
 #define _timer_diff(t1, t2) ((int32_t)(t1 - t2))
@@ -34,8 +39,5 @@ void delay_us(uint32_t us);
 #define ticks_before(ms) _timer_before(get_ticks(), ms)
 #define ticks_after(ms) _timer_after(get_ticks(), ms)
 
-// Start timeout
-void timer_start_timeout(uint32_t timeout_us, void (*callback)());
-
-// Stop timeout
-void timer_stop_timeout();
+// Called every millisecond from the GPT0-A IRQ
+void timer_set_tick_callback(void (*callback)());
@@ -9,6 +9,7 @@
 
 #include "uart.h"
 #include "dma.h"
+#include "timer.h"
 
 #define MAX_UART 2
 
@@ -20,20 +21,39 @@
 
 #define FIFO_RX_SIZE (4 << (FIFO_RX_LEVEL >> 3))
 
+// TX FIFO space guaranteed when the TX IRQ triggers
+#define FIFO_TX_FREE (32 - (4 << FIFO_TX_LEVEL))
+
+// Keep the compiler from moving ring data accesses
+// past the index update (single core: no DMB needed)
+#define COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+
 // Error IRQs
 #define UART_ERRORS (UART_INT_OE | UART_INT_BE | UART_INT_PE | UART_INT_FE)
 
+// IRQs masked while transmitting in half-duplex mode
+#define HD_RX_IRQS (UART_ERRORS | UART_INT_RT | UART_INT_RX)
+
 #define MAX_DMA_XFER_SIZE(size)  \
   ((size) > UDMA_XFER_SIZE_MAX ? UDMA_XFER_SIZE_MAX : (size))
 
 #define DMA_CHANNEL_NUM(mask) ((uint32_t)__builtin_ctz(mask))
 
+// Max number of scatter-gather tasks per TX DMA job
+// (one per segment, or per UDMA_XFER_SIZE_MAX chunk of a segment)
+#define TX_SG_MAX_TASKS 8
+
 typedef struct {
   uint8_t *buffer;
   uint32_t size;
   volatile uint32_t rcvd;
+  bool split; // hand a full buffer over instead of dropping bytes
 } uart_rx_buffer_t;
 
+// Single producer / single consumer TX ring:
+//  - head is only written by uart_tx_irq()
+//  - tail is only written by the TX IRQ (or by uart_tx_irq()
+//    while the TX IRQ is disabled)
 typedef struct {
   uint8_t *buffer;
   uint32_t size;
@@ -42,10 +62,50 @@ typedef struct {
 } uart_tx_buffer_t;
 
 typedef struct {
+  const uint8_t *buffer;
+  uint32_t size;
+  uint32_t pos; // end of the chunk in flight
+} uart_tx_dma_t;
+
+// RX DMA ring:
+//  - primary and alternate structures cover consecutive segments
+//    of the ring in ping-pong mode (at most one half each)
+//  - seg_end[] holds the ring offset where each segment ends
+typedef struct {
+  uint8_t *buffer;
+  uint32_t size;
+  uint32_t next_seg;
+  uint32_t seg_end[2];
+  uint8_t next_done;
+} uart_rx_ring_t;
+
+// Half-duplex bus:
+//  - tx pin only drives the bus while transmitting
+//  - rx may be the same pin (single wire) or see our own echo
+typedef struct {
+  uint32_t rx_pin;
+  uint32_t tx_pin;
+  uint32_t io_mode;
+  volatile bool tx_active;
+  uint32_t saved_irqs;
+  uint32_t saved_dma;
+} uart_half_duplex_t;
+
+typedef struct {
+  uint32_t flags;
   uart_callbacks_t callbacks;
+  uart_half_duplex_t hd;
   uart_rx_buffer_t rx_buf;
+  uart_rx_ring_t rx_ring;
   uart_tx_buffer_t tx_buf;
+  uart_tx_dma_t tx_dma;
+  uint32_t rx_dma_channel;
   uint32_t tx_dma_channel;
+  tDMAControlTable tx_sg_tasks[TX_SG_MAX_TASKS];
+#if defined(DEBUG)
+  uart_stats_t stats;
+  uint32_t stats_rx_index; // RX DMA: ring offset last accounted
+#endif
 } uart_state_t;
 
 static uart_state_t _uart_state[MAX_UART];
@@ -61,6 +121,25 @@ static const uint32_t _uart_base[MAX_UART] = {
     UART1_BASE,
 };
 
+typedef struct {
+  uint32_t rx;
+  uint32_t tx;
+  uint32_t cts;
+  uint32_t rts;
+} uart_ioc_port_t;
+
+static const uart_ioc_port_t _uart_ioc_port[MAX_UART] = {
+    {IOC_PORT_MCU_UART0_RX, IOC_PORT_MCU_UART0_TX, IOC_PORT_MCU_UART0_CTS,
+     IOC_PORT_MCU_UART0_RTS},
+    {IOC_PORT_MCU_UART1_RX, IOC_PORT_MCU_UART1_TX, IOC_PORT_MCU_UART1_CTS,
+     IOC_PORT_MCU_UART1_RTS},
+};
+
+static const uint8_t _uart_rx_dma_channel[MAX_UART] = {
+  UDMA_CHAN_UART0_RX,
+  UDMA_CHAN_UART1_RX,
+};
+
 static const uint8_t _uart_tx_dma_channel[MAX_UART] = {
   UDMA_CHAN_UART0_TX,
   UDMA_CHAN_UART1_TX,
@@ -72,6 +151,37 @@ static void _init_pwr_domain(uart_t uart) {
   PRCMLoadSet();
 }
 
+static void _hd_release_bus(uart_t uart);
+
+// IOCPinTypeUart() only knows about UART0
+static void _init_pins(uart_t uart, const uart_device_t* dev)
+{
+  const uart_ioc_port_t* port = &_uart_ioc_port[uart];
+  uint32_t rx_mode = (dev->flags & UART_INVERT_RX) ? IOC_IOMODE_INV : 0;
+  uint32_t tx_mode = (dev->flags & UART_INVERT_TX) ? IOC_IOMODE_INV : 0;
+
+  if (dev->flags & UART_HALF_DUPLEX) {
+    uart_half_duplex_t* hd = &_uart_state[uart].hd;
+    hd->tx_pin = dev->tx;
+    hd->rx_pin = (dev->rx != IOID_UNUSED) ? dev->rx : dev->tx;
+    hd->io_mode = rx_mode | tx_mode;
+
+    if (hd->rx_pin != hd->tx_pin)
+      IOCPortConfigureSet(hd->rx_pin, port->rx, IOC_STD_INPUT | rx_mode);
+    _hd_release_bus(uart);
+    return;
+  }
+
+  if (dev->rx != IOID_UNUSED)
+    IOCPortConfigureSet(dev->rx, port->rx, IOC_STD_INPUT | rx_mode);
+  if (dev->tx != IOID_UNUSED)
+    IOCPortConfigureSet(dev->tx, port->tx, IOC_STD_OUTPUT | tx_mode);
+  if (dev->cts != IOID_UNUSED)
+    IOCPortConfigureSet(dev->cts, port->cts, IOC_STD_INPUT);
+  if (dev->rts != IOID_UNUSED)
+    IOCPortConfigureSet(dev->rts, port->rts, IOC_STD_OUTPUT);
+}
+
 static void _init_state(uart_t uart)
 {
   memset(&_uart_state[uart], 0, sizeof(uart_state_t));
@@ -82,6 +192,9 @@ static void _set_callbacks(uart_t uart, const uart_callbacks_t* callbacks)
   memcpy(&_uart_state[uart].callbacks, callbacks, sizeof(uart_callbacks_t));
 }
 
+static void _dma_done_irq(void* ctx);
+static void _dma_error_irq(void* ctx);
+
 void uart_init(uart_t uart, const uart_device_t* dev)
 {
   ASSERT(uart < MAX_UART);
@@ -90,8 +203,18 @@ void uart_init(uart_t uart, const uart_device_t* dev)
   _init_state(uart);
   dma_init();
 
+  // scatter-gather uses the alternate structure
+  const dma_callbacks_t tx_cb = {
+    .done = _dma_done_irq,
+    .error = _dma_error_irq,
+    .ctx = (void*)(uintptr_t)uart,
+  };
+  dma_claim(_uart_tx_dma_channel[uart], DMA_USE_ALT, &tx_cb);
+
+  _uart_state[uart].flags = dev->flags;
+
   uint32_t base = _uart_base[uart];
-  IOCPinTypeUart(base, dev->rx, dev->tx, dev->cts, dev->rts);
+  _init_pins(uart, dev);
 
   UARTDisable(base);
 
@@ -103,6 +226,10 @@ void uart_init(uart_t uart, const uart_device_t* dev)
     cfg = UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_NONE;
     break;
 
+  case UART_8E2:
+    cfg = UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_TWO | UART_CONFIG_PAR_EVEN;
+    break;
+
   default:
     cfg = 0;
     break;
@@ -116,27 +243,117 @@ void uart_init(uart_t uart, const uart_device_t* dev)
   UARTEnable(base);
 }
 
+//
+// Half-duplex direction switching
+//
+
+// Idle level is high on the wire, low if inverted
+static inline uint32_t _hd_pull(const uart_half_duplex_t* hd)
+{
+  return hd->io_mode ? IOC_IOPULL_DOWN : IOC_IOPULL_UP;
+}
+
+// Stop driving the bus and listen again
+static void _hd_release_bus(uart_t uart)
+{
+  uart_half_duplex_t* hd = &_uart_state[uart].hd;
+  const uart_ioc_port_t* port = &_uart_ioc_port[uart];
+  uint32_t io_cfg = (IOC_STD_INPUT & ~IOC_IOPULL_M) | _hd_pull(hd) | hd->io_mode;
+
+  if (hd->rx_pin == hd->tx_pin) {
+    IOCPortConfigureSet(hd->tx_pin, port->rx, io_cfg);
+  } else {
+    IOCPortConfigureSet(hd->tx_pin, IOC_PORT_GPIO, io_cfg);
+  }
+}
+
+static void _hd_set_tx(uart_t uart)
+{
+  uint32_t base = _uart_base[uart];
+  uart_half_duplex_t* hd = &_uart_state[uart].hd;
+  const uart_ioc_port_t* port = &_uart_ioc_port[uart];
+
+  // echo suppression: nothing is received while we talk
+  hd->saved_irqs = HWREG(base + UART_O_IMSC) & HD_RX_IRQS;
+  hd->saved_dma = HWREG(base + UART_O_DMACTL) & UART_DMA_RX;
+  UARTIntDisable(base, HD_RX_IRQS);
+  UARTDMADisable(base, UART_DMA_RX);
+
+  // nothing sent yet: no stale EOT can come after this
+  UARTIntClear(base, UART_INT_EOT);
+  hd->tx_active = true;
+
+  IOCPortConfigureSet(hd->tx_pin, port->tx, IOC_STD_OUTPUT | hd->io_mode);
+}
+
+// Called on EOT: turn the bus around
+static void _hd_set_rx(uart_t uart)
+{
+  uint32_t base = _uart_base[uart];
+  uart_half_duplex_t* hd = &_uart_state[uart].hd;
+
+  _hd_release_bus(uart);
+
+  // drop our own echo
+  while (!(HWREG(base + UART_O_FR) & UART_FR_RXFE)) {
+    (void)HWREG(base + UART_O_DR);
+  }
+  UARTRxErrorClear(base);
+  UARTIntClear(base, HD_RX_IRQS);
+
+  hd->tx_active = false;
+  UARTDMAEnable(base, hd->saved_dma);
+  UARTIntEnable(base, hd->saved_irqs);
+}
+
+static inline bool _is_half_duplex(uart_t uart)
+{
+  return _uart_state[uart].flags & UART_HALF_DUPLEX;
+}
+
+// Take the bus before queueing TX data
+static inline void _hd_tx_begin(uart_t uart)
+{
+  if (_is_half_duplex(uart) && !_uart_state[uart].hd.tx_active) {
+    _hd_set_tx(uart);
+  }
+}
+
+// TX data queued: release the bus on EOT
+static inline void _hd_tx_queued(uart_t uart)
+{
+  if (_is_half_duplex(uart)) {
+    UARTIntEnable(_uart_base[uart], UART_INT_EOT);
+  }
+}
+
 void uart_print(uart_t uart, const char *str)
 {
   ASSERT(uart < MAX_UART);
   uint32_t base = _uart_base[uart];
 
+  _hd_tx_begin(uart);
   while (*str) {
     UARTCharPut(base, *str);
     str++;
   }
+  _hd_tx_queued(uart);
 }
 
 void uart_put_char(uart_t uart, uint8_t data)
 {
   ASSERT(uart < MAX_UART);
+  _hd_tx_begin(uart);
   UARTCharPutNonBlocking(_uart_base[uart], data);
+  _hd_tx_queued(uart);
 }
 
 void uart_put_char_blocking(uart_t uart, uint8_t data)
 {
   ASSERT(uart < MAX_UART);
+  _hd_tx_begin(uart);
   UARTCharPut(_uart_base[uart], data);
+  _hd_tx_queued(uart);
 }
 
 uint8_t uart_get_char(uart_t uart)
@@ -167,51 +384,128 @@ bool uart_rx_fifo_available(uart_t uart)
 // UART IRQ methods
 // 
 
-static inline void _rx_irq(uint32_t base, uart_rx_buffer_t* rx, uint32_t len)
+static inline void _rx_store(uart_state_t* st, uint8_t data)
 {
-  while(len--) {
-    uint8_t data = HWREG(base + UART_O_DR);
-    if (rx->rcvd < rx->size) rx->buffer[rx->rcvd++] = data;
-    // TODO: else set overflow flag?
+  uart_rx_buffer_t* rx = &st->rx_buf;
+  uart_callbacks_t* cb = &st->callbacks;
+  if (rx->rcvd == rx->size && rx->split) {
+    // buffer full: give the owner a chance to hand over a new one
+    if (cb->frame_received) cb->frame_received(cb->ctx);
   }
+  if (rx->rcvd < rx->size) {
+    rx->buffer[rx->rcvd++] = data;
+  } else if (cb->error) {
+    cb->error(cb->ctx, UART_ERROR_RX_FULL);
+  }
+
+#if defined(DEBUG)
+  st->stats.rx_bytes++;
+#endif
 }
 
-static inline void _rx_flush_fifo(uint32_t base, uart_rx_buffer_t* rx)
+static inline void _rx_irq(uint32_t base, uart_state_t* st, uint32_t len)
 {
-  while(!(HWREG(UART0_BASE + UART_O_FR) & UART_FR_RXFE)) {
-    uint8_t data = HWREG(base + UART_O_DR);
-    if (rx->rcvd < rx->size) rx->buffer[rx->rcvd++] = data;
-    // TODO: else set overflow flag?
+  while(len--) {
+    _rx_store(st, HWREG(base + UART_O_DR));
   }
 }
 
-static inline bool _tx_buffer_write(uart_tx_buffer_t* buf, uint8_t data)
+static inline void _rx_flush_fifo(uint32_t base, uart_state_t* st)
 {
-  // check if buffer is full
-  uint32_t size = buf->size;
-  if (((buf->head + 1) & (size - 1)) == buf->tail) {
-    return false;
+  while(!(HWREG(base + UART_O_FR) & UART_FR_RXFE)) {
+    _rx_store(st, HWREG(base + UART_O_DR));
   }
+}
 
-  buf->buffer[buf->head] = data;
-  buf->head = (buf->head + 1) & (size - 1);
-  return true;
+// Copy as much as fits (at most 2 memcpy), return bytes accepted
+static uint32_t _tx_buffer_write(uart_tx_buffer_t* buf, const uint8_t* data,
+                                 uint32_t len)
+{
+  uint32_t mask = buf->size - 1;
+  uint32_t head = buf->head;
+
+  // one byte is kept free to tell full from empty
+  uint32_t space = (buf->tail - head - 1) & mask;
+  if (len > space) len = space;
+  if (len == 0) return 0;
+
+  uint32_t first = buf->size - head;
+  if (first > len) first = len;
+
+  memcpy(buf->buffer + head, data, first);
+  memcpy(buf->buffer, data + first, len - first);
+
+  COMPILER_BARRIER();
+  buf->head = (head + len) & mask;
+  return len;
 }
 
-static inline bool _tx_buffer_read(uart_tx_buffer_t* buf, uint8_t* data)
+// Move data from the ring into the TX FIFO:
+//  - 'room' bytes are written without checking the FIFO status
+//  - returns true if data is left in the ring (FIFO full)
+static bool _tx_buffer_to_fifo(uint32_t base, uart_tx_buffer_t* buf,
+                               uint32_t room)
 {
-  // end of buffer
-  if (buf->tail == buf->head) return false;
+  uint32_t mask = buf->size - 1;
+  uint32_t tail = buf->tail;
+  uint32_t head = buf->head;
+  COMPILER_BARRIER();
+
+  uint32_t count = (head - tail) & mask;
+  if (room > count) room = count;
+  count -= room;
+
+  while (room--) {
+    HWREG(base + UART_O_DR) = buf->buffer[tail];
+    tail = (tail + 1) & mask;
+  }
 
-  *data = buf->buffer[buf->tail];
-  buf->tail = (buf->tail + 1) & (buf->size - 1);
-  return true; 
+  while (count && !(HWREG(base + UART_O_FR) & UART_FR_TXFF)) {
+    HWREG(base + UART_O_DR) = buf->buffer[tail];
+    tail = (tail + 1) & mask;
+    count--;
+  }
+
+  buf->tail = tail;
+  return count != 0;
 }
 
-static void _dma_done_irq(uart_t uart);
+static void _rx_dma_done_irq(void* ctx);
+static void _rx_dma_error_irq(void* ctx);
+static void _rx_dma_timeout_irq(uart_t uart);
+static inline uint32_t _rx_dma_write_index(uart_t uart);
+
+#if defined(DEBUG)
+// TX IRQ refills the FIFO one status check per byte (benchmark)
+static bool _tx_legacy;
+  #define TX_IRQ_ROOM (_tx_legacy ? 0 : FIFO_TX_FREE)
+#else
+  #define TX_IRQ_ROOM FIFO_TX_FREE
+#endif
+
+#if defined(DEBUG)
+  #define STATS_TX(uart, n) (_uart_state[uart].stats.tx_bytes += (n))
+#else
+  #define STATS_TX(uart, n)
+#endif
+
+#if defined(DEBUG)
+// RX DMA: bytes written into the ring since the last IRQ
+// (at least one IRQ per half ring: no wrap-around is missed)
+static void _stats_rx_dma(uart_t uart)
+{
+  uart_state_t* st = &_uart_state[uart];
+  uint32_t wr = _rx_dma_write_index(uart);
+  st->stats.rx_bytes += (wr - st->stats_rx_index) & (st->rx_ring.size - 1);
+  st->stats_rx_index = wr;
+}
+#endif
 
 static void _uart_irq(uart_t uart)
 {
+#if defined(DEBUG)
+  uint32_t start = get_ticks();
+#endif
   uint32_t base = _uart_base[uart];
   uart_state_t* st = &_uart_state[uart];
   uart_callbacks_t* cb = &st->callbacks;
@@ -221,41 +515,55 @@ static void _uart_irq(uart_t uart)
 
   if (status & UART_ERRORS) {
     uint32_t rx_error = UARTRxErrorGet(base);
-    if (cb->error) cb->error((uint8_t)rx_error);
+    if (cb->error) cb->error(cb->ctx, (uint8_t)rx_error);
     UARTRxErrorClear(base);
   }
 
   if ((status & UART_INT_RX) && st->rx_buf.buffer) {
     // we must keep something in the RX FIFO
     // for the timeout IRQ to trigger properly
-    _rx_irq(base, &st->rx_buf, FIFO_RX_SIZE - 2);
+    _rx_irq(base, st, FIFO_RX_SIZE - 2);
   }
 
-  if ((status & UART_INT_RT) && st->rx_buf.buffer) {
-    _rx_flush_fifo(base, &st->rx_buf);
-    if (cb->frame_received) cb->frame_received();
+  // must be handled before the timeout
+  // to keep the ring segments in sync
+  dma_dispatch(st->rx_dma_channel);
+
+  if ((status & UART_INT_RT) && st->rx_dma_channel) {
+    _rx_dma_timeout_irq(uart);
+    if (cb->frame_received) cb->frame_received(cb->ctx);
+  } else if ((status & UART_INT_RT) && st->rx_buf.buffer) {
+    _rx_flush_fifo(base, st);
+    if (cb->frame_received) cb->frame_received(cb->ctx);
   }
 
   if (status & UART_INT_TX) {
-    while (!(HWREG(base + UART_O_FR) & UART_FR_TXFF)) {
-      uint8_t data;
-      if (_tx_buffer_read(&st->tx_buf, &data) != 0) {
-        HWREG(base + UART_O_DR) = data;
-      } else {
-        UARTIntDisable(base, UART_INT_TX);
-        break;
-      }
+    if (!_tx_buffer_to_fifo(base, &st->tx_buf, TX_IRQ_ROOM)) {
+      UARTIntDisable(base, UART_INT_TX);
     }
   }
 
-  if (uDMAIntStatus(UDMA0_BASE) & st->tx_dma_channel) {
-    _dma_done_irq(uart);
-  }
+  dma_dispatch(st->tx_dma_channel);
 
   if (status & UART_INT_EOT) {
     UARTIntDisable(base, UART_INT_EOT);
     st->tx_dma_channel = 0;
+
+    if (st->hd.tx_active) {
+      if (st->tx_buf.head == st->tx_buf.tail) {
+        _hd_set_rx(uart);
+      } else {
+        // more data queued in the meantime
+        UARTIntEnable(base, UART_INT_EOT);
+      }
+    }
   }
+
+#if defined(DEBUG)
+  if (st->rx_dma_channel) _stats_rx_dma(uart);
+  st->stats.irqs++;
+  st->stats.irq_ticks += get_ticks() - start;
+#endif
 }
 
 static void _uart0_irq() { _uart_irq(UART0); }
@@ -300,6 +608,22 @@ void uart_disable_rx_irq(uart_t uart)
   UARTIntDisable(base, UART_INT_RT | UART_INT_RX);
 }
 
+void uart_set_rx_buffer(uart_t uart, void* buffer, uint32_t size)
+{
+  ASSERT(uart < MAX_UART);
+
+  uart_rx_buffer_t* buf = &_uart_state[uart].rx_buf;
+  buf->buffer = buffer;
+  buf->size = size;
+  buf->rcvd = 0;
+}
+
+void uart_set_rx_split(uart_t uart, bool split)
+{
+  ASSERT(uart < MAX_UART);
+  _uart_state[uart].rx_buf.split = split;
+}
+
 uint32_t uart_get_rx_len(uart_t uart)
 {
   ASSERT(uart < MAX_UART);
@@ -312,6 +636,174 @@ void uart_reset_rx_len(uart_t uart)
   _uart_state[uart].rx_buf.rcvd = 0;
 }
 
+// RX DMA methods
+//
+
+// Bursts of half the FIFO level: a burst request leaves at least
+// 4 bytes in the FIFO, even when a segment end splits the burst
+// (otherwise a frame could end with an empty FIFO, and no timeout)
+#define RX_DMA_CTRL \
+  (UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4)
+
+static inline uint32_t _rx_dma_struct(uint32_t dma_channel, uint32_t alt)
+{
+  return dma_channel | (alt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT);
+}
+
+static inline uint32_t _rx_dma_alt_active(uint32_t dma_channel)
+{
+  return (HWREG(UDMA0_BASE + UDMA_O_SETCHNLPRIALT) >> dma_channel) & 1;
+}
+
+// Arm one structure with the segment starting at 'start'
+// (up to the end of the current half)
+static void _rx_dma_arm(uart_t uart, uint32_t alt, uint32_t start)
+{
+  uart_rx_ring_t* ring = &_uart_state[uart].rx_ring;
+  uint32_t half = ring->size / 2;
+  uint32_t end = (start - (start % half)) + half;
+
+  uint32_t dma_struct = _rx_dma_struct(_uart_rx_dma_channel[uart], alt);
+  uDMAChannelTransferSet(UDMA0_BASE, dma_struct, UDMA_MODE_PINGPONG,
+                         (void *)(_uart_base[uart] + UART_O_DR),
+                         ring->buffer + start, end - start);
+  dma_armed(dma_struct, end - start);
+
+  ring->seg_end[alt] = end & (ring->size - 1);
+}
+
+// (Re-)start the ping-pong transfer at ring offset 'start'
+static void _rx_dma_start(uart_t uart, uint32_t start)
+{
+  uart_rx_ring_t* ring = &_uart_state[uart].rx_ring;
+  uint32_t dma_channel = _uart_rx_dma_channel[uart];
+
+  _rx_dma_arm(uart, 0, start);
+  _rx_dma_arm(uart, 1, ring->seg_end[0]);
+  ring->next_seg = ring->seg_end[1];
+  ring->next_done = 0;
+
+  HWREG(UDMA0_BASE + UDMA_O_CLEARCHNLPRIALT) = 1 << dma_channel;
+  uDMAIntClear(UDMA0_BASE, 1 << dma_channel);
+  dma_enable(1 << dma_channel);
+}
+
+static inline uint32_t _rx_dma_write_index(uart_t uart)
+{
+  uart_rx_ring_t* ring = &_uart_state[uart].rx_ring;
+  uint32_t dma_channel = _uart_rx_dma_channel[uart];
+  uint32_t alt, remaining;
+
+  do {
+    alt = _rx_dma_alt_active(dma_channel);
+    remaining = uDMAChannelSizeGet(UDMA0_BASE, _rx_dma_struct(dma_channel, alt));
+  } while (alt != _rx_dma_alt_active(dma_channel));
+
+  return (ring->seg_end[alt] - remaining) & (ring->size - 1);
+}
+
+// A segment has been filled: re-arm its structure
+// with the segment following the one in progress
+static void _rx_dma_done_irq(void* ctx)
+{
+  uart_t uart = (uart_t)(uintptr_t)ctx;
+  uart_state_t* st = &_uart_state[uart];
+  uart_rx_ring_t* ring = &st->rx_ring;
+
+  uint32_t alt = ring->next_done;
+  _rx_dma_arm(uart, alt, ring->next_seg);
+  ring->next_seg = ring->seg_end[alt];
+  ring->next_done = alt ^ 1;
+
+  uart_callbacks_t* cb = &st->callbacks;
+  if (cb->data_received) cb->data_received(cb->ctx);
+}
+
+// Bus error: restart at the current write index,
+// the bytes lost are reported as an error
+static void _rx_dma_error_irq(void* ctx)
+{
+  uart_t uart = (uart_t)(uintptr_t)ctx;
+  uart_callbacks_t* cb = &_uart_state[uart].callbacks;
+
+  _rx_dma_timeout_irq(uart);
+  if (cb->error) cb->error(cb->ctx, UART_ERROR_DMA);
+}
+
+// Bytes below the burst size are left in the FIFO:
+// move them into the ring and restart DMA right after them
+static void _rx_dma_timeout_irq(uart_t uart)
+{
+  uint32_t base = _uart_base[uart];
+  uart_rx_ring_t* ring = &_uart_state[uart].rx_ring;
+  uint32_t dma_channel = _uart_rx_dma_channel[uart];
+
+  dma_disable(1 << dma_channel);
+
+  uint32_t wr = _rx_dma_write_index(uart);
+  while (!(HWREG(base + UART_O_FR) & UART_FR_RXFE)) {
+    ring->buffer[wr] = HWREG(base + UART_O_DR);
+    wr = (wr + 1) & (ring->size - 1);
+  }
+
+  _rx_dma_start(uart, wr);
+}
+
+void uart_enable_rx_dma(uart_t uart, void* buffer, uint32_t size)
+{
+  ASSERT(uart < MAX_UART);
+  ASSERT(size >= 2 * FIFO_RX_SIZE && (size & (size - 1)) == 0);
+  ASSERT(size <= 2 * UDMA_XFER_SIZE_MAX);
+
+  uart_state_t* st = &_uart_state[uart];
+  uint32_t base = _uart_base[uart];
+  uint32_t dma_channel = _uart_rx_dma_channel[uart];
+
+  UARTIntDisable(base, UART_INT_RT | UART_INT_RX);
+
+  st->rx_ring.buffer = buffer;
+  st->rx_ring.size = size;
+  st->rx_dma_channel = 1 << dma_channel;
+#if defined(DEBUG)
+  st->stats_rx_index = 0;
+#endif
+
+  // burst requests only: whatever is below the FIFO level
+  // stays in the FIFO so that the receive timeout triggers
+  const dma_callbacks_t rx_cb = {
+    .done = _rx_dma_done_irq,
+    .error = _rx_dma_error_irq,
+    .ctx = (void*)(uintptr_t)uart,
+  };
+  dma_claim(dma_channel, DMA_PRIO_HIGH | DMA_USE_ALT | DMA_USE_BURST, &rx_cb);
+  uDMAChannelControlSet(UDMA0_BASE, _rx_dma_struct(dma_channel, 0), RX_DMA_CTRL);
+  uDMAChannelControlSet(UDMA0_BASE, _rx_dma_struct(dma_channel, 1), RX_DMA_CTRL);
+
+  _rx_dma_start(uart, 0);
+
+  UARTDMAEnable(base, UART_DMA_RX);
+  UARTIntEnable(base, UART_INT_RT);
+}
+
+void uart_disable_rx_dma(uart_t uart)
+{
+  ASSERT(uart < MAX_UART);
+  uint32_t base = _uart_base[uart];
+  uart_state_t* st = &_uart_state[uart];
+
+  UARTIntDisable(base, UART_INT_RT);
+  UARTDMADisable(base, UART_DMA_RX);
+  dma_release(_uart_rx_dma_channel[uart]);
+  uDMAIntClear(UDMA0_BASE, st->rx_dma_channel);
+  st->rx_dma_channel = 0;
+}
+
+uint32_t uart_rx_dma_write_index(uart_t uart)
+{
+  ASSERT(uart < MAX_UART);
+  return _rx_dma_write_index(uart);
+}
+
 // TX IRQ methods
 // 
 void uart_enable_tx_irq(uart_t uart, void* buffer, uint32_t size)
@@ -336,35 +828,96 @@ static inline bool _tx_irq_enabled(uint32_t base)
   return HWREG(base + UART_O_IMSC) & UART_INT_TX;
 }
 
-static inline bool _tx_buffered(uint32_t uart, uint8_t data)
+bool uart_tx_irq_enabled(uart_t uart)
 {
+  ASSERT(uart < MAX_UART);
+  return _tx_irq_enabled(_uart_base[uart]);
+}
+
+uint32_t uart_tx_irq(uart_t uart, const void* data, uint32_t len)
+{
+  ASSERT(uart < MAX_UART);
   uint32_t base = _uart_base[uart];
-  if (!_tx_irq_enabled(base) && UARTSpaceAvail(base)) {
-    UARTCharPutNonBlocking(base, data);
-    return true;
+  uart_tx_buffer_t* buf = &_uart_state[uart].tx_buf;
+  const uint8_t* tx = (const uint8_t*)data;
+  uint32_t sent = 0;
+
+  _hd_tx_begin(uart);
+
+  // TX IRQ disabled and ring empty: straight into the FIFO
+  if (!_tx_irq_enabled(base) && buf->head == buf->tail) {
+    while (sent < len && !(HWREG(base + UART_O_FR) & UART_FR_TXFF)) {
+      HWREG(base + UART_O_DR) = tx[sent++];
+    }
   }
 
-  _tx_buffer_write(&_uart_state[uart].tx_buf, data);
-  UARTIntEnable(base, UART_INT_TX);
+  sent += _tx_buffer_write(buf, tx + sent, len - sent);
 
-  return true;
+  // The TX IRQ only triggers when the FIFO level is crossed:
+  // while it is disabled, the IRQ does not touch the ring, so
+  // we can fill the FIFO ourselves before enabling it.
+  if (!_tx_irq_enabled(base) && _tx_buffer_to_fifo(base, buf, 0)) {
+    UARTIntEnable(base, UART_INT_TX);
+  }
+
+  if (sent) _hd_tx_queued(uart);
+  STATS_TX(uart, sent);
+  return sent;
 }
 
-bool uart_tx_irq(uart_t uart, const void* data, uint32_t len)
+uint32_t uart_print_irq(uart_t uart, const char* str)
 {
-  ASSERT(uart < MAX_UART);
-  const uint8_t* tx = (const uint8_t*)data;
+  uint32_t len = strlen(str);
+  return uart_tx_irq(uart, (const uint8_t*)str, len);
+}
+
+#if defined(DEBUG)
+// Previous uart_tx_irq(): one byte per call, TX IRQ enabled each time
+static void _tx_irq_legacy(uart_t uart, const uint8_t* data, uint32_t len)
+{
+  uint32_t base = _uart_base[uart];
+  uart_tx_buffer_t* buf = &_uart_state[uart].tx_buf;
+
+  _hd_tx_begin(uart);
   while (len--) {
-    if (!_tx_buffered(uart, *tx++)) return false;
+    if (!_tx_irq_enabled(base) && UARTSpaceAvail(base)) {
+      UARTCharPutNonBlocking(base, *data++);
+      continue;
+    }
+    _tx_buffer_write(buf, data++, 1);
+    UARTIntEnable(base, UART_INT_TX);
   }
-  return true;
+  _hd_tx_queued(uart);
 }
 
-bool uart_print_irq(uart_t uart, const char* str)
+uint32_t uart_bench_tx_irq(uart_t uart, const void* data, uint32_t len,
+                           bool legacy)
 {
-  uint32_t len = strlen(str);
-  return uart_tx_irq(uart, (const uint8_t*)str, len);
+  ASSERT(uart < MAX_UART);
+  uint32_t base = _uart_base[uart];
+  uart_state_t* st = &_uart_state[uart];
+  ASSERT(len < st->tx_buf.size);
+
+  // ring drained: nothing else is accounted
+  while (_tx_irq_enabled(base)) {}
+  _tx_legacy = legacy;
+
+  // IRQs preempting the producer are only counted once
+  uint32_t start = get_ticks();
+  if (legacy) {
+    _tx_irq_legacy(uart, (const uint8_t*)data, len);
+  } else {
+    uart_tx_irq(uart, data, len);
+  }
+  uint32_t producer = get_ticks() - start;
+  uint32_t irq_ticks = st->stats.irq_ticks;
+
+  while (_tx_irq_enabled(base)) {}
+  _tx_legacy = false;
+
+  return producer + (st->stats.irq_ticks - irq_ticks);
 }
+#endif
 
 // TX DMA methods
 //
@@ -380,9 +933,13 @@ static void _start_tx_dma_xfer(uint32_t uart, uint32_t dma_channel,
 
   uDMAChannelTransferSet(UDMA0_BASE, dma_channel, mode, (void *)buffer,
                          (void *)(base + UART_O_DR), len);
+  dma_armed(dma_channel, len);
+
+  // a scatter-gather job ends on the alternate structure
+  HWREG(UDMA0_BASE + UDMA_O_CLEARCHNLPRIALT) = 1 << dma_channel;
 
   _uart_state[uart].tx_dma_channel |= (1 << dma_channel);
-  uDMAChannelEnable(UDMA0_BASE, dma_channel);
+  dma_enable(1 << dma_channel);
   UARTDMAEnable(base, UART_DMA_TX);
 }
 
@@ -392,20 +949,86 @@ void uart_tx_dma(uart_t uart, const void* buffer, uint32_t len)
 
   // disable RX & TX channels
   uint8_t dma_channel = _uart_tx_dma_channel[uart];
-  uDMAChannelDisable(UDMA0_BASE, dma_channel);
+  dma_disable(1 << dma_channel);
+  _hd_tx_begin(uart);
 
   // set buffer
-  uart_tx_buffer_t* buf = &_uart_state[uart].tx_buf;
-  buf->buffer = (uint8_t*)buffer;
-  buf->size = len;
+  uart_tx_dma_t* dma = &_uart_state[uart].tx_dma;
+  dma->buffer = (const uint8_t*)buffer;
+  dma->size = len;
+  STATS_TX(uart, len);
 
   len = MAX_DMA_XFER_SIZE(len);
-  buf->head = len;
-  buf->tail = 0;
+  dma->pos = len;
 
   _start_tx_dma_xfer(uart, dma_channel, (void *)buffer, len);
 }
 
+bool uart_tx_dma_sg(uart_t uart, const uart_iovec_t* iov, uint32_t n)
+{
+  ASSERT(uart < MAX_UART);
+
+  uart_state_t* st = &_uart_state[uart];
+  uint8_t dma_channel = _uart_tx_dma_channel[uart];
+  uint32_t base = _uart_base[uart];
+
+  uint32_t tasks = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    tasks += (iov[i].len + UDMA_XFER_SIZE_MAX - 1) / UDMA_XFER_SIZE_MAX;
+  }
+  if (tasks > TX_SG_MAX_TASKS) return false;
+  if (tasks == 0) return true;
+
+  dma_disable(1 << dma_channel);
+  _hd_tx_begin(uart);
+
+  // build the task list
+  tDMAControlTable* task = st->tx_sg_tasks;
+  uint32_t bytes = 0;
+  tasks = 0;
+
+  for (; n > 0; n--, iov++) {
+    const uint8_t* data = (const uint8_t*)iov->base;
+    uint32_t len = iov->len;
+
+    while (len > 0) {
+      uint32_t xfer_len = MAX_DMA_XFER_SIZE(len);
+      task[tasks].pvSrcEndAddr = (void*)(data + xfer_len - 1);
+      task[tasks].pvDstEndAddr = (void*)(base + UART_O_DR);
+      task[tasks].ui32Control = UDMA_SIZE_8 | UDMA_SRC_INC_8 |
+                                UDMA_DST_INC_NONE | UDMA_ARB_4 |
+                                ((xfer_len - 1) << UDMA_XFER_SIZE_S) |
+                                UDMA_MODE_PER_SCATTER_GATHER |
+                                UDMA_MODE_ALT_SELECT;
+      task[tasks].ui32Spare = 0;
+      tasks++;
+
+      data += xfer_len;
+      len -= xfer_len;
+      bytes += xfer_len;
+    }
+  }
+
+  // last task stops the channel
+  task[tasks - 1].ui32Control &= ~UDMA_MODE_M;
+  task[tasks - 1].ui32Control |= UDMA_MODE_BASIC;
+
+  // nothing left to re-arm on completion
+  uart_tx_dma_t* dma = &st->tx_dma;
+  dma->buffer = 0;
+  dma->size = dma->pos = 0;
+
+  uDMAChannelScatterGatherSet(UDMA0_BASE, dma_channel, tasks, task, true);
+  dma_armed(dma_channel, bytes);
+  STATS_TX(uart, bytes);
+
+  st->tx_dma_channel |= (1 << dma_channel);
+  dma_enable(1 << dma_channel);
+  UARTDMAEnable(base, UART_DMA_TX);
+
+  return true;
+}
+
 bool uart_tx_dma_done(uart_t uart)
 {
   ASSERT(uart < MAX_UART);
@@ -421,31 +1044,54 @@ void uart_tx_dma_wait(uart_t uart)
   while (HWREG(base + UART_O_FR) & UART_FR_BUSY) {}
 }
 
-static void _dma_done_irq(uart_t uart)
+static void _dma_done_irq(void* ctx)
 {
   // disable DMA channel & TX DMA
+  uart_t uart = (uart_t)(uintptr_t)ctx;
   uint32_t base = _uart_base[uart];
   uart_state_t* st = &_uart_state[uart];
-  uint32_t dma_channel_mask = st->tx_dma_channel;
-  uint32_t dma_channel = DMA_CHANNEL_NUM(dma_channel_mask);
+  uint32_t dma_channel = DMA_CHANNEL_NUM(st->tx_dma_channel);
 
-  uDMAChannelDisable(UDMA0_BASE, dma_channel);
+  dma_disable(1 << dma_channel);
   UARTDMADisable(base, UART_DMA_TX);
-  uDMAIntClear(UDMA0_BASE, dma_channel_mask);
 
   // update buffer state
-  uart_tx_buffer_t* buf = &st->tx_buf;
-  buf->tail += (buf->head - buf->tail);
+  uart_tx_dma_t* dma = &st->tx_dma;
 
-  if (buf->tail < buf->size) {
+  if (dma->pos < dma->size) {
     // transfer not yet complete
-    uint32_t xfer_len = MAX_DMA_XFER_SIZE(buf->size - buf->tail);
-    buf->head = buf->tail + xfer_len;
+    uint32_t xfer_len = MAX_DMA_XFER_SIZE(dma->size - dma->pos);
+    const uint8_t* buffer = dma->buffer + dma->pos;
+    dma->pos += xfer_len;
 
-    const uint8_t* buffer = buf->buffer + buf->tail;
     _start_tx_dma_xfer(uart, dma_channel, (void *)buffer, xfer_len);
   } else {
     // transfer complete
     UARTIntEnable(base, UART_INT_EOT);
   }
 }
+
+// Bus error: the rest of the buffer is dropped,
+// the transfer ends as usual (on EOT)
+static void _dma_error_irq(void* ctx)
+{
+  uart_t uart = (uart_t)(uintptr_t)ctx;
+  uint32_t base = _uart_base[uart];
+  uart_state_t* st = &_uart_state[uart];
+
+  dma_disable(1 << _uart_tx_dma_channel[uart]);
+  UARTDMADisable(base, UART_DMA_TX);
+
+  uart_tx_dma_t* dma = &st->tx_dma;
+  dma->pos = dma->size;
+
+  UARTIntEnable(base, UART_INT_EOT);
+}
+
+#if defined(DEBUG)
+const uart_stats_t* uart_get_stats(uart_t uart)
+{
+  ASSERT(uart < MAX_UART);
+  return &_uart_state[uart].stats;
+}
+#endif
@@ -10,17 +10,31 @@ typedef enum {
 
 typedef enum {
   UART_8N1,
+  UART_8E2,
 } uart_mode_t;
 
 typedef enum {
+  UART_ERROR_RX_FULL = 32, // RX IRQ buffer full (byte lost)
+  UART_ERROR_DMA = 16, // RX DMA bus error (bytes lost)
   UART_ERROR_OVERRUN = 8,
   UART_ERROR_BREAK = 4,
   UART_ERROR_PARITY = 2,
   UART_ERROR_FRAMING = 1,
 } uart_error_t;
 
+// Device flags
+//  - UART_INVERT_*: signal inverted by the IOC
+//  - UART_HALF_DUPLEX: 'tx' only drives the bus while transmitting,
+//    received bytes are dropped until the end of transmission (EOT).
+//    'rx' may be IOID_UNUSED (or 'tx') for single wire mode.
+//    Requires uart_enable_irqs().
+#define UART_INVERT_RX   (1 << 0)
+#define UART_INVERT_TX   (1 << 1)
+#define UART_HALF_DUPLEX (1 << 2)
+
 typedef struct {
   uart_mode_t mode;
+  uint32_t flags;
   uint32_t baud_rate;
   uint32_t rx;
   uint32_t tx;
@@ -29,6 +43,7 @@ typedef struct {
 } uart_device_t;
 
 // Initialise UART without any IRQ or DMA
+// (once per UART: its TX DMA channel is claimed here)
 void uart_init(uart_t uart, const uart_device_t* dev);
 
 // Blocking UART write
@@ -54,30 +69,86 @@ bool uart_rx_fifo_available(uart_t uart);
 // UART IRQ methods
 // 
 
+// Callbacks are called from IRQ context with 'ctx'
 typedef struct {
-  void (*frame_received)();
-  void (*error)(uart_error_t error);
+  void (*frame_received)(void* ctx);
+  void (*data_received)(void* ctx);
+  void (*error)(void* ctx, uart_error_t error);
+  void* ctx;
 } uart_callbacks_t;
 
 // Initialise IRQ mode
 void uart_enable_irqs(uart_t uart, const uart_callbacks_t* callbacks);
 
 // RX IRQ methods
+//  - frame_received() is called on receive timeout
+//  - bytes arriving while the buffer is full are dropped (UART_ERROR_RX_FULL)
 void uart_enable_rx_irq(uart_t uart, void* buffer, uint32_t size);
 void uart_disable_rx_irq(uart_t uart);
 
+// Split mode: frame_received() is also called when a byte arrives
+// while the buffer is full (streams longer than the buffer)
+void uart_set_rx_split(uart_t uart, bool split);
+
+// Switch to another RX buffer (safe from frame_received())
+void uart_set_rx_buffer(uart_t uart, void* buffer, uint32_t size);
+
 void uart_reset_rx_len(uart_t uart);
 uint32_t uart_get_rx_len(uart_t uart);
 
+// RX DMA methods
+//  - buffer is used as a ring (power of 2, up to 2 x UDMA_XFER_SIZE_MAX)
+//  - IRQs only when a half is filled or on receive timeout
+//  - frame_received() is called on receive timeout
+//  - data_received() is called when a half is filled
+//  - the RX channel is claimed until uart_disable_rx_dma()
+void uart_enable_rx_dma(uart_t uart, void* buffer, uint32_t size);
+void uart_disable_rx_dma(uart_t uart);
+
+// Ring offset of the next byte to be received
+uint32_t uart_rx_dma_write_index(uart_t uart);
+
 // TX IRQ methods
 void uart_enable_tx_irq(uart_t uart, void* buffer, uint32_t size);
 void uart_disable_tx_irq(uart_t uart);
 bool uart_tx_irq_enabled(uart_t uart);
 
-bool uart_tx_irq(uart_t uart, const void* data, uint32_t len);
-bool uart_print_irq(uart_t uart, const char* str);
+// Queue data for IRQ transmission (non-blocking)
+//  - returns the number of bytes accepted (less than len if the ring is full)
+//  - single producer: not to be called from IRQ context
+uint32_t uart_tx_irq(uart_t uart, const void* data, uint32_t len);
+uint32_t uart_print_irq(uart_t uart, const char* str);
 
 // TX DMA methods
 void uart_tx_dma(uart_t uart, const void* buffer, uint32_t len);
+
+typedef struct {
+  const void* base;
+  uint32_t len;
+} uart_iovec_t;
+
+// Send discontiguous segments as a single DMA job
+// (peripheral scatter-gather, one completion IRQ)
+//  - segments must stay valid until the transfer is done
+//  - returns false if they need more than 8 DMA tasks
+bool uart_tx_dma_sg(uart_t uart, const uart_iovec_t* iov, uint32_t n);
 bool uart_tx_dma_done(uart_t uart);
 void uart_tx_dma_wait(uart_t uart);
+
+#if defined(DEBUG)
+// IRQ load (GPT1 ticks run at the CPU clock)
+typedef struct {
+  uint32_t irqs;
+  uint32_t irq_ticks;
+  uint32_t rx_bytes;
+  uint32_t tx_bytes; // queued by the IRQ / DMA methods
+} uart_stats_t;
+
+const uart_stats_t* uart_get_stats(uart_t uart);
+
+// CPU cycles (producer and IRQ) to send 'len' bytes through the TX
+// ring, up to TX ring size - 1. 'legacy': previous path (one byte
+// per call, FIFO status checked for each byte), for comparison.
+uint32_t uart_bench_tx_irq(uart_t uart, const void* data, uint32_t len,
+                           bool legacy);
+#endif
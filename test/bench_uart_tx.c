@@ -0,0 +1,60 @@
+// UART TX ring: CPU cycles per byte (producer and TX IRQ), previous
+// per-byte path vs current one. Code between register accesses takes
+// no time in the simulator: this counts the register accesses.
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "serial.h"
+#include "sim.h"
+#include "test.h"
+
+#define TOTAL 16384
+#define CHUNK 100 // fits in the ring
+
+static serial_t _serial;
+static uint8_t _data[TOTAL];
+
+static uint32_t _bench(bool legacy)
+{
+  uint32_t cycles = 0;
+  sim_uart_sent_clear(UART0);
+
+  for (uint32_t pos = 0; pos < TOTAL; pos += CHUNK) {
+    uint32_t n = TOTAL - pos;
+    if (n > CHUNK) n = CHUNK;
+    cycles += uart_bench_tx_irq(UART0, _data + pos, n, legacy);
+  }
+  sim_run(sim_uart_char_ns(UART0) * 64);
+
+  size_t len;
+  const uint8_t* sent = sim_uart_sent(UART0, &len);
+  CHECK_EQ(len, TOTAL);
+  CHECK(memcmp(sent, _data, TOTAL) == 0);
+  CHECK_EQ(sim_uart_tx_dropped(UART0), 0);
+  return cycles;
+}
+
+int main()
+{
+  const uart_device_t dev = {
+    .mode = UART_8N1,
+    .baud_rate = SERIAL_BAUDRATE,
+    .rx = IOID_2,
+    .tx = IOID_3,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+  serial_init(&_serial, UART0, &dev);
+
+  srand(4);
+  for (uint32_t i = 0; i < TOTAL; i++) _data[i] = rand();
+
+  uint32_t legacy = _bench(true);
+  uint32_t ring = _bench(false);
+
+  printf("TX ring: %.2f cycles/byte (one byte per call: %.2f)\n",
+         (double)ring / TOTAL, (double)legacy / TOTAL);
+  CHECK(ring < legacy);
+  return 0;
+}
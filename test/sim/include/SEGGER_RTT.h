@@ -0,0 +1,6 @@
+#pragma once
+
+// RTT output goes to stderr
+#include <stdio.h>
+
+#define SEGGER_RTT_printf(term, ...) fprintf(stderr, __VA_ARGS__)
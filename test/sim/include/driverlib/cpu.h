@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// PRIMASK: IRQs are only served while it is clear
+uint32_t CPUcpsid();
+uint32_t CPUcpsie();
+
+// Sleeps until the next IRQ
+void CPUwfi();
+
+// 3 cycles per loop
+void CPUdelay(uint32_t count);
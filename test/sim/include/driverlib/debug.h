@@ -0,0 +1,6 @@
+#pragma once
+
+// Driverlib assertions are always checked on the host
+#include <assert.h>
+
+#define ASSERT(expr) assert(expr)
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <inc/hw_types.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_gpio.h>
+
+// Same register accesses as driverlib
+static inline uint32_t GPIO_readDio(uint32_t dio)
+{
+  return (HWREG(GPIO_BASE + GPIO_O_DIN31_0) >> dio) & 1;
+}
+
+static inline void GPIO_setDio(uint32_t dio)
+{
+  sim_hwreg_write(GPIO_BASE + GPIO_O_DOUTSET31_0, 1u << dio);
+}
+
+static inline void GPIO_clearDio(uint32_t dio)
+{
+  sim_hwreg_write(GPIO_BASE + GPIO_O_DOUTCLR31_0, 1u << dio);
+}
+
+static inline void GPIO_toggleDio(uint32_t dio)
+{
+  sim_hwreg_write(GPIO_BASE + GPIO_O_DOUTTGL31_0, 1u << dio);
+}
+
+static inline void GPIO_writeDio(uint32_t dio, uint32_t value)
+{
+  if (value) {
+    GPIO_setDio(dio);
+  } else {
+    GPIO_clearDio(dio);
+  }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <inc/hw_ints.h>
+
+void IntRegister(uint32_t interrupt, void (*handler)(void));
+void IntUnregister(uint32_t interrupt);
+void IntEnable(uint32_t interrupt);
+void IntDisable(uint32_t interrupt);
+
+bool IntMasterEnable();
+bool IntMasterDisable();
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <inc/hw_types.h>
+#include <inc/hw_memmap.h>
+
+#include "gpio.h"
+
+// IO IDs
+#define IOID_0    0
+#define IOID_1    1
+#define IOID_2    2
+#define IOID_3    3
+#define IOID_4    4
+#define IOID_5    5
+#define IOID_6    6
+#define IOID_7    7
+#define IOID_8    8
+#define IOID_9    9
+#define IOID_10  10
+#define IOID_11  11
+#define IOID_12  12
+#define IOID_13  13
+#define IOID_14  14
+#define IOID_15  15
+#define IOID_16  16
+#define IOID_17  17
+#define IOID_18  18
+#define IOID_19  19
+#define IOID_20  20
+#define IOID_21  21
+#define IOID_22  22
+#define IOID_23  23
+#define IOID_24  24
+#define IOID_25  25
+#define IOID_26  26
+#define IOID_27  27
+#define IOID_28  28
+#define IOID_29  29
+#define IOID_30  30
+#define IOID_31  31
+#define IOID_UNUSED 0xFFFFFFFF
+
+// Port IDs (values from driverlib)
+#define IOC_PORT_GPIO           0x00000000
+#define IOC_PORT_MCU_SSI0_RX    0x00000009
+#define IOC_PORT_MCU_SSI0_TX    0x0000000A
+#define IOC_PORT_MCU_SSI0_FSS   0x0000000B
+#define IOC_PORT_MCU_SSI0_CLK   0x0000000C
+#define IOC_PORT_MCU_UART0_RX   0x0000000F
+#define IOC_PORT_MCU_UART0_TX   0x00000010
+#define IOC_PORT_MCU_UART0_CTS  0x00000011
+#define IOC_PORT_MCU_UART0_RTS  0x00000012
+#define IOC_PORT_MCU_UART1_RX   0x00000013
+#define IOC_PORT_MCU_UART1_TX   0x00000014
+#define IOC_PORT_MCU_UART1_CTS  0x00000015
+#define IOC_PORT_MCU_UART1_RTS  0x00000016
+#define IOC_PORT_MCU_SSI1_RX    0x00000021
+#define IOC_PORT_MCU_SSI1_TX    0x00000022
+#define IOC_PORT_MCU_SSI1_FSS   0x00000023
+#define IOC_PORT_MCU_SSI1_CLK   0x00000024
+
+// IO configuration (values from driverlib)
+#define IOC_SLEW_ENABLE    0x00001000
+#define IOC_SLEW_DISABLE   0x00000000
+#define IOC_INPUT_ENABLE   0x20000000
+#define IOC_INPUT_DISABLE  0x00000000
+#define IOC_HYST_ENABLE    0x40000000
+#define IOC_HYST_DISABLE   0x00000000
+#define IOC_NO_WAKE_UP     0x00000000
+#define IOC_IOMODE_NORMAL  0x00000000
+#define IOC_IOMODE_INV     0x01000000
+#define IOC_NO_EDGE        0x00000000
+#define IOC_INT_DISABLE    0x00000000
+#define IOC_NO_IOPULL      0x00006000
+#define IOC_IOPULL_UP      0x00004000
+#define IOC_IOPULL_DOWN    0x00002000
+#define IOC_IOPULL_M       0x00006000
+#define IOC_CURRENT_2MA    0x00000000
+#define IOC_STRENGTH_AUTO  0x00000000
+
+#define IOC_STD_INPUT                                                   \
+  (IOC_CURRENT_2MA | IOC_STRENGTH_AUTO | IOC_NO_IOPULL |                \
+   IOC_SLEW_DISABLE | IOC_HYST_DISABLE | IOC_NO_EDGE | IOC_INT_DISABLE | \
+   IOC_IOMODE_NORMAL | IOC_NO_WAKE_UP | IOC_INPUT_ENABLE)
+
+#define IOC_STD_OUTPUT                                                  \
+  (IOC_CURRENT_2MA | IOC_STRENGTH_AUTO | IOC_NO_IOPULL |                \
+   IOC_SLEW_DISABLE | IOC_HYST_DISABLE | IOC_NO_EDGE | IOC_INT_DISABLE | \
+   IOC_IOMODE_NORMAL | IOC_NO_WAKE_UP | IOC_INPUT_DISABLE)
+
+// Pin muxing is recorded (see sim_ioc_port())
+void IOCPortConfigureSet(uint32_t ioid, uint32_t port, uint32_t config);
+void IOCPinTypeGpioInput(uint32_t ioid);
+void IOCPinTypeGpioOutput(uint32_t ioid);
+void IOCPinTypeUart(uint32_t base, uint32_t rx, uint32_t tx, uint32_t cts,
+                    uint32_t rts);
+void IOCPinTypeSsiMaster(uint32_t base, uint32_t rx, uint32_t tx,
+                         uint32_t fss, uint32_t clk);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Peripheral IDs (values from driverlib)
+#define PRCM_PERIPH_SSI0   0x00000100
+#define PRCM_PERIPH_SSI1   0x00000101
+#define PRCM_PERIPH_UART0  0x00000200
+#define PRCM_PERIPH_UART1  0x00000201
+#define PRCM_PERIPH_UDMA   0x00000408
+
+// Power domains are always on
+void PRCMPeripheralRunEnable(uint32_t peripheral);
+void PRCMPeripheralRunDisable(uint32_t peripheral);
+void PRCMLoadSet();
+bool PRCMLoadGet();
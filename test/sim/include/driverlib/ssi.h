@@ -0,0 +1,106 @@
+#pragma once
+
+// Host replacement for driverlib/ssi.h: same register
+// accesses as driverlib, on the simulated SSI
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <inc/hw_ints.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_types.h>
+#include <inc/hw_ssi.h>
+
+#include "debug.h"
+#include "interrupt.h"
+
+#define SSI_TXFF  0x00000008
+#define SSI_RXFF  0x00000004
+#define SSI_RXTO  0x00000002
+#define SSI_RXOR  0x00000001
+
+#define SSI_FRF_MOTO_MODE_0  0x00000000
+#define SSI_FRF_MOTO_MODE_1  0x00000002
+#define SSI_FRF_MOTO_MODE_2  0x00000001
+#define SSI_FRF_MOTO_MODE_3  0x00000003
+#define SSI_FRF_TI           0x00000010
+#define SSI_FRF_NMW          0x00000020
+
+#define SSI_MODE_MASTER  0x00000000
+#define SSI_MODE_SLAVE   0x00000001
+
+#define SSI_DMA_TX  0x00000002
+#define SSI_DMA_RX  0x00000001
+
+#define SSI_RX_FULL       0x00000008
+#define SSI_RX_NOT_EMPTY  0x00000004
+#define SSI_TX_NOT_FULL   0x00000002
+#define SSI_TX_EMPTY      0x00000001
+
+static inline void SSIEnable(uint32_t base)
+{
+  sim_hwreg_write(base + SSI_O_CR1, HWREG(base + SSI_O_CR1) | SSI_CR1_SSE);
+}
+
+static inline void SSIDisable(uint32_t base)
+{
+  sim_hwreg_write(base + SSI_O_CR1, HWREG(base + SSI_O_CR1) & ~SSI_CR1_SSE);
+}
+
+static inline bool SSIBusy(uint32_t base)
+{
+  return HWREG(base + SSI_O_SR) & SSI_SR_BSY;
+}
+
+static inline void SSIDataPut(uint32_t base, uint32_t data)
+{
+  while (!(HWREG(base + SSI_O_SR) & SSI_SR_TNF)) {
+    sim_idle();
+  }
+  sim_hwreg_write(base + SSI_O_DR, data);
+}
+
+static inline void SSIDataGet(uint32_t base, uint32_t* data)
+{
+  while (!(HWREG(base + SSI_O_SR) & SSI_SR_RNE)) {
+    sim_idle();
+  }
+  *data = HWREG(base + SSI_O_DR);
+}
+
+static inline void SSIIntRegister(uint32_t base, void (*handler)(void))
+{
+  uint32_t irq = (base == SSI0_BASE) ? INT_SSI0_COMB : INT_SSI1_COMB;
+  IntRegister(irq, handler);
+  IntEnable(irq);
+}
+
+static inline void SSIIntEnable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + SSI_O_IMSC, HWREG(base + SSI_O_IMSC) | flags);
+}
+
+static inline void SSIIntDisable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + SSI_O_IMSC, HWREG(base + SSI_O_IMSC) & ~flags);
+}
+
+static inline uint32_t SSIIntStatus(uint32_t base, bool masked)
+{
+  return HWREG(base + (masked ? SSI_O_MIS : SSI_O_RIS));
+}
+
+static inline void SSIIntClear(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + SSI_O_ICR, flags);
+}
+
+static inline void SSIDMAEnable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + SSI_O_DMACR, HWREG(base + SSI_O_DMACR) | flags);
+}
+
+static inline void SSIDMADisable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + SSI_O_DMACR, HWREG(base + SSI_O_DMACR) & ~flags);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// 48 MHz
+uint32_t SysCtrlClockGet();
@@ -0,0 +1,201 @@
+#pragma once
+
+// Host replacement for driverlib/uart.h: same register
+// accesses as driverlib, on the simulated UART
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <inc/hw_types.h>
+#include <inc/hw_uart.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_ints.h>
+
+#include "interrupt.h"
+#include "debug.h"
+
+#define UART_INT_EOT  UART_IMSC_EOTIM
+#define UART_INT_OE   UART_IMSC_OEIM
+#define UART_INT_BE   UART_IMSC_BEIM
+#define UART_INT_PE   UART_IMSC_PEIM
+#define UART_INT_FE   UART_IMSC_FEIM
+#define UART_INT_RT   UART_IMSC_RTIM
+#define UART_INT_TX   UART_IMSC_TXIM
+#define UART_INT_RX   UART_IMSC_RXIM
+#define UART_INT_CTS  UART_IMSC_CTSMIM
+
+#define UART_CONFIG_WLEN_8    0x00000060
+#define UART_CONFIG_WLEN_7    0x00000040
+#define UART_CONFIG_STOP_ONE  0x00000000
+#define UART_CONFIG_STOP_TWO  0x00000008
+#define UART_CONFIG_PAR_NONE  0x00000000
+#define UART_CONFIG_PAR_EVEN  0x00000006
+#define UART_CONFIG_PAR_ODD   0x00000002
+
+#define UART_FIFO_TX1_8  0x00000000
+#define UART_FIFO_TX2_8  0x00000001
+#define UART_FIFO_TX4_8  0x00000002
+#define UART_FIFO_TX6_8  0x00000003
+#define UART_FIFO_TX7_8  0x00000004
+#define UART_FIFO_RX1_8  0x00000000
+#define UART_FIFO_RX2_8  0x00000008
+#define UART_FIFO_RX4_8  0x00000010
+#define UART_FIFO_RX6_8  0x00000018
+#define UART_FIFO_RX7_8  0x00000020
+
+#define UART_DMA_ON_ERROR  0x00000004
+#define UART_DMA_RX        0x00000001
+#define UART_DMA_TX        0x00000002
+
+#define UART_RXERROR_OVERRUN  0x00000008
+#define UART_RXERROR_BREAK    0x00000004
+#define UART_RXERROR_PARITY   0x00000002
+#define UART_RXERROR_FRAMING  0x00000001
+
+static inline void UARTFIFOLevelSet(uint32_t base, uint32_t tx_level,
+                                    uint32_t rx_level)
+{
+  sim_hwreg_write(base + UART_O_IFLS, tx_level | rx_level);
+}
+
+static inline void UARTFIFOEnable(uint32_t base)
+{
+  sim_hwreg_write(base + UART_O_LCRH,
+                  HWREG(base + UART_O_LCRH) | UART_LCRH_FEN);
+}
+
+static inline void UARTFIFODisable(uint32_t base)
+{
+  sim_hwreg_write(base + UART_O_LCRH,
+                  HWREG(base + UART_O_LCRH) & ~UART_LCRH_FEN);
+}
+
+static inline void UARTEnable(uint32_t base)
+{
+  UARTFIFOEnable(base);
+  sim_hwreg_write(base + UART_O_CTL, HWREG(base + UART_O_CTL) |
+                  UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE);
+}
+
+static inline void UARTDisable(uint32_t base)
+{
+  while (HWREG(base + UART_O_FR) & UART_FR_BUSY) {
+    sim_idle();
+  }
+  UARTFIFODisable(base);
+  sim_hwreg_write(base + UART_O_CTL, HWREG(base + UART_O_CTL) &
+                  ~(UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE));
+}
+
+static inline void UARTConfigSetExpClk(uint32_t base, uint32_t clk,
+                                       uint32_t baud, uint32_t config)
+{
+  UARTDisable(base);
+
+  uint32_t div = (((clk * 8) / baud) + 1) / 2;
+  sim_hwreg_write(base + UART_O_IBRD, div / 64);
+  sim_hwreg_write(base + UART_O_FBRD, div % 64);
+  sim_hwreg_write(base + UART_O_LCRH, config);
+}
+
+static inline bool UARTCharsAvail(uint32_t base)
+{
+  return !(HWREG(base + UART_O_FR) & UART_FR_RXFE);
+}
+
+static inline bool UARTSpaceAvail(uint32_t base)
+{
+  return !(HWREG(base + UART_O_FR) & UART_FR_TXFF);
+}
+
+static inline int32_t UARTCharGetNonBlocking(uint32_t base)
+{
+  if (!(HWREG(base + UART_O_FR) & UART_FR_RXFE)) {
+    return HWREG(base + UART_O_DR);
+  }
+  return -1;
+}
+
+static inline int32_t UARTCharGet(uint32_t base)
+{
+  while (HWREG(base + UART_O_FR) & UART_FR_RXFE) {
+    sim_idle();
+  }
+  return HWREG(base + UART_O_DR);
+}
+
+static inline bool UARTCharPutNonBlocking(uint32_t base, uint8_t data)
+{
+  if (!(HWREG(base + UART_O_FR) & UART_FR_TXFF)) {
+    sim_hwreg_write(base + UART_O_DR, data);
+    return true;
+  }
+  return false;
+}
+
+static inline void UARTCharPut(uint32_t base, uint8_t data)
+{
+  while (HWREG(base + UART_O_FR) & UART_FR_TXFF) {
+    sim_idle();
+  }
+  sim_hwreg_write(base + UART_O_DR, data);
+}
+
+static inline bool UARTBusy(uint32_t base)
+{
+  return HWREG(base + UART_O_FR) & UART_FR_BUSY;
+}
+
+static inline void UARTIntRegister(uint32_t base, void (*handler)(void))
+{
+  uint32_t irq = (base == UART0_BASE) ? INT_UART0_COMB : INT_UART1_COMB;
+  IntRegister(irq, handler);
+  IntEnable(irq);
+}
+
+static inline void UARTIntUnregister(uint32_t base)
+{
+  uint32_t irq = (base == UART0_BASE) ? INT_UART0_COMB : INT_UART1_COMB;
+  IntDisable(irq);
+  IntUnregister(irq);
+}
+
+static inline void UARTIntEnable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + UART_O_IMSC, HWREG(base + UART_O_IMSC) | flags);
+}
+
+static inline void UARTIntDisable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + UART_O_IMSC, HWREG(base + UART_O_IMSC) & ~flags);
+}
+
+static inline uint32_t UARTIntStatus(uint32_t base, bool masked)
+{
+  return HWREG(base + (masked ? UART_O_MIS : UART_O_RIS));
+}
+
+static inline void UARTIntClear(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + UART_O_ICR, flags);
+}
+
+static inline void UARTDMAEnable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + UART_O_DMACTL, HWREG(base + UART_O_DMACTL) | flags);
+}
+
+static inline void UARTDMADisable(uint32_t base, uint32_t flags)
+{
+  sim_hwreg_write(base + UART_O_DMACTL, HWREG(base + UART_O_DMACTL) & ~flags);
+}
+
+static inline uint32_t UARTRxErrorGet(uint32_t base)
+{
+  return HWREG(base + UART_O_RSR) & 0x0000000F;
+}
+
+static inline void UARTRxErrorClear(uint32_t base)
+{
+  sim_hwreg_write(base + UART_O_ECR, 0);
+}
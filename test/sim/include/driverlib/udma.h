@@ -0,0 +1,155 @@
+#pragma once
+
+// Host replacement for driverlib/udma.h: the control table
+// holds host pointers (see sim/sim_udma.c)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <inc/hw_types.h>
+#include <inc/hw_ints.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_udma.h>
+
+#include "debug.h"
+#include "interrupt.h"
+
+typedef struct {
+  volatile void* pvSrcEndAddr;
+  volatile void* pvDstEndAddr;
+  volatile uint32_t ui32Control;
+  volatile uint32_t ui32Spare;
+} tDMAControlTable;
+
+#define UDMA_ATTR_USEBURST       0x00000001
+#define UDMA_ATTR_ALTSELECT      0x00000002
+#define UDMA_ATTR_HIGH_PRIORITY  0x00000004
+#define UDMA_ATTR_REQMASK        0x00000008
+#define UDMA_ATTR_ALL            0x0000000F
+
+#define UDMA_MODE_STOP                0x00000000
+#define UDMA_MODE_BASIC               0x00000001
+#define UDMA_MODE_AUTO                0x00000002
+#define UDMA_MODE_PINGPONG            0x00000003
+#define UDMA_MODE_MEM_SCATTER_GATHER  0x00000004
+#define UDMA_MODE_PER_SCATTER_GATHER  0x00000006
+#define UDMA_MODE_M                   0x00000007
+#define UDMA_MODE_ALT_SELECT          0x00000001
+
+#define UDMA_DST_INC_8     0x00000000
+#define UDMA_DST_INC_16    0x40000000
+#define UDMA_DST_INC_32    0x80000000
+#define UDMA_DST_INC_NONE  0xC0000000
+#define UDMA_DST_INC_M     0xC0000000
+#define UDMA_DST_INC_S     30
+#define UDMA_SRC_INC_8     0x00000000
+#define UDMA_SRC_INC_16    0x04000000
+#define UDMA_SRC_INC_32    0x08000000
+#define UDMA_SRC_INC_NONE  0x0c000000
+#define UDMA_SRC_INC_M     0x0C000000
+#define UDMA_SRC_INC_S     26
+#define UDMA_SIZE_8        0x00000000
+#define UDMA_SIZE_16       0x11000000
+#define UDMA_SIZE_32       0x22000000
+#define UDMA_SIZE_M        0x33000000
+#define UDMA_ARB_1         0x00000000
+#define UDMA_ARB_2         0x00004000
+#define UDMA_ARB_4         0x00008000
+#define UDMA_ARB_8         0x0000c000
+#define UDMA_ARB_16        0x00010000
+#define UDMA_ARB_32        0x00014000
+#define UDMA_ARB_64        0x00018000
+#define UDMA_ARB_128       0x0001c000
+#define UDMA_ARB_256       0x00020000
+#define UDMA_ARB_512       0x00024000
+#define UDMA_ARB_1024      0x00028000
+#define UDMA_ARB_M         0x0003C000
+#define UDMA_ARB_S         14
+#define UDMA_NEXT_USEBURST 0x00000008
+#define UDMA_XFER_SIZE_MAX 1024
+#define UDMA_XFER_SIZE_M   0x00003FF0
+#define UDMA_XFER_SIZE_S   4
+
+#define UDMA_PRI_SELECT  0x00000000
+#define UDMA_ALT_SELECT  0x00000020
+
+#define UDMA_CHAN_SW_EVT0   0
+#define UDMA_CHAN_UART0_RX  1
+#define UDMA_CHAN_UART0_TX  2
+#define UDMA_CHAN_SSI0_RX   3
+#define UDMA_CHAN_SSI0_TX   4
+#define UDMA_CHAN_UART1_RX  5
+#define UDMA_CHAN_UART1_TX  6
+#define UDMA_CHAN_SSI1_RX   16
+#define UDMA_CHAN_SSI1_TX   17
+
+#define UDMA_NUM_CHANNELS  32
+
+static inline void uDMAEnable(uint32_t base)
+{
+  sim_hwreg_write(base + UDMA_O_CFG, UDMA_CFG_MASTERENABLE);
+}
+
+static inline void uDMADisable(uint32_t base)
+{
+  sim_hwreg_write(base + UDMA_O_CFG, 0);
+}
+
+static inline uint32_t uDMAErrorStatusGet(uint32_t base)
+{
+  return HWREG(base + UDMA_O_ERROR);
+}
+
+static inline void uDMAErrorStatusClear(uint32_t base)
+{
+  sim_hwreg_write(base + UDMA_O_ERROR, UDMA_ERROR_STATUS);
+}
+
+static inline void uDMAChannelEnable(uint32_t base, uint32_t channel)
+{
+  sim_hwreg_write(base + UDMA_O_SETCHANNELEN, 1u << channel);
+}
+
+static inline void uDMAChannelDisable(uint32_t base, uint32_t channel)
+{
+  sim_hwreg_write(base + UDMA_O_CLEARCHANNELEN, 1u << channel);
+}
+
+static inline bool uDMAChannelIsEnabled(uint32_t base, uint32_t channel)
+{
+  return HWREG(base + UDMA_O_SETCHANNELEN) & (1u << channel);
+}
+
+static inline uint32_t uDMAIntStatus(uint32_t base)
+{
+  return HWREG(base + UDMA_O_REQDONE);
+}
+
+static inline void uDMAIntClear(uint32_t base, uint32_t mask)
+{
+  sim_hwreg_write(base + UDMA_O_REQDONE, mask);
+}
+
+// Host pointers do not fit in the CTRL register:
+// the table is handed over to the simulator
+void uDMAControlBaseSet(uint32_t base, void* table);
+void* uDMAControlBaseGet(uint32_t base);
+
+void uDMAChannelAttributeEnable(uint32_t base, uint32_t channel,
+                                uint32_t attr);
+void uDMAChannelAttributeDisable(uint32_t base, uint32_t channel,
+                                 uint32_t attr);
+void uDMAChannelControlSet(uint32_t base, uint32_t channel_struct,
+                           uint32_t control);
+void uDMAChannelTransferSet(uint32_t base, uint32_t channel_struct,
+                            uint32_t mode, void* src, void* dst,
+                            uint32_t size);
+
+// Host task structures are larger than 4 words: the primary
+// structure points at the last task, its size is still 4 words
+// per task (see sim/sim_udma.c)
+void uDMAChannelScatterGatherSet(uint32_t base, uint32_t channel,
+                                 uint32_t task_count, void* task_list,
+                                 uint32_t periph_sg);
+uint32_t uDMAChannelSizeGet(uint32_t base, uint32_t channel_struct);
+uint32_t uDMAChannelModeGet(uint32_t base, uint32_t channel_struct);
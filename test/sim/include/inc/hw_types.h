@@ -0,0 +1,14 @@
+#pragma once
+
+// Host replacement for driverlib's inc/hw_types.h:
+// register reads go through the simulator (writes are
+// rewritten into sim_hwreg_write() calls)
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sim_hw.h>
+
+#define HWREG(x) sim_hwreg_read(x)
+
+#define __STATIC_INLINE static inline
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+// Peripheral register accesses of the firmware sources
+// (rewritten by sim/rewrite.py): each one takes some time,
+// pending IRQs are served right after it
+uint32_t sim_hwreg_read(uint32_t addr);
+void sim_hwreg_write(uint32_t addr, uint32_t value);
+
+// Busy-wait loop body: move time to the next event
+void sim_idle();
@@ -0,0 +1,134 @@
+"""
+Rewrite a firmware source file for the host simulator.
+
+  rewrite.py <source.c> <output.c>
+
+Register accesses go through the simulator (see sim/include/sim_hw.h):
+  - 'HWREG(addr) = value;'  ->  'sim_hwreg_write(addr, value);'
+  - 'HWREG(addr) |= value;' ->  'sim_hwreg_write(addr, sim_hwreg_read(addr) | (value));'
+  - 'HWREG(addr)' elsewhere is a read (macro in sim/include/inc/hw_types.h)
+
+Empty busy-wait loops ('while (...) {}') give the simulator a chance
+to move time forward: their body becomes '{ sim_idle(); }'.
+
+Line numbers are kept: diagnostics point to the original file.
+"""
+
+import re
+import sys
+
+HWREG = re.compile(r"\bHWREG\s*\(")
+WHILE = re.compile(r"\bwhile\s*\(")
+EMPTY_BODY = re.compile(r"\{(?:\s|\\\n)*\}")
+COMPOUND = re.compile(r"(\|=|&=|\^=|\+=|-=)")
+
+
+def match_paren(text, pos):
+    """Index right after the parenthesis closing the one at 'pos'."""
+    depth = 0
+    for i in range(pos, len(text)):
+        if text[i] == "(":
+            depth += 1
+        elif text[i] == ")":
+            depth -= 1
+            if depth == 0:
+                return i + 1
+    raise ValueError("unbalanced parenthesis at offset %d" % pos)
+
+
+def statement_end(text, pos):
+    """Index of the ';' ending the expression starting at 'pos'."""
+    depth = 0
+    for i in range(pos, len(text)):
+        c = text[i]
+        if c in "([{":
+            depth += 1
+        elif c in ")]}":
+            depth -= 1
+        elif c == ";" and depth == 0:
+            return i
+    raise ValueError("unterminated statement at offset %d" % pos)
+
+
+def skip_blanks(text, pos):
+    while pos < len(text):
+        if text[pos] in " \t":
+            pos += 1
+        elif text.startswith("\\\n", pos):
+            pos += 2
+        else:
+            break
+    return pos
+
+
+def rewrite_writes(text):
+    out = []
+    pos = 0
+    while True:
+        m = HWREG.search(text, pos)
+        if not m:
+            break
+        args_end = match_paren(text, m.end() - 1)
+        addr = text[m.end():args_end - 1]
+        op_pos = skip_blanks(text, args_end)
+
+        compound = COMPOUND.match(text, op_pos)
+        assign = text.startswith("=", op_pos) and not text.startswith("==", op_pos)
+        if not (assign or compound):
+            # read: left to the HWREG() macro (addr may hold more accesses)
+            out.append(text[pos:m.end()])
+            pos = m.end()
+            continue
+
+        op_len = len(compound.group(1)) if compound else 1
+        end = statement_end(text, op_pos + op_len)
+        value = rewrite_writes(text[op_pos + op_len:end])
+        addr = rewrite_writes(addr)
+
+        out.append(text[pos:m.start()])
+        if compound:
+            op = compound.group(1)[0]
+            out.append("sim_hwreg_write(%s, sim_hwreg_read(%s) %s (%s))"
+                       % (addr, addr, op, value))
+        else:
+            out.append("sim_hwreg_write(%s,%s)" % (addr, value))
+        pos = end
+    out.append(text[pos:])
+    return "".join(out)
+
+
+def rewrite_spins(text):
+    out = []
+    pos = 0
+    while True:
+        m = WHILE.search(text, pos)
+        if not m:
+            break
+        cond_end = match_paren(text, m.end() - 1)
+        body = EMPTY_BODY.match(text, skip_blanks(text, cond_end))
+        out.append(text[pos:cond_end])
+        pos = cond_end
+        if body:
+            # keep the line count of the original body
+            newlines = body.group(0).count("\n")
+            out.append(" { sim_idle(); " + "\\\n" * newlines + "}")
+            pos = body.end()
+    out.append(text[pos:])
+    return "".join(out)
+
+
+def main():
+    src, dst = sys.argv[1], sys.argv[2]
+    with open(src) as f:
+        text = f.read()
+
+    text = rewrite_spins(rewrite_writes(text))
+
+    with open(dst, "w") as f:
+        f.write("#include <sim_hw.h>\n")
+        f.write('#line 1 "%s"\n' % src)
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
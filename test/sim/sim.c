@@ -0,0 +1,356 @@
+#include <driverlib/cpu.h>
+#include <driverlib/interrupt.h>
+#include <driverlib/prcm.h>
+#include <driverlib/sys_ctrl.h>
+#include <inc/hw_memmap.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+#include "timer.h"
+
+#define MAX_IRQS 64
+
+// Same IRQ taken over and over without returning to thread mode
+#define IRQ_STORM_LIMIT 100000
+
+// Exception entry and exit (12 cycles each)
+#define IRQ_ENTRY_NS 500
+
+#define SYS_CLOCK 48000000
+
+uint64_t sim_now;
+uint64_t sim_accesses;
+
+static uint64_t _deadline = SIM_MS(60000);
+
+typedef struct {
+  void (*handler)(void);
+  bool enabled;
+} irq_vector_t;
+
+static irq_vector_t _vectors[MAX_IRQS];
+static uint32_t _primask;
+static bool _in_irq;
+
+void sim_fail(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "sim: [%llu ns] ", (unsigned long long)sim_now);
+  vfprintf(stderr, fmt, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  abort();
+}
+
+void sim_set_deadline(uint64_t t)
+{
+  _deadline = t;
+}
+
+//
+// Timer (timer.h)
+//
+
+static void (*_tick_callback)();
+static uint64_t _next_tick = SIM_MS(1);
+static bool _tick_pending;
+
+static uint64_t _timer_next()
+{
+  return _tick_callback ? _next_tick : SIM_NEVER;
+}
+
+static void _timer_run()
+{
+  if (!_tick_callback) return;
+  while (_next_tick <= sim_now) {
+    _tick_pending = true;
+    _next_tick += SIM_MS(1);
+  }
+}
+
+static void _timer_irq()
+{
+  _tick_pending = false;
+  if (_tick_callback) _tick_callback();
+}
+
+void timer_init() {}
+
+uint32_t millis() { return sim_now / SIM_MS(1); }
+
+uint32_t micros() { return sim_now / SIM_US(1); }
+
+uint32_t get_ticks() { return sim_now * (SYS_CLOCK / 1000000) / 1000; }
+
+void timer_set_tick_callback(void (*callback)())
+{
+  _next_tick = (sim_now / SIM_MS(1) + 1) * SIM_MS(1);
+  _tick_callback = callback;
+  IntRegister(INT_GPT0A, _timer_irq);
+  IntEnable(INT_GPT0A);
+}
+
+//
+// Events
+//
+
+static uint64_t _next_event()
+{
+  uint64_t t = sim_uart_next();
+  uint64_t ssi = sim_ssi_next();
+  uint64_t timer = _timer_next();
+  if (ssi < t) t = ssi;
+  if (timer < t) t = timer;
+  return t;
+}
+
+static void _run_models()
+{
+  sim_uart_run();
+  sim_ssi_run();
+  _timer_run();
+  sim_udma_service();
+}
+
+// Process all events up to 't', in order
+static void _advance(uint64_t t)
+{
+  if (t > _deadline) {
+    sim_fail("deadline reached (busy-waiting forever?)");
+  }
+
+  while (true) {
+    uint64_t next = _next_event();
+    if (next > t) break;
+    if (next > sim_now) sim_now = next;
+    _run_models();
+  }
+  sim_now = t;
+  _run_models();
+}
+
+static bool _irq_line(uint32_t irq)
+{
+  switch (irq) {
+  case INT_UART0_COMB: return sim_uart_irq(0);
+  case INT_UART1_COMB: return sim_uart_irq(1);
+  case INT_SSI0_COMB: return sim_ssi_irq(0);
+  case INT_SSI1_COMB: return sim_ssi_irq(1);
+  case INT_GPT0A: return _tick_pending;
+  default: return false;
+  }
+}
+
+static int _pending_irq()
+{
+  for (uint32_t irq = 0; irq < MAX_IRQS; irq++) {
+    irq_vector_t* vec = &_vectors[irq];
+    if (vec->enabled && vec->handler && _irq_line(irq)) return irq;
+  }
+  return -1;
+}
+
+static void _dispatch()
+{
+  if (_primask || _in_irq) return;
+
+  uint32_t taken = 0;
+  int irq;
+  while ((irq = _pending_irq()) >= 0) {
+    if (++taken > IRQ_STORM_LIMIT) {
+      sim_fail("IRQ %d stuck (not cleared by its handler)", irq);
+    }
+    _in_irq = true;
+    _advance(sim_now + IRQ_ENTRY_NS);
+    _vectors[irq].handler();
+    _in_irq = false;
+  }
+}
+
+static void _idle_until(uint64_t t)
+{
+  uint64_t next = _next_event();
+  if (next > t) next = t;
+  if (next <= sim_now) next = sim_now + 1;
+  _advance(next);
+  _dispatch();
+}
+
+void sim_idle()
+{
+  uint64_t next = _next_event();
+  if (next == SIM_NEVER) {
+    sim_fail("idle with no event pending (deadlock)");
+  }
+  _idle_until(next);
+}
+
+void sim_run_until(uint64_t t)
+{
+  while (sim_now < t) _idle_until(t);
+}
+
+void sim_run(uint64_t ns)
+{
+  sim_run_until(sim_now + ns);
+}
+
+//
+// Register accesses
+//
+
+#define PERIPH_SIZE 0x1000
+
+static bool _in(uint32_t addr, uint32_t base)
+{
+  return addr >= base && addr < base + PERIPH_SIZE;
+}
+
+uint32_t sim_periph_read(uint32_t addr, uint32_t size)
+{
+  uint32_t value;
+  if (_in(addr, UART0_BASE)) {
+    value = sim_uart_read(0, addr - UART0_BASE);
+  } else if (_in(addr, UART1_BASE)) {
+    value = sim_uart_read(1, addr - UART1_BASE);
+  } else if (_in(addr, SSI0_BASE)) {
+    value = sim_ssi_read(0, addr - SSI0_BASE);
+  } else if (_in(addr, SSI1_BASE)) {
+    value = sim_ssi_read(1, addr - SSI1_BASE);
+  } else if (_in(addr, UDMA0_BASE)) {
+    value = sim_udma_read(addr - UDMA0_BASE);
+  } else if (_in(addr, GPIO_BASE)) {
+    value = sim_gpio_read(addr - GPIO_BASE);
+  } else {
+    sim_fail("read from unmapped register 0x%08x", addr);
+  }
+
+  if (size < 4) value &= (1u << (size * 8)) - 1;
+  return value;
+}
+
+void sim_periph_write(uint32_t addr, uint32_t value, uint32_t size)
+{
+  if (size < 4) value &= (1u << (size * 8)) - 1;
+
+  if (_in(addr, UART0_BASE)) {
+    sim_uart_write(0, addr - UART0_BASE, value);
+  } else if (_in(addr, UART1_BASE)) {
+    sim_uart_write(1, addr - UART1_BASE, value);
+  } else if (_in(addr, SSI0_BASE)) {
+    sim_ssi_write(0, addr - SSI0_BASE, value);
+  } else if (_in(addr, SSI1_BASE)) {
+    sim_ssi_write(1, addr - SSI1_BASE, value);
+  } else if (_in(addr, UDMA0_BASE)) {
+    sim_udma_write(addr - UDMA0_BASE, value);
+  } else if (_in(addr, GPIO_BASE)) {
+    sim_gpio_write(addr - GPIO_BASE, value);
+  } else {
+    sim_fail("write to unmapped register 0x%08x", addr);
+  }
+}
+
+static void _access()
+{
+  sim_accesses++;
+  _advance(sim_now + SIM_ACCESS_NS);
+}
+
+uint32_t sim_hwreg_read(uint32_t addr)
+{
+  _access();
+  uint32_t value = sim_periph_read(addr, 4);
+  sim_udma_service();
+  _dispatch();
+  return value;
+}
+
+void sim_hwreg_write(uint32_t addr, uint32_t value)
+{
+  _access();
+  sim_periph_write(addr, value, 4);
+  sim_udma_service();
+  _dispatch();
+}
+
+//
+// NVIC / CPU
+//
+
+void IntRegister(uint32_t interrupt, void (*handler)(void))
+{
+  if (interrupt >= MAX_IRQS) sim_fail("bad IRQ number %u", interrupt);
+  _vectors[interrupt].handler = handler;
+}
+
+void IntUnregister(uint32_t interrupt)
+{
+  _vectors[interrupt].handler = 0;
+}
+
+void IntEnable(uint32_t interrupt)
+{
+  _vectors[interrupt].enabled = true;
+  _dispatch();
+}
+
+void IntDisable(uint32_t interrupt)
+{
+  _vectors[interrupt].enabled = false;
+}
+
+uint32_t CPUcpsid()
+{
+  uint32_t primask = _primask;
+  _primask = 1;
+  return primask;
+}
+
+uint32_t CPUcpsie()
+{
+  uint32_t primask = _primask;
+  _primask = 0;
+  _dispatch();
+  return primask;
+}
+
+bool IntMasterEnable() { return CPUcpsie(); }
+
+bool IntMasterDisable() { return CPUcpsid(); }
+
+void CPUwfi()
+{
+  sim_idle();
+}
+
+void CPUdelay(uint32_t count)
+{
+  uint64_t end = sim_now + (uint64_t)count * 3 * 1000000000 / SYS_CLOCK;
+  while (sim_now < end) _idle_until(end);
+}
+
+void delay_us(uint32_t us)
+{
+  sim_run(SIM_US(us));
+}
+
+void sleep_us(uint32_t us)
+{
+  sim_run(SIM_US(us));
+}
+
+//
+// Power & clocks
+//
+
+void PRCMPeripheralRunEnable(uint32_t peripheral) {}
+void PRCMPeripheralRunDisable(uint32_t peripheral) {}
+void PRCMLoadSet() {}
+bool PRCMLoadGet() { return true; }
+
+uint32_t SysCtrlClockGet() { return SYS_CLOCK; }
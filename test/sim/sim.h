@@ -0,0 +1,126 @@
+#pragma once
+
+// Host simulator of the CC26x2 peripherals used by the drivers:
+//  - UART0/1, SSI0/1, uDMA, GPIO outputs, IRQs and timer.h
+//  - time is simulated (ns): each register access takes SIM_ACCESS_NS,
+//    code between accesses takes no time
+//  - peripherals run on events (bytes shifted in and out, ...),
+//    DMA transfers take no time
+//  - IRQs are served right after a register access (or PRIMASK
+//    being cleared), lowest number first, without nesting
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <sim_hw.h>
+
+// 2 CPU cycles at 48 MHz
+#define SIM_ACCESS_NS 42
+
+#define SIM_NEVER UINT64_MAX
+
+#define SIM_MS(ms) ((uint64_t)(ms) * 1000000)
+#define SIM_US(us) ((uint64_t)(us) * 1000)
+
+// Current time (ns)
+extern uint64_t sim_now;
+
+// Register accesses so far
+extern uint64_t sim_accesses;
+
+// Idles until 't' (IRQs are served)
+void sim_run_until(uint64_t t);
+void sim_run(uint64_t ns);
+
+// Aborts when reached (default: 60 s), busy-waits never end otherwise
+void sim_set_deadline(uint64_t t);
+
+// Fatal error: message and abort()
+void sim_fail(const char* fmt, ...)
+  __attribute__((format(printf, 1, 2), noreturn));
+
+//
+// UART
+//
+
+// Line from 'from' TX to 'to' RX (same baud rate expected)
+void sim_uart_connect(int from, int to);
+
+// Bytes sent to 'uart' RX, back-to-back after those already queued
+// (the UART must be configured: its baud rate is used)
+void sim_uart_send(int uart, const void* data, size_t len);
+
+// Line idle for 'ns' before the next byte queued
+void sim_uart_send_gap(int uart, uint64_t ns);
+
+// Time the last byte queued ends
+uint64_t sim_uart_send_end(int uart);
+
+// Bytes sent by 'uart' TX when not connected (capture buffer)
+const uint8_t* sim_uart_sent(int uart, size_t* len);
+// Time the i-th byte captured ended (stop bit)
+uint64_t sim_uart_sent_time(int uart, size_t i);
+void sim_uart_sent_clear(int uart);
+
+// Bytes lost: RX FIFO full, TX FIFO written while full
+uint32_t sim_uart_overruns(int uart);
+uint32_t sim_uart_tx_dropped(int uart);
+
+// Time one character takes on the line
+uint64_t sim_uart_char_ns(int uart);
+
+//
+// SSI
+//
+
+// Device on the bus: gets each frame sent, returns the frame received
+typedef uint32_t (*sim_ssi_device_t)(void* ctx, uint32_t tx, uint32_t bits);
+void sim_ssi_attach(int ssi, sim_ssi_device_t device, void* ctx);
+
+uint32_t sim_ssi_overruns(int ssi);
+
+//
+// GPIO / IOC
+//
+
+// Output level changes (e.g. chip select)
+typedef void (*sim_gpio_listener_t)(void* ctx, uint32_t dio, bool level);
+void sim_gpio_listen(sim_gpio_listener_t listener, void* ctx);
+bool sim_gpio_get(uint32_t dio);
+
+// Port and configuration set by IOCPortConfigureSet()
+uint32_t sim_ioc_port(uint32_t dio);
+uint32_t sim_ioc_config(uint32_t dio);
+
+//
+// Peripheral models (sim internals)
+//
+
+// Register access from the uDMA (no time taken)
+uint32_t sim_periph_read(uint32_t addr, uint32_t size);
+void sim_periph_write(uint32_t addr, uint32_t value, uint32_t size);
+
+// Next event (SIM_NEVER if none) / process what is due at sim_now
+uint64_t sim_uart_next();
+void sim_uart_run();
+bool sim_uart_irq(int uart);
+uint32_t sim_uart_read(int uart, uint32_t offset);
+void sim_uart_write(int uart, uint32_t offset, uint32_t value);
+bool sim_uart_dma_request(int uart, bool tx, bool burst);
+
+uint64_t sim_ssi_next();
+void sim_ssi_run();
+bool sim_ssi_irq(int ssi);
+uint32_t sim_ssi_read(int ssi, uint32_t offset);
+void sim_ssi_write(int ssi, uint32_t offset, uint32_t value);
+bool sim_ssi_dma_request(int ssi, bool tx, bool burst);
+
+uint32_t sim_gpio_read(uint32_t offset);
+void sim_gpio_write(uint32_t offset, uint32_t value);
+
+// Serves DMA requests until none is left
+void sim_udma_service();
+uint32_t sim_udma_read(uint32_t offset);
+void sim_udma_write(uint32_t offset, uint32_t value);
+uint32_t sim_udma_done();
@@ -0,0 +1,132 @@
+#include <driverlib/gpio.h>
+#include <driverlib/ioc.h>
+#include <inc/hw_gpio.h>
+
+#include "sim.h"
+
+// GPIO outputs (DIN reads back DOUT) and IOC pin muxing
+
+#define MAX_DIO 32
+
+static uint32_t _dout;
+static sim_gpio_listener_t _listener;
+static void* _listener_ctx;
+
+typedef struct {
+  uint32_t port;
+  uint32_t config;
+} ioc_pin_t;
+
+static ioc_pin_t _pins[MAX_DIO];
+
+static void _set_dout(uint32_t dout)
+{
+  uint32_t changed = _dout ^ dout;
+  _dout = dout;
+
+  while (changed && _listener) {
+    uint32_t dio = __builtin_ctz(changed);
+    changed &= changed - 1;
+    _listener(_listener_ctx, dio, (dout >> dio) & 1);
+  }
+}
+
+uint32_t sim_gpio_read(uint32_t offset)
+{
+  switch (offset) {
+  case GPIO_O_DOUT31_0:
+  case GPIO_O_DIN31_0:
+    return _dout;
+  default:
+    sim_fail("GPIO: read from offset 0x%02x", offset);
+  }
+}
+
+void sim_gpio_write(uint32_t offset, uint32_t value)
+{
+  switch (offset) {
+  case GPIO_O_DOUT31_0: _set_dout(value); break;
+  case GPIO_O_DOUTSET31_0: _set_dout(_dout | value); break;
+  case GPIO_O_DOUTCLR31_0: _set_dout(_dout & ~value); break;
+  case GPIO_O_DOUTTGL31_0: _set_dout(_dout ^ value); break;
+  default:
+    sim_fail("GPIO: write to offset 0x%02x", offset);
+  }
+}
+
+void sim_gpio_listen(sim_gpio_listener_t listener, void* ctx)
+{
+  _listener = listener;
+  _listener_ctx = ctx;
+}
+
+bool sim_gpio_get(uint32_t dio)
+{
+  return (_dout >> dio) & 1;
+}
+
+//
+// IOC
+//
+
+void IOCPortConfigureSet(uint32_t ioid, uint32_t port, uint32_t config)
+{
+  if (ioid >= MAX_DIO) sim_fail("IOC: bad IO id %u", ioid);
+  _pins[ioid] = (ioc_pin_t){port, config};
+}
+
+void IOCPinTypeGpioInput(uint32_t ioid)
+{
+  IOCPortConfigureSet(ioid, IOC_PORT_GPIO, IOC_STD_INPUT);
+}
+
+void IOCPinTypeGpioOutput(uint32_t ioid)
+{
+  IOCPortConfigureSet(ioid, IOC_PORT_GPIO, IOC_STD_OUTPUT);
+}
+
+void IOCPinTypeUart(uint32_t base, uint32_t rx, uint32_t tx, uint32_t cts,
+                    uint32_t rts)
+{
+  bool uart0 = (base == UART0_BASE);
+  if (rx != IOID_UNUSED)
+    IOCPortConfigureSet(rx, uart0 ? IOC_PORT_MCU_UART0_RX : IOC_PORT_MCU_UART1_RX,
+                        IOC_STD_INPUT);
+  if (tx != IOID_UNUSED)
+    IOCPortConfigureSet(tx, uart0 ? IOC_PORT_MCU_UART0_TX : IOC_PORT_MCU_UART1_TX,
+                        IOC_STD_OUTPUT);
+  if (cts != IOID_UNUSED)
+    IOCPortConfigureSet(cts, uart0 ? IOC_PORT_MCU_UART0_CTS : IOC_PORT_MCU_UART1_CTS,
+                        IOC_STD_INPUT);
+  if (rts != IOID_UNUSED)
+    IOCPortConfigureSet(rts, uart0 ? IOC_PORT_MCU_UART0_RTS : IOC_PORT_MCU_UART1_RTS,
+                        IOC_STD_OUTPUT);
+}
+
+void IOCPinTypeSsiMaster(uint32_t base, uint32_t rx, uint32_t tx,
+                         uint32_t fss, uint32_t clk)
+{
+  bool ssi0 = (base == SSI0_BASE);
+  if (rx != IOID_UNUSED)
+    IOCPortConfigureSet(rx, ssi0 ? IOC_PORT_MCU_SSI0_RX : IOC_PORT_MCU_SSI1_RX,
+                        IOC_STD_INPUT);
+  if (tx != IOID_UNUSED)
+    IOCPortConfigureSet(tx, ssi0 ? IOC_PORT_MCU_SSI0_TX : IOC_PORT_MCU_SSI1_TX,
+                        IOC_STD_OUTPUT);
+  if (fss != IOID_UNUSED)
+    IOCPortConfigureSet(fss, ssi0 ? IOC_PORT_MCU_SSI0_FSS : IOC_PORT_MCU_SSI1_FSS,
+                        IOC_STD_OUTPUT);
+  if (clk != IOID_UNUSED)
+    IOCPortConfigureSet(clk, ssi0 ? IOC_PORT_MCU_SSI0_CLK : IOC_PORT_MCU_SSI1_CLK,
+                        IOC_STD_OUTPUT);
+}
+
+uint32_t sim_ioc_port(uint32_t dio)
+{
+  return _pins[dio].port;
+}
+
+uint32_t sim_ioc_config(uint32_t dio)
+{
+  return _pins[dio].config;
+}
@@ -0,0 +1,201 @@
+#include <driverlib/ssi.h>
+#include <driverlib/udma.h>
+
+#include "sim.h"
+
+// SSI master (Motorola formats):
+//  - 8 frames FIFOs, frames timed from CPSR and CR0.SCR
+//  - each frame sent is handed to the attached device,
+//    which returns the frame received (all ones if none)
+//  - DMA requests: single while data / space is available,
+//    burst when the FIFO is half full (RX) / half empty (TX)
+
+#define MAX_SSI 2
+#define FIFO_SIZE 8
+
+typedef struct {
+  uint16_t data[FIFO_SIZE];
+  uint32_t head;
+  uint32_t count;
+} fifo_t;
+
+typedef struct {
+  uint32_t cr0;
+  uint32_t cr1;
+  uint32_t cpsr;
+  uint32_t imsc;
+  uint32_t ris;
+  uint32_t dmacr;
+
+  fifo_t rx;
+  fifo_t tx;
+
+  bool shifting;
+  uint16_t shift;
+  uint64_t shift_end;
+
+  sim_ssi_device_t device;
+  void* ctx;
+  uint32_t overruns;
+} ssi_model_t;
+
+static ssi_model_t _ssi[MAX_SSI];
+
+static const uint8_t _dma_rx[MAX_SSI] = {UDMA_CHAN_SSI0_RX, UDMA_CHAN_SSI1_RX};
+static const uint8_t _dma_tx[MAX_SSI] = {UDMA_CHAN_SSI0_TX, UDMA_CHAN_SSI1_TX};
+
+static ssi_model_t* _get(int ssi)
+{
+  if (ssi < 0 || ssi >= MAX_SSI) sim_fail("bad SSI %d", ssi);
+  return &_ssi[ssi];
+}
+
+static uint32_t _frame_bits(const ssi_model_t* s)
+{
+  return ((s->cr0 & SSI_CR0_DSS_M) >> SSI_CR0_DSS_S) + 1;
+}
+
+// Bit period: CPSR x (SCR + 1) clock periods at 48 MHz
+static uint64_t _frame_ns(const ssi_model_t* s)
+{
+  uint64_t scr = (s->cr0 & SSI_CR0_SCR_M) >> SSI_CR0_SCR_S;
+  if (!s->cpsr) sim_fail("SSI used before its bit rate is set");
+  return _frame_bits(s) * s->cpsr * (scr + 1) * 125 / 6;
+}
+
+static void _push(fifo_t* f, uint16_t data)
+{
+  f->data[(f->head + f->count) % FIFO_SIZE] = data;
+  f->count++;
+}
+
+static uint16_t _pop(fifo_t* f)
+{
+  uint16_t data = f->data[f->head];
+  f->head = (f->head + 1) % FIFO_SIZE;
+  f->count--;
+  return data;
+}
+
+static void _tx_start(ssi_model_t* s, uint64_t t)
+{
+  if (s->shifting || !s->tx.count || !(s->cr1 & SSI_CR1_SSE)) return;
+
+  s->shift = _pop(&s->tx);
+  s->shifting = true;
+  s->shift_end = t + _frame_ns(s);
+}
+
+static void _frame_done(ssi_model_t* s)
+{
+  uint32_t bits = _frame_bits(s);
+  uint32_t mask = (1u << bits) - 1;
+  uint32_t rx = s->device ? s->device(s->ctx, s->shift & mask, bits) : mask;
+
+  if (s->rx.count == FIFO_SIZE) {
+    s->ris |= SSI_RXOR;
+    s->overruns++;
+  } else {
+    _push(&s->rx, rx & mask);
+  }
+}
+
+uint64_t sim_ssi_next()
+{
+  uint64_t next = SIM_NEVER;
+  for (int i = 0; i < MAX_SSI; i++) {
+    if (_ssi[i].shifting && _ssi[i].shift_end < next) next = _ssi[i].shift_end;
+  }
+  return next;
+}
+
+void sim_ssi_run()
+{
+  for (int i = 0; i < MAX_SSI; i++) {
+    ssi_model_t* s = &_ssi[i];
+    if (s->shifting && s->shift_end <= sim_now) {
+      s->shifting = false;
+      _frame_done(s);
+      _tx_start(s, s->shift_end);
+    }
+  }
+}
+
+bool sim_ssi_irq(int ssi)
+{
+  ssi_model_t* s = _get(ssi);
+  uint32_t dma = (1u << _dma_rx[ssi]) | (1u << _dma_tx[ssi]);
+  return (s->ris & s->imsc) || (sim_udma_done() & dma);
+}
+
+bool sim_ssi_dma_request(int ssi, bool tx, bool burst)
+{
+  ssi_model_t* s = _get(ssi);
+  if (tx) {
+    if (!(s->dmacr & SSI_DMACR_TXDMAE)) return false;
+    return burst ? s->tx.count <= FIFO_SIZE / 2 : s->tx.count < FIFO_SIZE;
+  }
+
+  if (!(s->dmacr & SSI_DMACR_RXDMAE)) return false;
+  return burst ? s->rx.count >= FIFO_SIZE / 2 : s->rx.count > 0;
+}
+
+uint32_t sim_ssi_read(int ssi, uint32_t offset)
+{
+  ssi_model_t* s = _get(ssi);
+  switch (offset) {
+  case SSI_O_CR0: return s->cr0;
+  case SSI_O_CR1: return s->cr1;
+  case SSI_O_DR: return s->rx.count ? _pop(&s->rx) : 0;
+  case SSI_O_SR: {
+    uint32_t sr = 0;
+    if (!s->tx.count) sr |= SSI_SR_TFE;
+    if (s->tx.count < FIFO_SIZE) sr |= SSI_SR_TNF;
+    if (s->rx.count) sr |= SSI_SR_RNE;
+    if (s->rx.count == FIFO_SIZE) sr |= SSI_SR_RFF;
+    if (s->shifting || s->tx.count) sr |= SSI_SR_BSY;
+    return sr;
+  }
+  case SSI_O_CPSR: return s->cpsr;
+  case SSI_O_IMSC: return s->imsc;
+  case SSI_O_RIS: return s->ris;
+  case SSI_O_MIS: return s->ris & s->imsc;
+  case SSI_O_DMACR: return s->dmacr;
+  default:
+    sim_fail("SSI%d: read from offset 0x%02x", ssi, offset);
+  }
+}
+
+void sim_ssi_write(int ssi, uint32_t offset, uint32_t value)
+{
+  ssi_model_t* s = _get(ssi);
+  switch (offset) {
+  case SSI_O_CR0: s->cr0 = value; break;
+  case SSI_O_CPSR: s->cpsr = value; break;
+  case SSI_O_IMSC: s->imsc = value; break;
+  case SSI_O_ICR: s->ris &= ~value; break;
+  case SSI_O_DMACR: s->dmacr = value; break;
+  case SSI_O_CR1:
+    s->cr1 = value;
+    _tx_start(s, sim_now);
+    break;
+  case SSI_O_DR:
+    if (s->tx.count < FIFO_SIZE) _push(&s->tx, value);
+    _tx_start(s, sim_now);
+    break;
+  default:
+    sim_fail("SSI%d: write to offset 0x%02x", ssi, offset);
+  }
+}
+
+void sim_ssi_attach(int ssi, sim_ssi_device_t device, void* ctx)
+{
+  ssi_model_t* s = _get(ssi);
+  s->device = device;
+  s->ctx = ctx;
+}
+
+uint32_t sim_ssi_overruns(int ssi)
+{
+  return _get(ssi)->overruns;
+}
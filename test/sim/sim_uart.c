@@ -0,0 +1,421 @@
+#include <driverlib/uart.h>
+#include <driverlib/udma.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+// PL011-like UART:
+//  - 32 bytes FIFOs, characters timed from IBRD/FBRD and LCRH
+//  - RX / TX IRQs on FIFO level crossings, cleared by ICR or
+//    when the level is crossed back
+//  - receive timeout after 32 idle bit periods (FIFO not empty),
+//    cleared by ICR or when the FIFO is emptied
+//  - EOT set when the last character leaves the shifter
+//  - DMA requests: single while data / space is available,
+//    burst when over the FIFO level
+
+#define MAX_UART 2
+#define FIFO_SIZE 32
+
+typedef struct {
+  uint8_t data[FIFO_SIZE];
+  uint32_t head;
+  uint32_t count;
+} fifo_t;
+
+typedef struct {
+  uint8_t* data;
+  uint64_t* time; // arrival (end of stop bit)
+  size_t len;
+  size_t pos;
+  size_t cap;
+  uint64_t end;
+} line_t;
+
+typedef struct {
+  uint32_t ctl;
+  uint32_t lcrh;
+  uint32_t ibrd;
+  uint32_t fbrd;
+  uint32_t ifls;
+  uint32_t imsc;
+  uint32_t ris;
+  uint32_t rsr;
+  uint32_t dmactl;
+
+  fifo_t rx;
+  fifo_t tx;
+  bool rt_armed;
+  uint64_t rx_last;
+
+  bool shifting;
+  uint8_t shift;
+  uint64_t shift_end;
+
+  line_t line; // RX input
+  int peer;    // TX output connected to another UART RX
+  uint8_t* sent;
+  uint64_t* sent_time; // end of stop bit
+  size_t sent_len;
+  size_t sent_cap;
+
+  uint32_t overruns;
+  uint32_t tx_dropped;
+} uart_model_t;
+
+static uart_model_t _uart[MAX_UART] = {{.peer = -1}, {.peer = -1}};
+
+static const uint8_t _dma_rx[MAX_UART] = {UDMA_CHAN_UART0_RX, UDMA_CHAN_UART1_RX};
+static const uint8_t _dma_tx[MAX_UART] = {UDMA_CHAN_UART0_TX, UDMA_CHAN_UART1_TX};
+
+static uart_model_t* _get(int uart)
+{
+  if (uart < 0 || uart >= MAX_UART) sim_fail("bad UART %d", uart);
+  return &_uart[uart];
+}
+
+static void* _grow(void* ptr, size_t* cap, size_t needed, size_t item)
+{
+  if (needed <= *cap) return ptr;
+  size_t cap2 = *cap ? *cap : 256;
+  while (cap2 < needed) cap2 *= 2;
+  ptr = realloc(ptr, cap2 * item);
+  if (!ptr) sim_fail("out of memory");
+  *cap = cap2;
+  return ptr;
+}
+
+static void _line_append(line_t* line, uint8_t data, uint64_t t)
+{
+  size_t cap = line->cap;
+  line->data = _grow(line->data, &cap, line->len + 1, 1);
+  line->time = _grow(line->time, &line->cap, line->len + 1, sizeof(uint64_t));
+  line->data[line->len] = data;
+  line->time[line->len] = t;
+  line->len++;
+  line->end = t;
+}
+
+//
+// Timing
+//
+
+static bool _enabled(const uart_model_t* u)
+{
+  return u->ctl & UART_CTL_UARTEN;
+}
+
+static uint32_t _bits_per_char(const uart_model_t* u)
+{
+  uint32_t bits = 1 + 5 + ((u->lcrh & UART_LCRH_WLEN_M) >> UART_LCRH_WLEN_S);
+  if (u->lcrh & UART_LCRH_PEN) bits++;
+  bits += (u->lcrh & UART_LCRH_STP2) ? 2 : 1;
+  return bits;
+}
+
+// Bit period: 16 x (IBRD + FBRD/64) clock periods at 48 MHz
+static uint64_t _bits_ns(const uart_model_t* u, uint32_t bits)
+{
+  uint64_t div = u->ibrd * 64 + u->fbrd;
+  if (!div) sim_fail("UART used before its baud rate is set");
+  return (uint64_t)bits * div * 125 / 24;
+}
+
+static uint64_t _char_ns(const uart_model_t* u)
+{
+  return _bits_ns(u, _bits_per_char(u));
+}
+
+static uint32_t _tx_level(const uart_model_t* u)
+{
+  static const uint8_t eighths[] = {1, 2, 4, 6, 7};
+  uint32_t sel = u->ifls & UART_IFLS_TXSEL_M;
+  return FIFO_SIZE * eighths[sel > 4 ? 4 : sel] / 8;
+}
+
+static uint32_t _rx_level(const uart_model_t* u)
+{
+  static const uint8_t eighths[] = {1, 2, 4, 6, 7};
+  uint32_t sel = (u->ifls & UART_IFLS_RXSEL_M) >> 3;
+  return FIFO_SIZE * eighths[sel > 4 ? 4 : sel] / 8;
+}
+
+//
+// FIFOs
+//
+
+static void _push(fifo_t* f, uint8_t data)
+{
+  f->data[(f->head + f->count) % FIFO_SIZE] = data;
+  f->count++;
+}
+
+static uint8_t _pop(fifo_t* f)
+{
+  uint8_t data = f->data[f->head];
+  f->head = (f->head + 1) % FIFO_SIZE;
+  f->count--;
+  return data;
+}
+
+static void _rx_char(uart_model_t* u, uint8_t data)
+{
+  if (!_enabled(u) || !(u->ctl & UART_CTL_RXE)) return;
+
+  if (u->rx.count == FIFO_SIZE) {
+    u->ris |= UART_INT_OE;
+    u->rsr |= UART_RXERROR_OVERRUN;
+    u->overruns++;
+    return;
+  }
+
+  _push(&u->rx, data);
+  u->rx_last = sim_now;
+  u->rt_armed = true;
+  if (u->rx.count >= _rx_level(u)) u->ris |= UART_INT_RX;
+}
+
+static uint8_t _rx_read(uart_model_t* u)
+{
+  if (!u->rx.count) return 0;
+
+  uint8_t data = _pop(&u->rx);
+  if (u->rx.count < _rx_level(u)) u->ris &= ~UART_INT_RX;
+  if (!u->rx.count) u->ris &= ~UART_INT_RT;
+  return data;
+}
+
+static void _deliver(int uart, uint8_t data)
+{
+  uart_model_t* u = &_uart[uart];
+  if (u->peer >= 0) {
+    _line_append(&_uart[u->peer].line, data, sim_now);
+    return;
+  }
+
+  size_t cap = u->sent_cap;
+  u->sent = _grow(u->sent, &cap, u->sent_len + 1, 1);
+  u->sent_time = _grow(u->sent_time, &u->sent_cap, u->sent_len + 1,
+                       sizeof(uint64_t));
+  u->sent[u->sent_len] = data;
+  u->sent_time[u->sent_len] = sim_now;
+  u->sent_len++;
+}
+
+// Load the shifter from the FIFO, starting at 't'
+static void _tx_start(uart_model_t* u, uint64_t t)
+{
+  if (u->shifting || !u->tx.count) return;
+  if (!_enabled(u) || !(u->ctl & UART_CTL_TXE)) return;
+
+  u->shift = _pop(&u->tx);
+  u->shifting = true;
+  u->shift_end = t + _char_ns(u);
+  if (u->tx.count == _tx_level(u)) u->ris |= UART_INT_TX;
+}
+
+static void _tx_write(uart_model_t* u, uint8_t data)
+{
+  if (u->tx.count == FIFO_SIZE) {
+    u->tx_dropped++;
+    return;
+  }
+
+  _push(&u->tx, data);
+  if (u->tx.count > _tx_level(u)) u->ris &= ~UART_INT_TX;
+  _tx_start(u, sim_now);
+}
+
+//
+// Events
+//
+
+static uint64_t _rt_time(const uart_model_t* u)
+{
+  if (!u->rx.count || !u->rt_armed) return SIM_NEVER;
+  return u->rx_last + _bits_ns(u, 32);
+}
+
+uint64_t sim_uart_next()
+{
+  uint64_t next = SIM_NEVER;
+  for (int i = 0; i < MAX_UART; i++) {
+    uart_model_t* u = &_uart[i];
+    if (u->line.pos < u->line.len && u->line.time[u->line.pos] < next) {
+      next = u->line.time[u->line.pos];
+    }
+    if (u->shifting && u->shift_end < next) next = u->shift_end;
+    uint64_t rt = _rt_time(u);
+    if (rt < next) next = rt;
+  }
+  return next;
+}
+
+void sim_uart_run()
+{
+  for (int i = 0; i < MAX_UART; i++) {
+    uart_model_t* u = &_uart[i];
+
+    line_t* line = &u->line;
+    while (line->pos < line->len && line->time[line->pos] <= sim_now) {
+      _rx_char(u, line->data[line->pos++]);
+    }
+
+    if (u->shifting && u->shift_end <= sim_now) {
+      u->shifting = false;
+      _deliver(i, u->shift);
+      _tx_start(u, u->shift_end);
+      if (!u->shifting) u->ris |= UART_INT_EOT;
+    }
+
+    if (_rt_time(u) <= sim_now) {
+      u->ris |= UART_INT_RT;
+      u->rt_armed = false;
+    }
+  }
+}
+
+bool sim_uart_irq(int uart)
+{
+  uart_model_t* u = _get(uart);
+  uint32_t dma = (1u << _dma_rx[uart]) | (1u << _dma_tx[uart]);
+  return (u->ris & u->imsc) || (sim_udma_done() & dma);
+}
+
+bool sim_uart_dma_request(int uart, bool tx, bool burst)
+{
+  uart_model_t* u = _get(uart);
+  if (tx) {
+    if (!(u->dmactl & UART_DMA_TX)) return false;
+    return burst ? u->tx.count <= _tx_level(u) : u->tx.count < FIFO_SIZE;
+  }
+
+  if (!(u->dmactl & UART_DMA_RX)) return false;
+  return burst ? u->rx.count >= _rx_level(u) : u->rx.count > 0;
+}
+
+//
+// Registers
+//
+
+uint32_t sim_uart_read(int uart, uint32_t offset)
+{
+  uart_model_t* u = _get(uart);
+  switch (offset) {
+  case UART_O_DR: return _rx_read(u);
+  case UART_O_RSR: return u->rsr;
+  case UART_O_FR: {
+    uint32_t fr = 0;
+    if (!u->rx.count) fr |= UART_FR_RXFE;
+    if (u->rx.count == FIFO_SIZE) fr |= UART_FR_RXFF;
+    if (!u->tx.count) fr |= UART_FR_TXFE;
+    if (u->tx.count == FIFO_SIZE) fr |= UART_FR_TXFF;
+    if (u->shifting || u->tx.count) fr |= UART_FR_BUSY;
+    return fr;
+  }
+  case UART_O_IBRD: return u->ibrd;
+  case UART_O_FBRD: return u->fbrd;
+  case UART_O_LCRH: return u->lcrh;
+  case UART_O_CTL: return u->ctl;
+  case UART_O_IFLS: return u->ifls;
+  case UART_O_IMSC: return u->imsc;
+  case UART_O_RIS: return u->ris;
+  case UART_O_MIS: return u->ris & u->imsc;
+  case UART_O_DMACTL: return u->dmactl;
+  default:
+    sim_fail("UART%d: read from offset 0x%02x", uart, offset);
+  }
+}
+
+void sim_uart_write(int uart, uint32_t offset, uint32_t value)
+{
+  uart_model_t* u = _get(uart);
+  switch (offset) {
+  case UART_O_DR: _tx_write(u, value); break;
+  case UART_O_ECR: u->rsr = 0; break;
+  case UART_O_IBRD: u->ibrd = value; break;
+  case UART_O_FBRD: u->fbrd = value; break;
+  case UART_O_LCRH: u->lcrh = value; break;
+  case UART_O_IFLS: u->ifls = value; break;
+  case UART_O_IMSC: u->imsc = value; break;
+  case UART_O_ICR: u->ris &= ~value; break;
+  case UART_O_DMACTL: u->dmactl = value; break;
+  case UART_O_CTL:
+    u->ctl = value;
+    _tx_start(u, sim_now);
+    break;
+  default:
+    sim_fail("UART%d: write to offset 0x%02x", uart, offset);
+  }
+}
+
+//
+// Test API
+//
+
+void sim_uart_connect(int from, int to)
+{
+  _get(from)->peer = to;
+  _get(to);
+}
+
+void sim_uart_send(int uart, const void* data, size_t len)
+{
+  uart_model_t* u = _get(uart);
+  line_t* line = &u->line;
+  uint64_t char_ns = _char_ns(u);
+
+  uint64_t t = line->end > sim_now ? line->end : sim_now;
+  for (size_t i = 0; i < len; i++) {
+    t += char_ns;
+    _line_append(line, ((const uint8_t*)data)[i], t);
+  }
+}
+
+void sim_uart_send_gap(int uart, uint64_t ns)
+{
+  line_t* line = &_get(uart)->line;
+  uint64_t t = line->end > sim_now ? line->end : sim_now;
+  line->end = t + ns;
+}
+
+uint64_t sim_uart_send_end(int uart)
+{
+  return _get(uart)->line.end;
+}
+
+const uint8_t* sim_uart_sent(int uart, size_t* len)
+{
+  uart_model_t* u = _get(uart);
+  *len = u->sent_len;
+  return u->sent;
+}
+
+uint64_t sim_uart_sent_time(int uart, size_t i)
+{
+  uart_model_t* u = _get(uart);
+  if (i >= u->sent_len) sim_fail("UART%d: byte %zu not sent", uart, i);
+  return u->sent_time[i];
+}
+
+void sim_uart_sent_clear(int uart)
+{
+  _get(uart)->sent_len = 0;
+}
+
+uint32_t sim_uart_overruns(int uart)
+{
+  return _get(uart)->overruns;
+}
+
+uint32_t sim_uart_tx_dropped(int uart)
+{
+  return _get(uart)->tx_dropped;
+}
+
+uint64_t sim_uart_char_ns(int uart)
+{
+  return _char_ns(_get(uart));
+}
@@ -0,0 +1,390 @@
+#include <driverlib/udma.h>
+
+#include <string.h>
+
+#include "sim.h"
+
+// uDMA (PL230-like):
+//  - the control table holds host pointers, addresses in the
+//    peripheral range are register accesses
+//  - channels are served by priority then number, 2^ARB items
+//    per burst request, one item per single request (unless
+//    USEBURST is set)
+//  - a completed structure is back in stop mode with its size
+//    field cleared, and sets the channel REQDONE flag
+//  - ping-pong switches to the other structure, the channel is
+//    disabled if that one is stopped
+//  - peripheral scatter-gather: the primary structure copies
+//    the next task into the alternate one, tasks in alternate
+//    scatter-gather mode return to the primary when done
+
+#define PERIPH_START 0x40000000u
+#define PERIPH_END   0x50000000u
+
+#define MODE_PER_SG_ALT \
+  (UDMA_MODE_PER_SCATTER_GATHER | UDMA_MODE_ALT_SELECT)
+
+static tDMAControlTable* _table;
+static uint32_t _cfg;
+static uint32_t _enabled;
+static uint32_t _prialt;
+static uint32_t _priority;
+static uint32_t _burst;
+static uint32_t _reqmask;
+static uint32_t _done;
+
+static tDMAControlTable* _entry(uint32_t channel_struct)
+{
+  if (!_table) sim_fail("uDMA control table not set");
+  return &_table[channel_struct];
+}
+
+//
+// Channel requests
+//
+
+static bool _request(uint32_t channel, bool burst)
+{
+  switch (channel) {
+  case UDMA_CHAN_UART0_RX: return sim_uart_dma_request(0, false, burst);
+  case UDMA_CHAN_UART0_TX: return sim_uart_dma_request(0, true, burst);
+  case UDMA_CHAN_UART1_RX: return sim_uart_dma_request(1, false, burst);
+  case UDMA_CHAN_UART1_TX: return sim_uart_dma_request(1, true, burst);
+  case UDMA_CHAN_SSI0_RX: return sim_ssi_dma_request(0, false, burst);
+  case UDMA_CHAN_SSI0_TX: return sim_ssi_dma_request(0, true, burst);
+  case UDMA_CHAN_SSI1_RX: return sim_ssi_dma_request(1, false, burst);
+  case UDMA_CHAN_SSI1_TX: return sim_ssi_dma_request(1, true, burst);
+  default: return false;
+  }
+}
+
+// Items to move for the highest priority request (0 if none)
+static uint32_t _arbitrate(uint32_t* channel)
+{
+  uint32_t candidates = _enabled & ~_reqmask;
+  uint32_t groups[2] = {candidates & _priority, candidates & ~_priority};
+
+  for (int g = 0; g < 2; g++) {
+    for (uint32_t mask = groups[g]; mask; mask &= mask - 1) {
+      uint32_t ch = __builtin_ctz(mask);
+      uint32_t alt = (_prialt >> ch) & 1;
+      uint32_t control = _entry(ch | (alt ? UDMA_ALT_SELECT : 0))->ui32Control;
+
+      // peripheral scatter-gather: tasks are fetched without request
+      if (!alt && (control & UDMA_MODE_M) == UDMA_MODE_PER_SCATTER_GATHER) {
+        *channel = ch;
+        return 1;
+      }
+
+      uint32_t arb = 1u << ((control & UDMA_ARB_M) >> UDMA_ARB_S);
+      if (_request(ch, true)) {
+        *channel = ch;
+        return arb;
+      }
+      if (!(_burst & (1u << ch)) && _request(ch, false)) {
+        *channel = ch;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+//
+// Transfers
+//
+
+static bool _is_periph(uintptr_t addr)
+{
+  return addr >= PERIPH_START && addr < PERIPH_END;
+}
+
+static uint32_t _load(uintptr_t addr, uint32_t size)
+{
+  if (_is_periph(addr)) return sim_periph_read(addr, size);
+
+  uint32_t value = 0;
+  memcpy(&value, (const void*)addr, size);
+  return value;
+}
+
+static void _store(uintptr_t addr, uint32_t value, uint32_t size)
+{
+  if (_is_periph(addr)) {
+    sim_periph_write(addr, value, size);
+  } else {
+    memcpy((void*)addr, &value, size);
+  }
+}
+
+static uint32_t _remaining(uint32_t control)
+{
+  return ((control & UDMA_XFER_SIZE_M) >> UDMA_XFER_SIZE_S) + 1;
+}
+
+// Address of the next item, 'left' items before the end
+// (aligned on the item size, as the bus does)
+static uintptr_t _item_addr(volatile void* end, uint32_t inc, uint32_t left)
+{
+  if (inc == 3) return (uintptr_t)end;
+  uintptr_t addr = (uintptr_t)end - ((uintptr_t)(left - 1) << inc);
+  return addr & ~(((uintptr_t)1 << inc) - 1);
+}
+
+static void _complete(uint32_t channel, uint32_t alt, uint32_t mode)
+{
+  uint32_t mask = 1u << channel;
+
+  switch (mode) {
+  case UDMA_MODE_PINGPONG: {
+    _done |= mask;
+    _prialt ^= mask;
+    uint32_t next = channel | (alt ? 0 : UDMA_ALT_SELECT);
+    if (!(_entry(next)->ui32Control & UDMA_MODE_M)) _enabled &= ~mask;
+    break;
+  }
+
+  case MODE_PER_SG_ALT:
+    // back to the primary for the next task
+    _prialt &= ~mask;
+    if (!(_entry(channel)->ui32Control & UDMA_MODE_M)) {
+      _done |= mask;
+      _enabled &= ~mask;
+    }
+    break;
+
+  default:
+    _done |= mask;
+    _enabled &= ~mask;
+    break;
+  }
+}
+
+// Copy the next task into the alternate structure
+static void _fetch_task(uint32_t channel)
+{
+  tDMAControlTable* pri = _entry(channel);
+  tDMAControlTable* alt = _entry(channel | UDMA_ALT_SELECT);
+  uint32_t control = pri->ui32Control;
+  uint32_t words = _remaining(control);
+
+  if (words % 4) sim_fail("DMA ch %u: scatter-gather size not in tasks", channel);
+
+  const tDMAControlTable* task =
+      (const tDMAControlTable*)pri->pvSrcEndAddr - (words / 4 - 1);
+  alt->pvSrcEndAddr = task->pvSrcEndAddr;
+  alt->pvDstEndAddr = task->pvDstEndAddr;
+  alt->ui32Control = task->ui32Control;
+
+  words -= 4;
+  control &= ~(UDMA_XFER_SIZE_M | UDMA_MODE_M);
+  if (words) {
+    control |= UDMA_MODE_PER_SCATTER_GATHER | ((words - 1) << UDMA_XFER_SIZE_S);
+  }
+  pri->ui32Control = control;
+  _prialt |= 1u << channel;
+}
+
+static void _transfer(uint32_t channel, uint32_t items)
+{
+  uint32_t alt = (_prialt >> channel) & 1;
+  tDMAControlTable* e = _entry(channel | (alt ? UDMA_ALT_SELECT : 0));
+  uint32_t control = e->ui32Control;
+  uint32_t mode = control & UDMA_MODE_M;
+
+  if (mode == UDMA_MODE_STOP) {
+    sim_fail("DMA ch %u: request on a stopped structure", channel);
+  }
+  if (!alt && mode == UDMA_MODE_PER_SCATTER_GATHER) {
+    _fetch_task(channel);
+    return;
+  }
+  if (mode == UDMA_MODE_MEM_SCATTER_GATHER) {
+    sim_fail("DMA ch %u: memory scatter-gather not simulated", channel);
+  }
+
+  uint32_t src_inc = (control & UDMA_SRC_INC_M) >> UDMA_SRC_INC_S;
+  uint32_t dst_inc = (control & UDMA_DST_INC_M) >> UDMA_DST_INC_S;
+  uint32_t src_size = 1u << ((control >> 24) & 3);
+  uint32_t dst_size = 1u << ((control >> 28) & 3);
+  uint32_t left = _remaining(control);
+  if (items > left) items = left;
+
+  for (uint32_t i = 0; i < items; i++, left--) {
+    uint32_t value = _load(_item_addr(e->pvSrcEndAddr, src_inc, left), src_size);
+    _store(_item_addr(e->pvDstEndAddr, dst_inc, left), value, dst_size);
+  }
+
+  control &= ~UDMA_XFER_SIZE_M;
+  if (left) {
+    e->ui32Control = control | ((left - 1) << UDMA_XFER_SIZE_S);
+    return;
+  }
+
+  e->ui32Control = control & ~UDMA_MODE_M;
+  _complete(channel, alt, mode);
+}
+
+void sim_udma_service()
+{
+  if (!(_cfg & UDMA_CFG_MASTERENABLE)) return;
+
+  uint32_t channel, items;
+  while ((items = _arbitrate(&channel)) != 0) {
+    _transfer(channel, items);
+  }
+}
+
+uint32_t sim_udma_done()
+{
+  return _done;
+}
+
+//
+// Registers
+//
+
+uint32_t sim_udma_read(uint32_t offset)
+{
+  switch (offset) {
+  case UDMA_O_CFG: return _cfg;
+  case UDMA_O_SETBURST: return _burst;
+  case UDMA_O_SETREQMASK: return _reqmask;
+  case UDMA_O_SETCHANNELEN: return _enabled;
+  case UDMA_O_SETCHNLPRIALT: return _prialt;
+  case UDMA_O_SETCHNLPRIORITY: return _priority;
+  case UDMA_O_ERROR: return 0;
+  case UDMA_O_REQDONE: return _done;
+  default:
+    sim_fail("uDMA: read from offset 0x%03x", offset);
+  }
+}
+
+void sim_udma_write(uint32_t offset, uint32_t value)
+{
+  switch (offset) {
+  case UDMA_O_CFG: _cfg = value; break;
+  case UDMA_O_SETBURST: _burst |= value; break;
+  case UDMA_O_CLEARBURST: _burst &= ~value; break;
+  case UDMA_O_SETREQMASK: _reqmask |= value; break;
+  case UDMA_O_CLEARREQMASK: _reqmask &= ~value; break;
+  case UDMA_O_SETCHANNELEN: _enabled |= value; break;
+  case UDMA_O_CLEARCHANNELEN: _enabled &= ~value; break;
+  case UDMA_O_SETCHNLPRIALT: _prialt |= value; break;
+  case UDMA_O_CLEARCHNLPRIALT: _prialt &= ~value; break;
+  case UDMA_O_SETCHNLPRIORITY: _priority |= value; break;
+  case UDMA_O_CLEARCHNLPRIORITY: _priority &= ~value; break;
+  case UDMA_O_ERROR: break;
+  case UDMA_O_REQDONE: _done &= ~value; break;
+  default:
+    sim_fail("uDMA: write to offset 0x%03x", offset);
+  }
+}
+
+//
+// Driverlib
+//
+
+void uDMAControlBaseSet(uint32_t base, void* table)
+{
+  _table = table;
+}
+
+void* uDMAControlBaseGet(uint32_t base)
+{
+  return _table;
+}
+
+void uDMAChannelAttributeEnable(uint32_t base, uint32_t channel,
+                                uint32_t attr)
+{
+  if (attr & UDMA_ATTR_USEBURST)
+    sim_hwreg_write(base + UDMA_O_SETBURST, 1u << channel);
+  if (attr & UDMA_ATTR_ALTSELECT)
+    sim_hwreg_write(base + UDMA_O_SETCHNLPRIALT, 1u << channel);
+  if (attr & UDMA_ATTR_HIGH_PRIORITY)
+    sim_hwreg_write(base + UDMA_O_SETCHNLPRIORITY, 1u << channel);
+  if (attr & UDMA_ATTR_REQMASK)
+    sim_hwreg_write(base + UDMA_O_SETREQMASK, 1u << channel);
+}
+
+void uDMAChannelAttributeDisable(uint32_t base, uint32_t channel,
+                                 uint32_t attr)
+{
+  if (attr & UDMA_ATTR_USEBURST)
+    sim_hwreg_write(base + UDMA_O_CLEARBURST, 1u << channel);
+  if (attr & UDMA_ATTR_ALTSELECT)
+    sim_hwreg_write(base + UDMA_O_CLEARCHNLPRIALT, 1u << channel);
+  if (attr & UDMA_ATTR_HIGH_PRIORITY)
+    sim_hwreg_write(base + UDMA_O_CLEARCHNLPRIORITY, 1u << channel);
+  if (attr & UDMA_ATTR_REQMASK)
+    sim_hwreg_write(base + UDMA_O_CLEARREQMASK, 1u << channel);
+}
+
+void uDMAChannelControlSet(uint32_t base, uint32_t channel_struct,
+                           uint32_t control)
+{
+  tDMAControlTable* e = _entry(channel_struct);
+  e->ui32Control = (e->ui32Control & ~(UDMA_DST_INC_M | UDMA_SRC_INC_M |
+                                       UDMA_SIZE_M | UDMA_ARB_M |
+                                       UDMA_NEXT_USEBURST)) |
+                   control;
+}
+
+void uDMAChannelTransferSet(uint32_t base, uint32_t channel_struct,
+                            uint32_t mode, void* src, void* dst,
+                            uint32_t size)
+{
+  ASSERT(size != 0 && size <= UDMA_XFER_SIZE_MAX);
+  tDMAControlTable* e = _entry(channel_struct);
+
+  uint32_t control = e->ui32Control & ~(UDMA_XFER_SIZE_M | UDMA_MODE_M);
+  if ((channel_struct & UDMA_ALT_SELECT) &&
+      (mode == UDMA_MODE_MEM_SCATTER_GATHER ||
+       mode == UDMA_MODE_PER_SCATTER_GATHER)) {
+    mode |= UDMA_MODE_ALT_SELECT;
+  }
+  control |= mode | ((size - 1) << UDMA_XFER_SIZE_S);
+
+  uint32_t inc = (control & UDMA_SRC_INC_M) >> UDMA_SRC_INC_S;
+  if (inc != 3) src = (uint8_t*)src + ((uintptr_t)(size - 1) << inc);
+
+  inc = (control & UDMA_DST_INC_M) >> UDMA_DST_INC_S;
+  if (inc != 3) dst = (uint8_t*)dst + ((uintptr_t)(size - 1) << inc);
+
+  e->pvSrcEndAddr = src;
+  e->pvDstEndAddr = dst;
+  e->ui32Control = control;
+}
+
+void uDMAChannelScatterGatherSet(uint32_t base, uint32_t channel,
+                                 uint32_t task_count, void* task_list,
+                                 uint32_t periph_sg)
+{
+  ASSERT(task_count != 0 && task_count <= UDMA_XFER_SIZE_MAX / 4);
+  tDMAControlTable* e = _entry(channel);
+  tDMAControlTable* tasks = task_list;
+
+  e->pvSrcEndAddr = &tasks[task_count - 1];
+  e->pvDstEndAddr = _entry(channel | UDMA_ALT_SELECT);
+  e->ui32Control = UDMA_DST_INC_32 | UDMA_SRC_INC_32 | UDMA_SIZE_32 |
+                   UDMA_ARB_4 | ((task_count * 4 - 1) << UDMA_XFER_SIZE_S) |
+                   (periph_sg ? UDMA_MODE_PER_SCATTER_GATHER
+                              : UDMA_MODE_MEM_SCATTER_GATHER);
+
+  sim_hwreg_write(base + UDMA_O_CLEARCHNLPRIALT, 1u << channel);
+}
+
+uint32_t uDMAChannelSizeGet(uint32_t base, uint32_t channel_struct)
+{
+  uint32_t control = _entry(channel_struct)->ui32Control;
+  if (!(control & (UDMA_XFER_SIZE_M | UDMA_MODE_M))) return 0;
+  return _remaining(control);
+}
+
+uint32_t uDMAChannelModeGet(uint32_t base, uint32_t channel_struct)
+{
+  uint32_t mode = _entry(channel_struct)->ui32Control & UDMA_MODE_M;
+  if (mode == MODE_PER_SG_ALT) mode = UDMA_MODE_PER_SCATTER_GATHER;
+  return mode;
+}
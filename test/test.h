@@ -0,0 +1,24 @@
+#pragma once
+
+// Minimal checks for the host tests: report and abort on failure
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      abort(); \
+    } \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if (_a != _b) { \
+      fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+              __FILE__, __LINE__, #a, #b, _a, _b); \
+      abort(); \
+    } \
+  } while (0)
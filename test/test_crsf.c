@@ -0,0 +1,175 @@
+// CRSF: CRC8 table against a bitwise CRC, then RC frames received
+// on a half-duplex line with telemetry replies, timed on the line
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "crc.h"
+#include "crsf.h"
+#include "sim.h"
+#include "test.h"
+
+#define FRAMES 2000
+#define FRAME_PERIOD_US 1500
+#define SLOT_US 250 // 4 kHz link rate
+
+static uint8_t _crc8_bits(uint8_t crc, const uint8_t* data, uint32_t len)
+{
+  while (len--) {
+    crc ^= *data++;
+    for (unsigned bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0xD5 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void _test_crc8()
+{
+  for (unsigned i = 0; i < 256; i++) {
+    uint8_t byte = i;
+    CHECK_EQ(crc8_d5_table[i], _crc8_bits(0, &byte, 1));
+  }
+
+  // CRC-8/DVB-S2 check value
+  CHECK_EQ(crc8_d5(0, "123456789", 9), 0xBC);
+
+  uint8_t data[CRSF_MAX_FRAME_SIZE];
+  for (unsigned n = 0; n < 10000; n++) {
+    uint32_t len = rand() % sizeof(data);
+    for (uint32_t i = 0; i < len; i++) data[i] = rand();
+    CHECK_EQ(crc8_d5(0, data, len), _crc8_bits(0, data, len));
+  }
+}
+
+// sync + len + type + payload + crc
+static uint32_t _frame(uint8_t* frame, uint8_t sync, uint8_t type,
+                       const void* payload, uint32_t len)
+{
+  frame[0] = sync;
+  frame[1] = len + 2;
+  frame[2] = type;
+  memcpy(frame + 3, payload, len);
+  frame[len + 3] = _crc8_bits(0, frame + 2, len + 1);
+  return len + 4;
+}
+
+static void _pack(const uint16_t* channels, uint8_t* data)
+{
+  memset(data, 0, RC_PACKED_SIZE);
+  for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+    for (unsigned bit = 0; bit < 11; bit++) {
+      unsigned pos = ch * 11 + bit;
+      if (channels[ch] & (1 << bit)) data[pos / 8] |= 1 << (pos % 8);
+    }
+  }
+}
+
+static void _test_link(uint32_t baud_rate)
+{
+  crsf_init(UART1, IOID_21, IOID_21, baud_rate);
+
+  uint32_t bad = 0;
+  uint64_t max_reply = 0;
+  uint32_t replies = 0;
+
+  for (unsigned n = 0; n < FRAMES; n++) {
+    uint64_t start = sim_now;
+
+    // telemetry queued by the main loop, sent after the next RC frame
+    uint8_t battery[8];
+    uint8_t tlm[CRSF_MAX_FRAME_SIZE];
+    uint32_t tlm_len = 0;
+    bool reply = (n % 2 == 0);
+    if (reply) {
+      for (unsigned i = 0; i < sizeof(battery); i++) battery[i] = rand();
+      CHECK(crsf_send_telemetry(CRSF_FRAMETYPE_BATTERY_SENSOR, battery,
+                                sizeof(battery)));
+      tlm_len = _frame(tlm, CRSF_SYNC_BYTE, CRSF_FRAMETYPE_BATTERY_SENSOR,
+                       battery, sizeof(battery));
+    }
+
+    uint8_t frames[3 * CRSF_MAX_FRAME_SIZE];
+    uint32_t len = 0;
+
+    // line noise, another frame type back-to-back with the RC frame
+    if (n % 5 == 0) frames[len++] = rand();
+    if (n % 3 == 0) {
+      uint8_t stats[10];
+      for (unsigned i = 0; i < sizeof(stats); i++) stats[i] = rand();
+      len += _frame(frames + len, CRSF_ADDR_MODULE,
+                    CRSF_FRAMETYPE_LINK_STATISTICS, stats, sizeof(stats));
+    }
+
+    uint16_t channels[RC_CHANNELS];
+    uint8_t packed[RC_PACKED_SIZE];
+    for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+      channels[ch] = rand() & RC_CHANNEL_MASK;
+    }
+    _pack(channels, packed);
+    uint32_t rc = len;
+    len += _frame(frames + len, CRSF_ADDR_MODULE,
+                  CRSF_FRAMETYPE_RC_CHANNELS_PACKED, packed, sizeof(packed));
+
+    // (telemetry would stay queued until the next good one)
+    bool corrupt = !reply && (n % 23 == 7);
+    if (corrupt) {
+      frames[rc + 3 + rand() % RC_PACKED_SIZE] ^= 1 << (rand() % 8);
+      bad++;
+    }
+
+    sim_uart_sent_clear(UART1);
+    sim_uart_send(UART1, frames, len);
+    uint64_t rc_end = sim_uart_send_end(UART1);
+    sim_run_until(start + SIM_US(FRAME_PERIOD_US));
+
+    uint16_t decoded[RC_CHANNELS];
+    size_t sent_len;
+    const uint8_t* sent = sim_uart_sent(UART1, &sent_len);
+
+    if (corrupt) {
+      CHECK(!crsf_get_channels(decoded));
+      CHECK_EQ(sent_len, 0);
+      continue;
+    }
+
+    CHECK(crsf_get_channels(decoded));
+    CHECK(memcmp(decoded, channels, sizeof(channels)) == 0);
+    CHECK(!crsf_get_channels(decoded));
+
+    if (!reply) {
+      CHECK_EQ(sent_len, 0);
+      continue;
+    }
+
+    CHECK_EQ(sent_len, tlm_len);
+    CHECK(memcmp(sent, tlm, tlm_len) == 0);
+
+    // end of the RC frame to start of the reply on the line
+    uint64_t reply_start = sim_uart_sent_time(UART1, 0) - sim_uart_char_ns(UART1);
+    uint64_t t = reply_start - rc_end;
+    if (t > max_reply) max_reply = t;
+    replies++;
+  }
+
+  // resyncing within a corrupted frame may find false frames
+  CHECK(crsf_crc_errors() >= bad);
+  CHECK_EQ(sim_uart_overruns(UART1), 0);
+
+  const crsf_stats_t* stats = crsf_get_stats();
+  printf("%u baud: %u replies, RC frame end to reply %.1f us max "
+         "(%.1f us in IRQ)\n", baud_rate, replies, max_reply / 1000.0,
+         stats->max_reply_ticks / 48.0);
+  CHECK(replies > 0);
+  CHECK(max_reply < SIM_US(SLOT_US));
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t baud_rate = argc > 1 ? atoi(argv[1]) : CRSF_BAUDRATE;
+
+  srand(8);
+  _test_crc8();
+  _test_link(baud_rate);
+  return 0;
+}
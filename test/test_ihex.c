@@ -0,0 +1,234 @@
+// Intel HEX writer: a 256 KB dump (filled rows skipped, 64 KB
+// segments) decoded back by kk_ihex_read, then the record encoding
+// cost against kk_ihex_write
+
+#include <kk_ihex_read.h>
+#include <kk_ihex_write.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+#include "test.h"
+
+// static record writer under test
+#include "ihex.c"
+
+#define BENCH_RECORDS 200000
+
+static uint32_t _image[FS_SIZE / 4];
+static uint8_t _decoded[FS_SIZE];
+
+// ~44 chars per 16 bytes
+static char _hex[FS_SIZE * 3];
+static uint32_t _hex_len;
+
+static void _collect(char* buffer, unsigned len)
+{
+  CHECK(_hex_len + len <= sizeof(_hex));
+  memcpy(_hex + _hex_len, buffer, len);
+  _hex_len += len;
+}
+
+// kk_ihex_read callback
+static uint32_t _records;
+static uint32_t _eof;
+static uint32_t _checksum_errors;
+
+ihex_bool_t ihex_data_read(kk_ihex_t* ihex, ihex_record_type_t type,
+                           ihex_bool_t checksum_error)
+{
+  if (checksum_error) _checksum_errors++;
+
+  if (type == IHEX_DATA_RECORD) {
+    uint32_t addr = IHEX_LINEAR_ADDRESS(ihex);
+    CHECK_EQ(ihex->length, HEX_BLOCK);
+    CHECK(addr + ihex->length <= FS_SIZE);
+    memcpy(_decoded + addr, ihex->data, ihex->length);
+    _records++;
+  } else if (type == IHEX_END_OF_FILE_RECORD) {
+    _eof++;
+  }
+  return true;
+}
+
+// Rows the writer skips
+static bool _is_filled(const uint8_t* row)
+{
+  for (uint32_t i = 0; i < HEX_BLOCK; i++) {
+    if (row[i] != 0xFF) return false;
+  }
+  return true;
+}
+
+// Random data, with filled rows and whole filled blocks
+static uint32_t _fill_image()
+{
+  uint8_t* bytes = (uint8_t*)_image;
+  uint32_t rows = 0;
+
+  for (uint32_t addr = 0; addr < FS_SIZE; addr += READ_BLOCK) {
+    bool block_filled = rand() % 8 == 0;
+    for (uint32_t row = 0; row < READ_BLOCK; row += HEX_BLOCK) {
+      uint8_t* p = bytes + addr + row;
+      if (block_filled || rand() % 4 == 0) {
+        memset(p, 0xFF, HEX_BLOCK);
+        // a row with a single byte written is not skipped
+        if (!block_filled && rand() % 4 == 0) p[rand() % HEX_BLOCK] = 0x7F;
+      } else {
+        for (uint32_t i = 0; i < HEX_BLOCK; i++) p[i] = rand();
+      }
+      if (!_is_filled(p)) rows++;
+    }
+  }
+  return rows;
+}
+
+static void _test_round_trip()
+{
+  uint32_t rows = _fill_image();
+
+  _flush_cb = _collect;
+  _tx_len = 0;
+  _segment = 0;
+  for (uint32_t addr = 0; addr < FS_SIZE; addr += READ_BLOCK) {
+    _encode_block(addr, _image + addr / 4);
+  }
+  _write_record(HEX_TYPE_EOF, 0, 0, 0);
+  _tx_flush();
+
+  kk_ihex_t reader;
+  memset(_decoded, 0xFF, sizeof(_decoded));
+  ihex_begin_read(&reader);
+  ihex_read_bytes(&reader, _hex, _hex_len);
+  ihex_end_read(&reader);
+
+  CHECK_EQ(_checksum_errors, 0);
+  CHECK_EQ(_eof, 1);
+  CHECK_EQ(_records, rows);
+  CHECK(!memcmp(_decoded, _image, FS_SIZE));
+
+  // uppercase digits, '\n' line endings
+  for (uint32_t i = 0; i < _hex_len; i++) {
+    char c = _hex[i];
+    CHECK(c == ':' || c == '\n' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'));
+  }
+  CHECK(!memcmp(_hex + _hex_len - 12, ":00000001FF\n", 12));
+}
+
+//
+// Benchmark: the same data records (and 04 records every 64 KB)
+//
+
+static uint32_t _out_bytes;
+
+static void _count(char* buffer, unsigned len)
+{
+  _out_bytes += len;
+}
+
+void ihex_flush_buffer(kk_ihex_t* ihex, char* buffer, char* eptr)
+{
+  _out_bytes += eptr - buffer;
+}
+
+typedef struct {
+  double ns;
+  uint64_t cycles;
+  uint32_t out_bytes;
+} bench_t;
+
+static double _elapsed_ns(const struct timespec* start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static uint64_t _cycles()
+{
+#if defined(HAVE_TSC)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static const uint8_t* _bench_data(uint32_t n)
+{
+  return (const uint8_t*)_image + (n * HEX_BLOCK) % FS_SIZE;
+}
+
+static bench_t _bench_writer()
+{
+  _flush_cb = _count;
+  _tx_len = 0;
+  _segment = 0;
+  _out_bytes = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t cycles = _cycles();
+
+  for (uint32_t n = 0; n < BENCH_RECORDS; n++) {
+    _write_data(n * HEX_BLOCK, _bench_data(n));
+  }
+  _write_record(HEX_TYPE_EOF, 0, 0, 0);
+  _tx_flush();
+
+  return (bench_t){ _elapsed_ns(&start), _cycles() - cycles, _out_bytes };
+}
+
+static bench_t _bench_kk_ihex()
+{
+  kk_ihex_t writer;
+  _out_bytes = 0;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t cycles = _cycles();
+
+  ihex_init(&writer);
+  ihex_write_at_address(&writer, 0);
+  for (uint32_t n = 0; n < BENCH_RECORDS; n++) {
+    ihex_write_bytes(&writer, _bench_data(n), HEX_BLOCK);
+  }
+  ihex_end_write(&writer);
+
+  return (bench_t){ _elapsed_ns(&start), _cycles() - cycles, _out_bytes };
+}
+
+static void _print(const char* name, const bench_t* b)
+{
+  printf("%s: %.1f MB/s, %.1f ns/record", name,
+         BENCH_RECORDS * HEX_BLOCK * 1e3 / b->ns, b->ns / BENCH_RECORDS);
+#if defined(HAVE_TSC)
+  printf(", %llu cycles/record", (unsigned long long)(b->cycles / BENCH_RECORDS));
+#endif
+  printf(" (%u bytes out)\n", b->out_bytes);
+}
+
+static void _bench()
+{
+  bench_t fast = _bench_writer();
+  bench_t ref = _bench_kk_ihex();
+
+  _print("ihex writer", &fast);
+  _print("kk_ihex_write", &ref);
+
+  // data records, 04 records past the first segment, EOF
+  uint32_t segments = (BENCH_RECORDS * HEX_BLOCK - 1) >> 16;
+  CHECK_EQ(fast.out_bytes, BENCH_RECORDS * HEX_RECORD_SIZE + segments * 16 + 12);
+  CHECK(fast.ns < ref.ns);
+}
+
+int main()
+{
+  srand(14);
+  _test_round_trip();
+  _bench();
+  return 0;
+}
@@ -0,0 +1,329 @@
+// NOR flash: SFDP parsing, writes split on page boundaries
+// (a page program wraps around within its page), and streaming
+// program throughput against the chip's page program time
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "nor_flash.h"
+#include "sim.h"
+#include "test.h"
+
+#define BIT_RATE 24000000
+#define CS IOID_11
+
+#define FLASH_LOG2SIZE 20
+#define FLASH_SIZE (1u << FLASH_LOG2SIZE)
+
+// Typical times given in SFDP, taken as is by the model
+#define PROGRAM_US 384 // 6 x 64 us
+#define ERASE_4KB_MS 48 // 3 x 16 ms
+
+//
+// Flash model: commands decoded frame by frame, program and erase
+// committed when CS goes high, then busy for their typical time
+//
+
+typedef struct {
+  uint8_t mem[FLASH_SIZE];
+
+  bool selected;
+  uint32_t pos; // frames since CS went low
+  uint8_t cmd;
+  uint32_t addr;
+
+  bool wel;
+  uint64_t busy_end;
+
+  // page program being received
+  uint8_t page[FLASH_PAGE_SIZE];
+  uint32_t page_len;
+
+  // commands ignored by the chip
+  uint32_t while_busy;
+  uint32_t without_wel;
+
+  uint32_t programs;
+  uint32_t wraps; // programs crossing their page end
+  uint32_t page_overflows; // more than a page sent
+} flash_model_t;
+
+static flash_model_t _flash;
+
+// BFPT DWORDs 1-13 (JESD216B), 1 MB, no suspend
+static const uint32_t _bfpt[13] = {
+  0xFFF120E5,                   // 4 KB erase (0x20), 3-byte addresses
+  FLASH_SIZE * 8 - 1,           // density (bits - 1)
+  0, 0, 0, 0, 0,
+  0x520F200C,                   // 4 KB (0x20), 32 KB (0x52)
+  0x0000D810,                   // 64 KB (0xD8)
+  (2u << 4) | (1u << 9)         // erase times: 3 x 16 ms,
+    | (7u << 11) | (1u << 16)   //  8 x 16 ms,
+    | (9u << 18) | (1u << 23),  //  10 x 16 ms
+  (5u << 8) | (1u << 13)        // page program: 6 x 64 us
+    | (8u << 4)                 // 256 bytes pages
+    | (3u << 24) | (2u << 29),  // chip erase: 4 x 4 s
+  0x80000000,                   // suspend / resume not supported
+  0,
+};
+
+#define SFDP_BFPT 0x30
+
+static uint8_t _sfdp_byte(uint32_t addr)
+{
+  static const uint8_t header[16] = {
+    'S', 'F', 'D', 'P', 0x06, 0x01, 0x00, 0xFF,
+    0x00, 0x06, 0x01, 13, SFDP_BFPT, 0x00, 0x00, 0xFF,
+  };
+  if (addr < sizeof(header)) return header[addr];
+  if (addr >= SFDP_BFPT && addr < SFDP_BFPT + sizeof(_bfpt)) {
+    uint32_t offset = addr - SFDP_BFPT;
+    return _bfpt[offset / 4] >> (8 * (offset % 4));
+  }
+  return 0xFF;
+}
+
+static bool _busy()
+{
+  return sim_now < _flash.busy_end;
+}
+
+static void _erase(uint32_t addr, uint32_t size, uint64_t ms)
+{
+  if (!_flash.wel) {
+    _flash.without_wel++;
+    return;
+  }
+  addr &= ~(size - 1);
+  memset(_flash.mem + addr, 0xFF, size);
+  _flash.wel = false;
+  _flash.busy_end = sim_now + SIM_MS(ms);
+}
+
+static void _program()
+{
+  if (!_flash.wel) {
+    _flash.without_wel++;
+    return;
+  }
+
+  // wraps around within the page, as the chip does
+  uint32_t page = _flash.addr & ~FLASH_PAGE_MASK;
+  if ((_flash.addr & FLASH_PAGE_MASK) + _flash.page_len > FLASH_PAGE_SIZE) {
+    _flash.wraps++;
+  }
+  for (uint32_t i = 0; i < _flash.page_len; i++) {
+    uint32_t addr = page | ((_flash.addr + i) & FLASH_PAGE_MASK);
+    _flash.mem[addr] &= _flash.page[i];
+  }
+
+  _flash.programs++;
+  _flash.wel = false;
+  _flash.busy_end = sim_now + SIM_US(PROGRAM_US);
+}
+
+// Command complete: CS released
+static void _execute()
+{
+  if (_flash.pos == 0) return;
+  if (_busy() && _flash.cmd != 0x05) {
+    _flash.while_busy++;
+    return;
+  }
+
+  switch (_flash.cmd) {
+  case 0x06: _flash.wel = true; break;
+  case 0x02: if (_flash.pos >= 4) _program(); break;
+  case 0x20: if (_flash.pos >= 4) _erase(_flash.addr, 4096, ERASE_4KB_MS); break;
+  case 0x52: if (_flash.pos >= 4) _erase(_flash.addr, 32768, 128); break;
+  case 0xD8: if (_flash.pos >= 4) _erase(_flash.addr, 65536, 160); break;
+  }
+}
+
+static void _cs_changed(void* ctx, uint32_t dio, bool level)
+{
+  if (dio != CS) return;
+  if (level) {
+    if (_flash.selected) _execute();
+  } else {
+    _flash.pos = 0;
+    _flash.addr = 0;
+    _flash.page_len = 0;
+  }
+  _flash.selected = !level;
+}
+
+// Frame 'n' of the command (0: opcode)
+static uint32_t _frame(void* ctx, uint32_t tx, uint32_t bits)
+{
+  CHECK_EQ(bits, 8);
+  if (!_flash.selected) return 0xFF;
+
+  uint32_t n = _flash.pos++;
+  if (n == 0) {
+    _flash.cmd = tx;
+    return 0xFF;
+  }
+  if (_flash.cmd == 0x05) {
+    return (_busy() ? 0x01 : 0) | (_flash.wel ? 0x02 : 0);
+  }
+  if (n <= 3) {
+    _flash.addr = (_flash.addr << 8) | tx;
+    return 0xFF;
+  }
+
+  // busy: data phase ignored (reported on CS release)
+  if (_busy()) return 0xFF;
+
+  uint32_t offset = n - 4;
+  switch (_flash.cmd) {
+  case 0x90:
+    return offset & 1 ? 0x13 : 0xEF;
+  case 0x03:
+    return _flash.mem[(_flash.addr + offset) % FLASH_SIZE];
+  case 0x0B:
+    if (offset == 0) return 0xFF; // dummy
+    return _flash.mem[(_flash.addr + offset - 1) % FLASH_SIZE];
+  case 0x5A:
+    if (offset == 0) return 0xFF; // dummy
+    return _sfdp_byte(_flash.addr + offset - 1);
+  case 0x02:
+    if (_flash.page_len == FLASH_PAGE_SIZE) {
+      _flash.page_overflows++;
+      memmove(_flash.page, _flash.page + 1, FLASH_PAGE_SIZE - 1);
+      _flash.page_len--;
+    }
+    _flash.page[_flash.page_len++] = tx;
+    return 0xFF;
+  }
+  return 0xFF;
+}
+
+//
+// Tests
+//
+
+static uint8_t _image[FLASH_SIZE];
+static uint8_t _data[64 * 1024];
+static uint8_t _readback[64 * 1024];
+
+static void _check_model_clean()
+{
+  CHECK_EQ(_flash.while_busy, 0);
+  CHECK_EQ(_flash.without_wel, 0);
+  CHECK_EQ(_flash.wraps, 0);
+  CHECK_EQ(_flash.page_overflows, 0);
+}
+
+static void _check_readback(uint32_t addr, uint32_t len)
+{
+  memset(_readback, 0, len);
+  nor_flash_read(addr, _readback, len);
+  CHECK(!memcmp(_readback, _image + addr, len));
+  CHECK(!memcmp(_flash.mem + addr, _image + addr, len));
+}
+
+static void _write(uint32_t addr, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++) _data[i] = rand();
+  nor_flash_write(addr, _data, len);
+  for (uint32_t i = 0; i < len; i++) _image[addr + i] &= _data[i];
+}
+
+// Unaligned writes of all sizes around the page size, back to back
+// (programs queued behind each other) and read back
+static void _test_page_split()
+{
+  static const uint32_t lengths[] = {
+    1, 2, 255, 256, 257, 511, 512, 513, 1000, 4096 + 13, 3 * 4096,
+  };
+
+  CHECK(!nor_flash_erase_range(0, 64 * 1024));
+  memset(_image, 0xFF, sizeof(_image));
+
+  uint32_t addr = 0;
+  for (unsigned i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    for (uint32_t offset = 0; offset < FLASH_PAGE_SIZE; offset += 85) {
+      uint32_t len = lengths[i];
+      addr = (addr & ~FLASH_PAGE_MASK) + FLASH_PAGE_SIZE + offset;
+      if (addr + len > 64 * 1024) {
+        // next lengths on a new erased range
+        nor_flash_sync();
+        _check_readback(0, 64 * 1024);
+        CHECK(!nor_flash_erase_range(0, 64 * 1024));
+        memset(_image, 0xFF, 64 * 1024);
+        addr = offset;
+      }
+
+      uint32_t programs = _flash.programs;
+      _write(addr, len);
+      nor_flash_sync();
+
+      uint32_t first = addr / FLASH_PAGE_SIZE;
+      uint32_t last = (addr + len - 1) / FLASH_PAGE_SIZE;
+      CHECK_EQ(_flash.programs - programs, last - first + 1);
+      _check_readback(addr & ~FLASH_PAGE_MASK, (last - first + 1) * FLASH_PAGE_SIZE);
+      addr += len;
+    }
+  }
+
+  nor_flash_sync();
+  _check_readback(0, 64 * 1024);
+  _check_model_clean();
+}
+
+// 64 KB, page aligned: the next page is sent as soon as the previous
+// one is programmed, each page costs its program time plus its time
+// on the bus (Write Enable, command, address, data)
+static void _test_throughput()
+{
+  const uint32_t len = sizeof(_data);
+  CHECK(!nor_flash_erase_range(0, len));
+  memset(_image, 0xFF, len);
+
+  uint64_t start = sim_now;
+  _write(0, len);
+  nor_flash_sync();
+  uint64_t ns = sim_now - start;
+
+  uint32_t pages = len / FLASH_PAGE_SIZE;
+  uint64_t frame_ns = 8 * 1000000000ull / BIT_RATE;
+  uint64_t page_ns = SIM_US(PROGRAM_US) + (1 + 4 + FLASH_PAGE_SIZE) * frame_ns;
+
+  fprintf(stderr, "[NOR flash]: program %llu KB/s, %llu us/page (bound %llu us)\n",
+          (unsigned long long)(len * 1000000ull / ns * 1000 / 1024),
+          (unsigned long long)(ns / pages / 1000),
+          (unsigned long long)(page_ns / 1000));
+
+  // 10% for the status polls and the DMA setup
+  CHECK(ns < pages * page_ns * 11 / 10);
+
+  _check_readback(0, len);
+  _check_model_clean();
+}
+
+int main()
+{
+  memset(_flash.mem, 0xFF, sizeof(_flash.mem));
+  sim_ssi_attach(0, _frame, 0);
+  sim_gpio_listen(_cs_changed, 0);
+  srand(23);
+
+  const spi_device_t dev = {
+    .frame_format = SPI_POL0_PHA0,
+    .data_width = 8,
+    .bit_rate = BIT_RATE,
+    .rx = IOID_8,
+    .tx = IOID_9,
+    .clk = IOID_10,
+    .cs = CS,
+  };
+  CHECK_EQ(nor_flash_init(SPI0, &dev), 0);
+  CHECK_EQ(nor_flash_size(), FLASH_SIZE);
+
+  _test_page_split();
+  _test_throughput();
+
+  CHECK_EQ(sim_ssi_overruns(0), 0);
+  return 0;
+}
@@ -0,0 +1,170 @@
+// SBUS: 11-bit channel unpacker against a bit loop (random and
+// edge patterns, benchmark), then frames received over UART by DMA
+
+#include <driverlib/ioc.h>
+#include <string.h>
+#include <time.h>
+
+#include "sbus.h"
+#include "sim.h"
+#include "test.h"
+
+#define RANDOM_FRAMES 100000
+#define BENCH_FRAMES 200000
+#define UART_FRAMES 500
+#define FRAME_PERIOD_US 7000
+
+// Reference: one bit at a time
+static void _unpack_bits(const uint8_t* data, uint16_t* channels)
+{
+  for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+    uint16_t value = 0;
+    for (unsigned bit = 0; bit < 11; bit++) {
+      unsigned pos = ch * 11 + bit;
+      if (data[pos / 8] & (1 << (pos % 8))) value |= 1 << bit;
+    }
+    channels[ch] = value;
+  }
+}
+
+static void _pack_bits(const uint16_t* channels, uint8_t* data)
+{
+  memset(data, 0, RC_PACKED_SIZE);
+  for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+    for (unsigned bit = 0; bit < 11; bit++) {
+      unsigned pos = ch * 11 + bit;
+      if (channels[ch] & (1 << bit)) data[pos / 8] |= 1 << (pos % 8);
+    }
+  }
+}
+
+static void _check_unpack(const uint8_t* data)
+{
+  uint16_t fast[RC_CHANNELS], ref[RC_CHANNELS];
+  rc_unpack_channels(data, fast);
+  _unpack_bits(data, ref);
+  CHECK(memcmp(fast, ref, sizeof(fast)) == 0);
+}
+
+static void _test_unpacker()
+{
+  // packed bytes alone in the buffer: reading past them
+  // is caught with SANITIZE
+  uint8_t* data = malloc(RC_PACKED_SIZE);
+
+  for (unsigned n = 0; n < RANDOM_FRAMES; n++) {
+    for (unsigned i = 0; i < RC_PACKED_SIZE; i++) data[i] = rand();
+    _check_unpack(data);
+  }
+
+  // single bits, all zeros / ones
+  for (unsigned bit = 0; bit < RC_PACKED_SIZE * 8; bit++) {
+    memset(data, 0, RC_PACKED_SIZE);
+    data[bit / 8] = 1 << (bit % 8);
+    _check_unpack(data);
+    memset(data, 0xFF, RC_PACKED_SIZE);
+    data[bit / 8] &= ~(1 << (bit % 8));
+    _check_unpack(data);
+  }
+
+  // channel values round-trip
+  uint16_t channels[RC_CHANNELS], unpacked[RC_CHANNELS];
+  for (unsigned n = 0; n < RANDOM_FRAMES; n++) {
+    for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+      channels[ch] = rand() & RC_CHANNEL_MASK;
+    }
+    _pack_bits(channels, data);
+    rc_unpack_channels(data, unpacked);
+    CHECK(memcmp(channels, unpacked, sizeof(channels)) == 0);
+  }
+
+  free(data);
+}
+
+static double _elapsed_ns(const struct timespec* start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static void _bench_unpacker()
+{
+  static uint8_t frames[256][RC_PACKED_SIZE];
+  for (unsigned n = 0; n < 256; n++) {
+    for (unsigned i = 0; i < RC_PACKED_SIZE; i++) frames[n][i] = rand();
+  }
+
+  volatile uint16_t sink = 0;
+  uint16_t channels[RC_CHANNELS];
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned n = 0; n < BENCH_FRAMES; n++) {
+    rc_unpack_channels(frames[n & 255], channels);
+    sink += channels[n & 15];
+  }
+  double fast = _elapsed_ns(&start) / BENCH_FRAMES;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned n = 0; n < BENCH_FRAMES; n++) {
+    _unpack_bits(frames[n & 255], channels);
+    sink += channels[n & 15];
+  }
+  double ref = _elapsed_ns(&start) / BENCH_FRAMES;
+
+  printf("unpacker: %.1f ns/frame (bit loop: %.1f ns/frame)\n", fast, ref);
+  CHECK(fast < ref);
+}
+
+static void _test_uart()
+{
+  sbus_init(UART1, IOID_21);
+  CHECK_EQ(sim_ioc_port(IOID_21), IOC_PORT_MCU_UART1_RX);
+
+  uint8_t frame[SBUS_FRAME_SIZE];
+  uint16_t channels[RC_CHANNELS];
+  uint32_t bad = 0;
+
+  for (unsigned n = 0; n < UART_FRAMES; n++) {
+    for (unsigned ch = 0; ch < RC_CHANNELS; ch++) {
+      channels[ch] = rand() & RC_CHANNEL_MASK;
+    }
+    frame[0] = 0x0F;
+    _pack_bits(channels, frame + 1);
+    frame[1 + RC_PACKED_SIZE] = rand() & 0x0F;
+    frame[SBUS_FRAME_SIZE - 1] = (n % 3) ? 0x00 : 0x04 | (rand() & 0xF0); // SBUS2
+
+    bool corrupt = (n % 17 == 0);
+    if (corrupt) {
+      frame[0] ^= 0x01;
+      bad++;
+    }
+
+    uint64_t start = sim_now;
+    sim_uart_send(UART1, frame, sizeof(frame));
+    sim_run_until(start + SIM_US(FRAME_PERIOD_US));
+
+    sbus_frame_t decoded;
+    if (corrupt) {
+      CHECK(!sbus_get_frame(&decoded));
+      continue;
+    }
+    CHECK(sbus_get_frame(&decoded));
+    CHECK(memcmp(decoded.channels, channels, sizeof(channels)) == 0);
+    CHECK_EQ(decoded.flags, frame[1 + RC_PACKED_SIZE]);
+    CHECK(!sbus_get_frame(&decoded));
+  }
+
+  CHECK_EQ(sbus_frame_errors(), bad);
+  CHECK_EQ(sim_uart_overruns(UART1), 0);
+}
+
+int main()
+{
+  srand(7);
+  _test_unpacker();
+  _bench_unpacker();
+  _test_uart();
+  return 0;
+}
@@ -0,0 +1,99 @@
+// serial_t frame slots: back-to-back frames received while the
+// consumer is busy for random times, then stalled past all the slots
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "serial.h"
+#include "sim.h"
+#include "test.h"
+#include "timer.h"
+
+#define FRAMES 4000
+#define STALLED_FRAMES 40
+#define GAP_CHARS 4 // receive timeout: 32 bit periods
+
+typedef struct {
+  uint8_t data[RX_BUFFER_SIZE];
+  uint32_t len;
+} test_frame_t;
+
+static serial_t _serial;
+static test_frame_t _frames[FRAMES + STALLED_FRAMES];
+
+static void _queue_frames(uint32_t first, uint32_t count)
+{
+  for (uint32_t i = first; i < first + count; i++) {
+    test_frame_t* f = &_frames[i];
+    f->len = 1 + rand() % RX_BUFFER_SIZE;
+    for (uint32_t j = 0; j < f->len; j++) f->data[j] = rand();
+
+    sim_uart_send(UART0, f->data, f->len);
+    sim_uart_send_gap(UART0, sim_uart_char_ns(UART0) * GAP_CHARS);
+  }
+}
+
+static void _check_frame(uint32_t i)
+{
+  const serial_frame_t* frame = serial_get_frame(&_serial);
+  CHECK(frame);
+  CHECK_EQ(frame->len, _frames[i].len);
+  CHECK(memcmp(frame->data, _frames[i].data, frame->len) == 0);
+  serial_release_frame(&_serial);
+}
+
+int main()
+{
+  const uart_device_t dev = {
+    .mode = UART_8N1,
+    .baud_rate = SERIAL_BAUDRATE,
+    .rx = IOID_2,
+    .tx = IOID_3,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+  serial_init(&_serial, UART0, &dev);
+  srand(3);
+
+  // Consumer busy up to ~4 average frame times between polls:
+  // the backlog stays within the slots, nothing is lost
+  _queue_frames(0, FRAMES);
+
+  uint32_t next = 0;
+  while (next < FRAMES) {
+    sim_run(SIM_US(rand() % 3000));
+
+    // all pending frames, or just one (fall behind a little)
+    bool all = rand() % 4;
+    while (next < FRAMES && serial_get_frame(&_serial)) {
+      _check_frame(next++);
+      if (!all) break;
+    }
+  }
+
+  CHECK_EQ(serial_rx_overflows(&_serial), 0);
+  CHECK_EQ(serial_rx_errors(&_serial), 0);
+  CHECK_EQ(sim_uart_overruns(UART0), 0);
+  CHECK(!serial_get_frame(&_serial));
+  printf("%u frames: up to %u slots used, %u us max wait\n", FRAMES,
+         _serial.rx_max_used, ticks2us(_serial.rx_max_wait));
+  CHECK(_serial.rx_max_used < RX_FRAME_SLOTS - 1);
+
+  // Consumer stalled: the slots but the one being received keep
+  // the oldest frames, the following ones are dropped and counted
+  _queue_frames(FRAMES, STALLED_FRAMES);
+  sim_run_until(sim_uart_send_end(UART0) + SIM_MS(1));
+
+  const uint32_t kept = RX_FRAME_SLOTS - 1;
+  for (uint32_t i = 0; i < kept; i++) _check_frame(FRAMES + i);
+  CHECK(!serial_get_frame(&_serial));
+  CHECK_EQ(serial_rx_overflows(&_serial), STALLED_FRAMES - kept);
+  CHECK_EQ(serial_rx_errors(&_serial), 0);
+
+  // and reception goes on once the slots are released
+  _queue_frames(0, 1);
+  sim_run_until(sim_uart_send_end(UART0) + SIM_MS(1));
+  _check_frame(0);
+  CHECK(!serial_get_frame(&_serial));
+  return 0;
+}
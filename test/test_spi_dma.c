@@ -0,0 +1,216 @@
+// SPI DMA longer than one uDMA transfer (1024 items): chunked ping-pong,
+// full-duplex, one direction or dummy frames, 8 and 16-bit frames,
+// with the completion IRQ held off for several chunks
+
+#include <driverlib/cpu.h>
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "sim.h"
+#include "spi.h"
+#include "test.h"
+
+#define MAX_LEN 5000
+#define BIT_RATE 24000000
+
+// Device: records the frames sent, answers a sequence derived from them
+typedef struct {
+  uint32_t sent[MAX_LEN];
+  uint32_t count;
+  uint32_t seed;
+  uint32_t cs; // IOID_UNUSED: not checked
+} device_t;
+
+static device_t _dev;
+
+static uint32_t _answer(uint32_t n, uint32_t tx, uint32_t seed)
+{
+  return (n * 2654435761u) ^ (tx << 3) ^ seed;
+}
+
+static uint32_t _device(void* ctx, uint32_t tx, uint32_t bits)
+{
+  device_t* dev = (device_t*)ctx;
+  CHECK(dev->count < MAX_LEN);
+  if (dev->cs != IOID_UNUSED) CHECK(!sim_gpio_get(dev->cs));
+  uint32_t n = dev->count++;
+  dev->sent[n] = tx;
+  return _answer(n, tx, dev->seed);
+}
+
+static uint16_t _tx[MAX_LEN];
+static uint16_t _rx[MAX_LEN];
+
+static const uint32_t _lengths[] = {1, 8, 1023, 1024, 1025, 2048, 3333, MAX_LEN};
+
+// data_size: 1 or 2, tx / rx: buffers used or not,
+// late: IRQs masked until the transfer is over (completions merge,
+// channels stop on structures not re-armed in time)
+static void _check(uint32_t len, uint32_t data_size, bool tx, bool rx, bool late)
+{
+  uint32_t mask = data_size == 1 ? 0xFF : 0xFFFF;
+
+  for (uint32_t i = 0; i < len; i++) _tx[i] = rand() & mask;
+  memset(_rx, 0xA5, sizeof(_rx));
+  _dev.count = 0;
+  _dev.seed = rand();
+
+  uint8_t* tx8 = (uint8_t*)_tx;
+  uint8_t* rx8 = (uint8_t*)_rx;
+  if (data_size == 1) {
+    for (uint32_t i = 0; i < len; i++) tx8[i] = _tx[i];
+  }
+
+  const void* txp = tx ? (const void*)_tx : 0;
+  void* rxp = rx ? (void*)_rx : 0;
+
+  uint32_t primask = late ? CPUcpsid() : 0;
+  if (data_size == 1) {
+    spi_transfer_dma_8(SPI0, txp, rxp, len, false);
+  } else {
+    spi_transfer_dma_16(SPI0, txp, rxp, len, false);
+  }
+
+  if (late) {
+    // a chunk takes 340 us at 24 MHz
+    sim_run(SIM_MS(4));
+    if (!primask) CPUcpsie();
+  }
+  spi_wait_dma_done(SPI0);
+
+  CHECK_EQ(_dev.count, len);
+  for (uint32_t i = 0; i < len; i++) {
+    uint32_t sent = !tx ? 0 : data_size == 1 ? tx8[i] : _tx[i];
+    CHECK_EQ(_dev.sent[i], sent);
+
+    if (!rx) continue;
+    uint32_t rcvd = data_size == 1 ? rx8[i] : _rx[i];
+    CHECK_EQ(rcvd, _answer(i, sent, _dev.seed) & mask);
+  }
+
+  // nothing written past the end
+  if (rx) {
+    uint8_t* end = rx8 + len * data_size;
+    CHECK(end == rx8 + sizeof(_rx) || *end == 0xA5);
+  } else {
+    CHECK(_rx[0] == 0xA5A5);
+  }
+}
+
+static void _configure(uint32_t data_width, uint32_t cs)
+{
+  const spi_device_t dev = {
+    .frame_format = SPI_POL0_PHA0,
+    .data_width = data_width,
+    .bit_rate = BIT_RATE,
+    .rx = IOID_8,
+    .tx = IOID_9,
+    .clk = IOID_10,
+    .cs = cs,
+  };
+  _dev.cs = cs;
+  spi_init(SPI0, &dev);
+}
+
+// Multi-segment transactions: CS held low across all segments,
+// released between queued transactions
+
+#define CS IOID_11
+
+static uint32_t _cs_edges[2];
+
+static void _cs_listener(void* ctx, uint32_t dio, bool level)
+{
+  if (dio == CS) _cs_edges[level]++;
+}
+
+static uint32_t _done_order[2];
+static uint32_t _done_count;
+
+static void _xfer_done(void* ctx)
+{
+  // the next transaction is started first (CS asserted again)
+  _done_order[_done_count++] = (uint32_t)(uintptr_t)ctx;
+  CHECK_EQ(_cs_edges[1], _done_count);
+}
+
+static void _check_segments()
+{
+  _configure(8, CS);
+  sim_gpio_listen(_cs_listener, 0);
+
+  uint8_t* tx8 = (uint8_t*)_tx;
+  uint8_t* rx8 = (uint8_t*)_rx;
+  for (uint32_t i = 0; i < MAX_LEN; i++) tx8[i] = rand();
+  memset(_rx, 0xA5, sizeof(_rx));
+  _dev.count = 0;
+  _dev.seed = rand();
+
+  // command, 2000 bytes in, 1100 both ways / 4 + 1200 out
+  const spi_segment_t read[] = {
+    {tx8, 0, 4},
+    {0, rx8, 2000},
+    {tx8 + 4, rx8 + 2000, 1100},
+  };
+  const spi_segment_t write[] = {
+    {tx8 + 1104, 0, 4},
+    {tx8 + 1108, 0, 1200},
+  };
+  spi_xfer_t xfers[2] = {
+    {read, 3, 1, SPI_XFER_CS, 0, _xfer_done, (void*)0},
+    {write, 2, 1, SPI_XFER_CS, 0, _xfer_done, (void*)1},
+  };
+
+  spi_submit(SPI0, &xfers[0]);
+  spi_submit(SPI0, &xfers[1]);
+  spi_xfer_wait(&xfers[1]);
+
+  CHECK(!xfers[0].busy && !xfers[0].error && !xfers[1].error);
+  CHECK_EQ(_done_count, 2);
+  CHECK_EQ(_done_order[0], 0);
+  CHECK_EQ(_done_order[1], 1);
+  CHECK_EQ(_cs_edges[0], 2);
+  CHECK_EQ(_cs_edges[1], 2);
+  CHECK(sim_gpio_get(CS));
+
+  // device saw all segments back to back, in order
+  CHECK_EQ(_dev.count, 4 + 2000 + 1100 + 4 + 1200);
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < 4; i++, n++) CHECK_EQ(_dev.sent[n], tx8[i]);
+  for (uint32_t i = 0; i < 2000; i++, n++) {
+    CHECK_EQ(_dev.sent[n], 0);
+    CHECK_EQ(rx8[i], _answer(n, 0, _dev.seed) & 0xFF);
+  }
+  for (uint32_t i = 0; i < 1100; i++, n++) {
+    CHECK_EQ(_dev.sent[n], tx8[4 + i]);
+    CHECK_EQ(rx8[2000 + i], _answer(n, tx8[4 + i], _dev.seed) & 0xFF);
+  }
+  for (uint32_t i = 0; i < 1204; i++, n++) CHECK_EQ(_dev.sent[n], tx8[1104 + i]);
+  CHECK_EQ(rx8[3100], 0xA5);
+
+  sim_gpio_listen(0, 0);
+}
+
+int main()
+{
+  sim_ssi_attach(0, _device, &_dev);
+  srand(17);
+
+  for (uint32_t data_size = 1; data_size <= 2; data_size++) {
+    _configure(data_size * 8, IOID_UNUSED);
+
+    for (unsigned i = 0; i < sizeof(_lengths) / sizeof(_lengths[0]); i++) {
+      uint32_t len = _lengths[i];
+      for (unsigned dir = 0; dir < 4; dir++) {
+        bool tx = dir & 1, rx = dir & 2;
+        _check(len, data_size, tx, rx, false);
+        _check(len, data_size, tx, rx, true);
+      }
+    }
+  }
+
+  _check_segments();
+
+  CHECK_EQ(sim_ssi_overruns(0), 0);
+  return 0;
+}
@@ -0,0 +1,105 @@
+// UART RX DMA ring: 1 MB of random frames (random lengths and gaps,
+// back-to-back bursts longer than the ring) received without loss
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "sim.h"
+#include "test.h"
+#include "uart.h"
+
+#define BAUD_RATE 1000000
+#define RING_SIZE 256
+#define TOTAL (1024 * 1024)
+#define MAX_FRAME 600 // more than the ring: exercises the half done IRQs
+
+static uint8_t _ring[RING_SIZE];
+static uint8_t _sent[TOTAL];
+static uint8_t _rcvd[TOTAL];
+static uint32_t _rd;
+static uint32_t _rcvd_len;
+static uint32_t _frames;
+static uint32_t _errors;
+
+static void _drain()
+{
+  uint32_t wr = uart_rx_dma_write_index(UART0);
+  while (_rd != wr) {
+    CHECK(_rcvd_len < TOTAL);
+    _rcvd[_rcvd_len++] = _ring[_rd];
+    _rd = (_rd + 1) & (RING_SIZE - 1);
+  }
+}
+
+static void _frame_received(void* ctx)
+{
+  _drain();
+  _frames++;
+}
+
+static void _data_received(void* ctx)
+{
+  _drain();
+}
+
+static void _error(void* ctx, uart_error_t error)
+{
+  _errors++;
+}
+
+int main()
+{
+  const uart_device_t dev = {
+    .mode = UART_8N1,
+    .baud_rate = BAUD_RATE,
+    .rx = IOID_2,
+    .tx = IOID_3,
+    .cts = IOID_UNUSED,
+    .rts = IOID_UNUSED,
+  };
+  const uart_callbacks_t callbacks = {
+    .frame_received = _frame_received,
+    .data_received = _data_received,
+    .error = _error,
+  };
+
+  uart_init(UART0, &dev);
+  uart_enable_irqs(UART0, &callbacks);
+  uart_enable_rx_dma(UART0, _ring, sizeof(_ring));
+
+  srand(1);
+  for (uint32_t i = 0; i < TOTAL; i++) _sent[i] = rand();
+
+  uint32_t gaps = 0;
+  bool gap = false;
+  for (uint32_t pos = 0; pos < TOTAL;) {
+    uint32_t len = 1 + rand() % MAX_FRAME;
+    if (len > TOTAL - pos) len = TOTAL - pos;
+
+    sim_uart_send(UART0, _sent + pos, len);
+    pos += len;
+
+    // idle line long enough for the receive timeout,
+    // or bytes still flowing into the next frame
+    gap = rand() % 4;
+    if (gap) {
+      sim_uart_send_gap(UART0, sim_uart_char_ns(UART0) * (4 + rand() % 16));
+      gaps++;
+    }
+  }
+
+  sim_run_until(sim_uart_send_end(UART0) + SIM_MS(1));
+
+  CHECK_EQ(sim_uart_overruns(UART0), 0);
+  CHECK_EQ(_errors, 0);
+  CHECK_EQ(_rcvd_len, TOTAL);
+  CHECK(memcmp(_sent, _rcvd, TOTAL) == 0);
+  // one receive timeout per idle line, wherever the frame ends
+  CHECK_EQ(_frames, gaps + !gap);
+
+  const uart_stats_t* stats = uart_get_stats(UART0);
+  CHECK_EQ(stats->rx_bytes, TOTAL);
+  printf("%u frames, %u IRQs, %.1f CPU cycles per byte in IRQ\n",
+         _frames, stats->irqs, (double)stats->irq_ticks / TOTAL);
+  return 0;
+}
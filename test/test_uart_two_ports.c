@@ -0,0 +1,108 @@
+// Two serial_t handles (UART0 and UART1) wired to each other,
+// both sending frames by DMA at the same time
+
+#include <driverlib/ioc.h>
+#include <string.h>
+
+#include "serial.h"
+#include "sim.h"
+#include "test.h"
+
+#define ROUNDS 2000
+
+typedef struct {
+  serial_t serial;
+  uint8_t tx[RX_BUFFER_SIZE];
+  uint32_t tx_len;
+  uint32_t tx_total;
+  uint32_t frames;
+} port_t;
+
+static port_t _ports[2];
+
+static void _send(port_t* port, bool sg)
+{
+  port->tx_len = 1 + rand() % RX_BUFFER_SIZE;
+  for (uint32_t i = 0; i < port->tx_len; i++) port->tx[i] = rand();
+  port->tx_total += port->tx_len;
+
+  if (sg) {
+    // two segments, one DMA job
+    uint32_t split = port->tx_len / 2;
+    const uart_iovec_t iov[] = {
+      { port->tx, split },
+      { port->tx + split, port->tx_len - split },
+    };
+    CHECK(serial_writev_dma(&port->serial, iov, 2, false));
+  } else {
+    serial_write_dma(&port->serial, port->tx, port->tx_len, false);
+  }
+}
+
+// Frame received by 'port' from the other one
+static bool _receive(port_t* port, const port_t* peer)
+{
+  const serial_frame_t* frame = serial_get_frame(&port->serial);
+  if (!frame) return false;
+
+  CHECK_EQ(frame->len, peer->tx_len);
+  CHECK(memcmp(frame->data, peer->tx, frame->len) == 0);
+  serial_release_frame(&port->serial);
+  port->frames++;
+  return true;
+}
+
+int main()
+{
+  const uart_device_t devs[2] = {
+    {
+      .mode = UART_8N1,
+      .baud_rate = SERIAL_BAUDRATE,
+      .rx = IOID_2,
+      .tx = IOID_3,
+      .cts = IOID_UNUSED,
+      .rts = IOID_UNUSED,
+    },
+    {
+      .mode = UART_8N1,
+      .baud_rate = SERIAL_BAUDRATE,
+      .rx = IOID_23,
+      .tx = IOID_21,
+      .cts = IOID_UNUSED,
+      .rts = IOID_UNUSED,
+    },
+  };
+
+  serial_init(&_ports[0].serial, UART0, &devs[0]);
+  serial_init(&_ports[1].serial, UART1, &devs[1]);
+  sim_uart_connect(UART0, UART1);
+  sim_uart_connect(UART1, UART0);
+
+  srand(5);
+  for (uint32_t round = 0; round < ROUNDS; round++) {
+    _send(&_ports[0], rand() % 2);
+    _send(&_ports[1], rand() % 2);
+
+    bool rcvd[2] = { false, false };
+    while (!rcvd[0] || !rcvd[1]) {
+      sim_run(SIM_US(10));
+      if (!rcvd[0]) rcvd[0] = _receive(&_ports[0], &_ports[1]);
+      if (!rcvd[1]) rcvd[1] = _receive(&_ports[1], &_ports[0]);
+    }
+  }
+
+  for (uart_t uart = UART0; uart <= UART1; uart++) {
+    port_t* port = &_ports[uart];
+    CHECK_EQ(port->frames, ROUNDS);
+    CHECK_EQ(serial_rx_overflows(&port->serial), 0);
+    CHECK_EQ(serial_rx_errors(&port->serial), 0);
+    CHECK_EQ(sim_uart_overruns(uart), 0);
+
+    const uart_stats_t* stats = uart_get_stats(uart);
+    printf("UART%d: %u bytes sent, %u received, %u IRQs\n", uart,
+           stats->tx_bytes, stats->rx_bytes, stats->irqs);
+    CHECK_EQ(stats->tx_bytes, port->tx_total);
+    CHECK_EQ(uart_get_stats(uart ^ 1)->rx_bytes, port->tx_total);
+  }
+  return 0;
+}
@@ -0,0 +1,54 @@
+"""
+Binary command framing (see src/command.h).
+"""
+
+import struct
+
+CMD_SYNC = 0xA5
+CMD_REPLY = 0x80
+
+CMD_DUMP_FLASH = 0x01
+CMD_LOAD_FLASH = 0x02
+CMD_LOAD_BLOCK = 0x03
+CMD_DUMP_FLASH_BIN = 0x04
+CMD_FLASH_MANIFEST = 0x05
+CMD_DUMP_SECTORS = 0x06
+CMD_DMA_STATS = 0x07
+CMD_UART_STATS = 0x08  # DEBUG builds: logged over RTT
+CMD_UART_BENCH = 0x09  # DEBUG builds: logged over RTT
+
+
+def crc8_d5(data: bytes) -> int:
+    crc = 0
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0xD5 if crc & 0x80 else crc << 1) & 0xFF
+    return crc
+
+
+def command_frame(opcode: int, payload: bytes = b"") -> bytes:
+    body = struct.pack("<BH", opcode, len(payload)) + payload
+    return bytes([CMD_SYNC]) + body + bytes([crc8_d5(body)])
+
+
+def read_reply(ser, opcode: int):
+    """Return the payload of the next reply for 'opcode' (None on timeout)"""
+    while True:
+        sync = ser.read(1)
+        if not sync:
+            return None
+        if sync[0] != CMD_SYNC:
+            continue
+
+        header = ser.read(3)
+        if len(header) < 3:
+            return None
+        op, length = struct.unpack("<BH", header)
+        rest = ser.read(length + 1)
+        if len(rest) < length + 1:
+            return None
+        if crc8_d5(header + rest[:-1]) != rest[-1]:
+            continue
+        if op == opcode | CMD_REPLY:
+            return rest[:-1]
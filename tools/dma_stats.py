@@ -0,0 +1,82 @@
+"""
+Script that prints the per-channel uDMA counters.
+
+  dma_stats.py <serial port>            once
+  dma_stats.py <serial port> <seconds>  deltas every <seconds>
+"""
+
+import serial
+import struct
+import sys
+import time
+
+from command import CMD_DMA_STATS, command_frame, read_reply
+
+BAUDRATE = 921600
+
+# see cmd_dma_stats() in src/main.c
+DMA_STATS_RECORD = "<BIII"
+DMA_STATS_RECORD_SIZE = struct.calcsize(DMA_STATS_RECORD)
+
+# see driverlib/udma.h
+CHANNEL_NAMES = {
+    1: "UART0 RX",
+    2: "UART0 TX",
+    3: "SSI0 RX",
+    4: "SSI0 TX",
+    5: "UART1 RX",
+    6: "UART1 TX",
+    16: "SSI1 RX",
+    17: "SSI1 TX",
+}
+
+
+def read_stats(ser: serial.Serial):
+    """Returns {channel: (transfers, bytes, errors)}"""
+    ser.write(command_frame(CMD_DMA_STATS))
+    reply = read_reply(ser, CMD_DMA_STATS)
+    if reply is None:
+        sys.exit("Timeout waiting for DMA stats")
+
+    stats = {}
+    for i in range(0, len(reply), DMA_STATS_RECORD_SIZE):
+        channel, transfers, size, errors = struct.unpack(
+            DMA_STATS_RECORD, reply[i : i + DMA_STATS_RECORD_SIZE]
+        )
+        stats[channel] = (transfers, size, errors)
+    return stats
+
+
+def print_stats(stats, elapsed=None):
+    print(f"{'channel':<12}{'transfers':>10}{'bytes':>12}{'errors':>8}")
+    for channel, (transfers, size, errors) in sorted(stats.items()):
+        name = CHANNEL_NAMES.get(channel, str(channel))
+        line = f"{name:<12}{transfers:>10}{size:>12}{errors:>8}"
+        if elapsed:
+            line += f"  {size / elapsed / 1024:.1f} KB/s"
+        print(line)
+
+
+if len(sys.argv) < 2:
+    print("Missing argument: serial port", file=sys.stderr)
+    sys.exit(1)
+
+ser = serial.Serial(sys.argv[1], BAUDRATE, timeout=5)
+
+# flush buffer
+ser.read_all()
+
+if len(sys.argv) > 2:
+    period = float(sys.argv[2])
+    previous = read_stats(ser)
+    while True:
+        time.sleep(period)
+        stats = read_stats(ser)
+        delta = {
+            ch: tuple(a - b for a, b in zip(v, previous.get(ch, (0, 0, 0))))
+            for ch, v in stats.items()
+        }
+        print_stats(delta, period)
+        previous = stats
+else:
+    print_stats(read_stats(ser))
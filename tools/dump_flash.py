@@ -1,9 +1,27 @@
 """
-Script that dumps the external flash to stdout (Intel HEX).
+Script that dumps the external flash.
+
+  dump_flash.py <serial port>               Intel HEX to stdout
+  dump_flash.py <serial port> --bin <file>  binary dump into a raw image
+  dump_flash.py <serial port> --bench       time both modes
+  dump_flash.py <serial port> --sync <file> refresh a cached raw image,
+                                            fetching only changed sectors
 """
 
+import os
 import serial
+import struct
 import sys
+import time
+import zlib
+
+from command import (
+    CMD_DUMP_FLASH_BIN,
+    CMD_DUMP_SECTORS,
+    CMD_FLASH_MANIFEST,
+    command_frame,
+    read_reply,
+)
 
 BAUDRATE = 921600
 DUMP_CMD = b"dump_flash"
@@ -11,6 +29,156 @@ DUMP_CMD = b"dump_flash"
 # see https://en.wikipedia.org/wiki/Intel_HEX
 HEX_EOF = b":00000001FF\n"
 
+# see src/flash_dump.h
+DUMP_HEADER = "<IIBI"
+DUMP_HEADER_SIZE = struct.calcsize(DUMP_HEADER)
+DUMP_ERASED = 0
+DUMP_RAW = 1
+DUMP_LZ = 2
+DUMP_END = 0xFF
+
+MANIFEST_HEADER = "<IIH"
+MANIFEST_HEADER_SIZE = struct.calcsize(MANIFEST_HEADER)
+
+# see src/lz.h
+LZ_LENGTH_BITS = 6
+LZ_MIN_MATCH = 3
+
+
+def lz_decompress(data: bytes, size: int) -> bytes:
+    out = bytearray()
+    pos = 0
+    while len(out) < size:
+        flags = data[pos]
+        pos += 1
+        for bit in range(8):
+            if len(out) >= size:
+                break
+            if flags & (1 << bit):
+                token = data[pos] | (data[pos + 1] << 8)
+                pos += 2
+                offset = (token >> LZ_LENGTH_BITS) + 1
+                length = (token & ((1 << LZ_LENGTH_BITS) - 1)) + LZ_MIN_MATCH
+                for _ in range(length):
+                    out.append(out[-offset])
+            else:
+                out.append(data[pos])
+                pos += 1
+    return bytes(out)
+
+
+def dump_hex(ser: serial.Serial, out) -> int:
+    """Intel HEX dump, returns the number of bytes received"""
+    ser.write(DUMP_CMD)
+
+    received = 0
+    while True:
+        data = ser.readline()
+        if not data:
+            sys.exit("Timeout waiting for data")
+
+        received += len(data)
+        if out:
+            print(data.decode(), end="", file=out)
+
+        # detect EOF
+        if data == HEX_EOF:
+            return received
+
+
+def receive_records(ser: serial.Serial, image: bytearray, base: int):
+    """Patch 'image' with dump records until END, returns (END record, bytes received)"""
+    received = 0
+    while True:
+        record = read_reply(ser, CMD_DUMP_FLASH_BIN)
+        if record is None:
+            sys.exit("Timeout waiting for data")
+
+        received += len(record) + 5
+        addr, length, kind, crc = struct.unpack(DUMP_HEADER, record[:DUMP_HEADER_SIZE])
+        data = record[DUMP_HEADER_SIZE:]
+
+        if kind == DUMP_END:
+            return (addr, length, crc), received
+
+        if kind == DUMP_ERASED:
+            block = b"\xff" * length
+        elif kind == DUMP_RAW:
+            block = data
+        elif kind == DUMP_LZ:
+            block = lz_decompress(data, length)
+        else:
+            sys.exit(f"Unknown record kind {kind}")
+
+        if kind != DUMP_ERASED and zlib.crc32(block) != crc:
+            sys.exit(f"CRC32 mismatch at 0x{addr:06x}")
+
+        offset = addr - base
+        if offset + length > len(image):
+            image.extend(b"\xff" * (offset + length - len(image)))
+        image[offset : offset + length] = block
+
+
+def dump_bin(ser: serial.Serial):
+    """Binary dump, returns (image, bytes received)"""
+    ser.write(command_frame(CMD_DUMP_FLASH_BIN))
+
+    image = bytearray()
+    (base, length, crc), received = receive_records(ser, image, 0)
+    image = bytes(image[base:]).ljust(length, b"\xff")
+    if zlib.crc32(image) != crc:
+        sys.exit("Image CRC32 mismatch")
+    return image, received
+
+
+def read_manifest(ser: serial.Serial):
+    """Returns (base address, sector size, [crc32 per sector])"""
+    ser.write(command_frame(CMD_FLASH_MANIFEST))
+    reply = read_reply(ser, CMD_FLASH_MANIFEST)
+    if reply is None:
+        sys.exit("Timeout waiting for manifest")
+
+    base, sector_size, count = struct.unpack(MANIFEST_HEADER, reply[:MANIFEST_HEADER_SIZE])
+    crcs = struct.unpack(f"<{count}I", reply[MANIFEST_HEADER_SIZE:])
+    return base, sector_size, list(crcs)
+
+
+def sync_image(ser: serial.Serial, path: str):
+    """Refresh the cached image in 'path', returns (image, bytes received, changed sectors)"""
+    base, sector_size, crcs = read_manifest(ser)
+
+    image = bytearray()
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            image = bytearray(f.read())
+    image = image[: len(crcs) * sector_size].ljust(len(crcs) * sector_size, b"\xff")
+
+    changed = [
+        i
+        for i, crc in enumerate(crcs)
+        if zlib.crc32(image[i * sector_size : (i + 1) * sector_size]) != crc
+    ]
+
+    received = 0
+    if changed:
+        bitmap = bytearray((len(crcs) + 7) // 8)
+        for i in changed:
+            bitmap[i // 8] |= 1 << (i % 8)
+
+        ser.write(command_frame(CMD_DUMP_SECTORS, bytes(bitmap)))
+        _, received = receive_records(ser, image, base)
+
+        for i in changed:
+            if zlib.crc32(image[i * sector_size : (i + 1) * sector_size]) != crcs[i]:
+                sys.exit(f"Sector {i} does not match the manifest")
+
+    return bytes(image), received, len(changed)
+
+
+def rate(size: int, elapsed: float) -> str:
+    return f"{elapsed:.2f} s, {size / elapsed / 1024:.1f} KB/s"
+
+
 if len(sys.argv) < 2:
     print("Missing argument: serial port", file=sys.stderr)
     sys.exit(1)
@@ -20,18 +188,37 @@ ser = serial.Serial(sys.argv[1], BAUDRATE, timeout=5)
 # flush buffer
 ser.read_all()
 
-# send command
-ser.write(b"dump_flash")
+if len(sys.argv) > 3 and sys.argv[2] == "--bin":
+    start = time.monotonic()
+    image, received = dump_bin(ser)
+    elapsed = time.monotonic() - start
+
+    with open(sys.argv[3], "wb") as f:
+        f.write(image)
+    print(f"{len(image)} bytes ({received} on the wire) in {rate(len(image), elapsed)}", file=sys.stderr)
+
+elif len(sys.argv) > 2 and sys.argv[2] == "--bench":
+    start = time.monotonic()
+    hex_received = dump_hex(ser, None)
+    hex_elapsed = time.monotonic() - start
+
+    start = time.monotonic()
+    image, bin_received = dump_bin(ser)
+    bin_elapsed = time.monotonic() - start
+
+    print(f"{'mode':<8}{'wire bytes':>12}  image throughput")
+    print(f"{'hex':<8}{hex_received:>12}  {rate(len(image), hex_elapsed)}")
+    print(f"{'binary':<8}{bin_received:>12}  {rate(len(image), bin_elapsed)}")
 
-while True:
-    data = ser.readline()
-    if not data:
-        print("Timeout waiting for data", file=sys.stderr)
-        sys.exit(1)
+elif len(sys.argv) > 3 and sys.argv[2] == "--sync":
+    start = time.monotonic()
+    image, received, changed = sync_image(ser, sys.argv[3])
+    elapsed = time.monotonic() - start
 
-    print(data.decode(), end="")
+    with open(sys.argv[3], "wb") as f:
+        f.write(image)
+    print(f"{changed} sector(s) changed, {received} bytes received in {elapsed:.2f} s", file=sys.stderr)
 
-    # detect EOF
-    if data == HEX_EOF:
-        print("Done", file=sys.stderr)
-        sys.exit(0)
+else:
+    dump_hex(ser, sys.stdout)
+    print("Done", file=sys.stderr)
@@ -0,0 +1,105 @@
+"""
+Script that uploads an image into the external flash.
+
+Blocks are streamed with a sliding window, each one carrying a CRC32.
+The flash content is read back and checked at the end.
+"""
+
+import serial
+import struct
+import sys
+import time
+import zlib
+
+from command import CMD_LOAD_BLOCK, CMD_LOAD_FLASH, command_frame, read_reply
+
+BAUDRATE = 921600
+
+LOAD_OK = 0
+LOAD_ERRORS = {1: "bad parameters", 2: "CRC error", 3: "sequence error", 4: "timeout"}
+
+# The device may wait for a 32KB block erase before acking a block
+BLOCK_ERASE_MAX = 1.6
+ACK_TIMEOUT = BLOCK_ERASE_MAX + 0.5
+
+
+def error_str(status: int) -> str:
+    return LOAD_ERRORS.get(status, f"error {status}")
+
+
+def load_flash(ser: serial.Serial, image: bytes, addr: int) -> None:
+    ser.write(command_frame(CMD_LOAD_FLASH, struct.pack("<II", addr, len(image))))
+    reply = read_reply(ser, CMD_LOAD_FLASH)
+    if reply is None:
+        sys.exit("Timeout waiting for load_flash reply")
+
+    status, window, block_size = struct.unpack("<BBH", reply[:4])
+    if status != LOAD_OK:
+        sys.exit(f"load_flash refused: {error_str(status)}")
+
+    blocks = [image[i : i + block_size] for i in range(0, len(image), block_size)]
+    print(f"{len(blocks)} blocks of {block_size} bytes, window = {window}", file=sys.stderr)
+
+    start = time.monotonic()
+    base = 0  # oldest block not acknowledged
+    next_block = 0  # next block to send
+    retries = 0
+
+    ser.timeout = ACK_TIMEOUT
+    while base < len(blocks):
+        while next_block < len(blocks) and next_block < base + window:
+            data = blocks[next_block]
+            payload = struct.pack("<H", next_block & 0xFFFF) + data
+            payload += struct.pack("<I", zlib.crc32(data))
+            ser.write(command_frame(CMD_LOAD_BLOCK, payload))
+            next_block += 1
+
+        reply = read_reply(ser, CMD_LOAD_BLOCK)
+        if reply is None:
+            # lost frame or ack: go back
+            retries += 1
+            next_block = base
+            continue
+
+        status, seq = struct.unpack("<BH", reply[:3])
+        # seq is the next expected block (16 bits)
+        acked = base + ((seq - base) & 0xFFFF)
+        if acked <= next_block:
+            base = max(base, acked)
+        if status != LOAD_OK:
+            retries += 1
+            next_block = base
+
+        print(f"\r{base * 100 // len(blocks)}%", end="", file=sys.stderr)
+
+    elapsed = time.monotonic() - start
+    print(file=sys.stderr)
+
+    ser.timeout = 10
+    reply = read_reply(ser, CMD_LOAD_FLASH)
+    if reply is None:
+        sys.exit("Timeout waiting for verification")
+
+    status, crc = struct.unpack("<BI", reply[:5])
+    if status != LOAD_OK:
+        sys.exit(f"load_flash failed: {error_str(status)}")
+    if crc != zlib.crc32(image):
+        sys.exit(f"Verification failed: CRC32 0x{crc:08x} != 0x{zlib.crc32(image):08x}")
+
+    rate = len(image) / elapsed / 1024
+    print(f"{len(image)} bytes in {elapsed:.2f} s ({rate:.1f} KB/s), {retries} retries", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        print("Usage: load_flash.py <serial port> <image> [address]", file=sys.stderr)
+        sys.exit(1)
+
+    with open(sys.argv[2], "rb") as f:
+        image = f.read()
+
+    addr = int(sys.argv[3], 0) if len(sys.argv) > 3 else 0
+
+    ser = serial.Serial(sys.argv[1], BAUDRATE, timeout=5)
+    ser.read_all()
+    load_flash(ser, image, addr)